@@ -0,0 +1,205 @@
+/*
+ * N-to-M aggregation of SST output onto a few WAN-facing ranks
+ *
+ *   --aggregators=M   only M ranks open the SST stream (0 = every rank)
+ *
+ * Ranks are split into M groups, each led by its lowest rank: M is spread
+ * over the nodes (MPI_COMM_TYPE_SHARED) in proportion so that a group stays
+ * on one node whenever there are at least as many aggregators as nodes, and
+ * the gathers then run over MPI's shared-memory path. Every put() gathers
+ * the members' blocks of a variable to the leader, which merges blocks that
+ * are adjacent along the first dimension and Puts them as a few large
+ * blocks. World rank 0 always leads a group, so rank-0 scalars need no
+ * special handling.
+ */
+
+#ifndef AGGREGATION_H
+#define AGGREGATION_H
+
+#include <adios2.h>
+#include <mpi.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include "buffers.h"
+
+class WanAggregator {
+public:
+    WanAggregator(MPI_Comm comm, int aggregators)
+    {
+        MPI_Comm_rank(comm, &rank_);
+        MPI_Comm_size(comm, &size_);
+        aggregators_ = (aggregators > 0 && aggregators < size_) ? aggregators : size_;
+        if (!enabled()) {
+            isWriter_ = true;
+            MPI_Comm_dup(comm, &writerComm_);
+            return;
+        }
+
+        // Node index and size of this rank's node
+        MPI_Comm nodeComm, leaderComm;
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank_, MPI_INFO_NULL, &nodeComm);
+        int nodeRank, nodeSize;
+        MPI_Comm_rank(nodeComm, &nodeRank);
+        MPI_Comm_size(nodeComm, &nodeSize);
+        MPI_Comm_split(comm, nodeRank == 0 ? 0 : MPI_UNDEFINED, rank_, &leaderComm);
+        int node = 0, nodes = 0;
+        if (leaderComm != MPI_COMM_NULL) {
+            MPI_Comm_rank(leaderComm, &node);
+            MPI_Comm_size(leaderComm, &nodes);
+            MPI_Comm_free(&leaderComm);
+        }
+        MPI_Bcast(&node, 1, MPI_INT, 0, nodeComm);
+        MPI_Bcast(&nodes, 1, MPI_INT, 0, nodeComm);
+        MPI_Comm_free(&nodeComm);
+
+        int group;
+        if (aggregators_ >= nodes) {
+            // Each node gets its share of the aggregators (at most one per rank)
+            int first = node * aggregators_ / nodes;
+            int mine = (node + 1) * aggregators_ / nodes - first;
+            mine = std::max(1, std::min(mine, nodeSize));
+            group = first + nodeRank * mine / nodeSize;
+        } else {
+            group = node * aggregators_ / nodes;   // Several nodes per aggregator
+        }
+
+        MPI_Comm_split(comm, group, rank_, &group_);
+        MPI_Comm_rank(group_, &groupRank_);
+        MPI_Comm_size(group_, &groupSize_);
+        isWriter_ = (groupRank_ == 0);
+        MPI_Comm_split(comm, isWriter_ ? 0 : MPI_UNDEFINED, rank_, &writerComm_);
+
+        int writers = isWriter_ ? 1 : 0;
+        MPI_Allreduce(MPI_IN_PLACE, &writers, 1, MPI_INT, MPI_SUM, comm);
+        aggregators_ = writers;   // Fewer if nodes had fewer ranks than their share
+        groupSizeMax_ = groupSize_;
+        MPI_Allreduce(MPI_IN_PLACE, &groupSizeMax_, 1, MPI_INT, MPI_MAX, comm);
+    }
+
+    ~WanAggregator() {
+        int finalized = 0;
+        MPI_Finalized(&finalized);   // May outlive MPI_Finalize in main()'s scope
+        if (finalized) return;
+        if (group_ != MPI_COMM_NULL) MPI_Comm_free(&group_);
+        if (writerComm_ != MPI_COMM_NULL) MPI_Comm_free(&writerComm_);
+    }
+
+    WanAggregator(const WanAggregator&) = delete;
+    WanAggregator& operator=(const WanAggregator&) = delete;
+
+    bool enabled() const { return aggregators_ < size_; }
+
+    // This rank opens the SST stream and calls BeginStep/EndStep
+    bool isWriter() const { return isWriter_; }
+
+    // Communicator for the ADIOS object that opens the stream: the writers,
+    // or MPI_COMM_SELF on ranks that only feed an aggregator
+    MPI_Comm adiosComm() const { return isWriter_ ? writerComm_ : MPI_COMM_SELF; }
+
+    int aggregators() const { return aggregators_; }
+    int maxGroupSize() const { return groupSizeMax_; }
+    double getGatherTime() const { return gatherTime_; }
+
+    // Deferred Put of this rank's block (start/count) of var. With
+    // aggregation this is collective over the group: the leader Puts the
+    // gathered blocks from a staging buffer that stays valid until the next
+    // put() of the same variable.
+    template <class T>
+    void put(adios2::Engine& writer, adios2::Variable<T>& var, const T* data,
+             const adios2::Dims& start, const adios2::Dims& count)
+    {
+        if (!enabled()) {
+            writer.Put(var, data);
+            return;
+        }
+        auto t0 = std::chrono::high_resolution_clock::now();
+
+        const size_t ndim = start.size();
+        std::vector<unsigned long long> selection(2 * ndim);
+        size_t elements = 1;
+        for (size_t d = 0; d < ndim; ++d) {
+            selection[d] = start[d];
+            selection[ndim + d] = count[d];
+            elements *= count[d];
+        }
+        std::vector<unsigned long long> selections(isWriter_ ? groupSize_ * 2 * ndim : 0);
+        MPI_Gather(selection.data(), static_cast<int>(2 * ndim), MPI_UNSIGNED_LONG_LONG,
+                   selections.data(), static_cast<int>(2 * ndim), MPI_UNSIGNED_LONG_LONG, 0, group_);
+
+        // Counts in elements of T, so blocks up to 2^31 elements fit an int
+        MPI_Datatype element;
+        MPI_Type_contiguous(static_cast<int>(sizeof(T)), MPI_BYTE, &element);
+        MPI_Type_commit(&element);
+
+        std::vector<int> counts, displs;
+        AlignedVector<char>& staging = staging_[&var];
+        if (isWriter_) {
+            counts.resize(groupSize_);
+            displs.resize(groupSize_);
+            size_t total = 0;
+            for (int m = 0; m < groupSize_; ++m) {
+                size_t n = 1;
+                for (size_t d = 0; d < ndim; ++d) n *= selections[m * 2 * ndim + ndim + d];
+                counts[m] = static_cast<int>(n);
+                displs[m] = static_cast<int>(total);
+                total += n;
+            }
+            if (staging.size() < total * sizeof(T)) staging.resize(total * sizeof(T));
+        }
+        MPI_Gatherv(data, static_cast<int>(elements), element,
+                    staging.data(), counts.data(), displs.data(), element, 0, group_);
+        MPI_Type_free(&element);
+
+        if (isWriter_) {
+            // Members are in rank order, so a block that continues the
+            // previous one along dim0 extends it in place
+            const T* base = reinterpret_cast<const T*>(staging.data());
+            std::vector<adios2::Box<adios2::Dims>> blocks;
+            std::vector<const T*> pointers;
+            for (int m = 0; m < groupSize_; ++m) {
+                if (counts[m] == 0) continue;
+                const unsigned long long* sel = &selections[m * 2 * ndim];
+                adios2::Dims s(sel, sel + ndim), c(sel + ndim, sel + 2 * ndim);
+                if (!blocks.empty() && continues(blocks.back(), s, c)) {
+                    blocks.back().second[0] += c[0];
+                } else {
+                    blocks.push_back({s, c});
+                    pointers.push_back(base + displs[m]);
+                }
+            }
+            for (size_t b = 0; b < blocks.size(); ++b) {
+                var.SetSelection(blocks[b]);
+                writer.Put(var, pointers[b]);
+            }
+        }
+
+        gatherTime_ += std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - t0).count();
+    }
+
+private:
+    // True if (start, count) directly follows `block` along dim0
+    static bool continues(const adios2::Box<adios2::Dims>& block,
+                          const adios2::Dims& start, const adios2::Dims& count)
+    {
+        if (start.empty() || start[0] != block.first[0] + block.second[0]) return false;
+        for (size_t d = 1; d < start.size(); ++d) {
+            if (start[d] != block.first[d] || count[d] != block.second[d]) return false;
+        }
+        return true;
+    }
+
+    int rank_ = 0, size_ = 1;
+    int aggregators_ = 1;
+    int groupRank_ = 0, groupSize_ = 1, groupSizeMax_ = 1;
+    bool isWriter_ = false;
+    MPI_Comm group_ = MPI_COMM_NULL;
+    MPI_Comm writerComm_ = MPI_COMM_NULL;
+    std::map<const void*, AlignedVector<char>> staging_;   // Gathered blocks per variable
+    double gatherTime_ = 0.0;
+};
+
+#endif // AGGREGATION_H
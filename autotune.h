@@ -0,0 +1,168 @@
+/*
+ * Parameter-sweep autotuning of the SST link
+ *
+ *   sender    --autotune[=SWEEP] [--autotune-steps=N] [--autotune-out=FILE]
+ *   receiver  --autotune[=SWEEP]                      (the same SWEEP)
+ *
+ * SWEEP lists the values to try per knob, separated by '/':
+ *   "queue:1/5/20;marshal:BP5/FFS;transport:sockets/rdma;writers:0/4;readers:2/8;compress:none/blosc:clevel=1"
+ *
+ *   queue      SST QueueLimit                       (default 5)
+ *   marshal    SST MarshalMethod                    (default BP5)
+ *   transport  as --transport                       (default sockets)
+ *   writers    sender WAN ranks, as --aggregators   (default 0 = all)
+ *   readers    receiver ranks reading the stream    (default 0 = all)
+ *   compress   none or OP[:key=value,...] on every floating-point array
+ *
+ * Every combination is a trial, run on its own SST stream
+ * "<contact>-tune<i>", so the two sides only have to walk the same list.
+ * The sender times each trial's steps up to Close, which returns once the
+ * reader has taken every queued step, ranks the trials by throughput and
+ * writes the fastest as an ADIOS2 XML file that --config accepts.
+ */
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <adios2.h>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "compression.h"
+#include "transport.h"
+
+struct TuneTrial {
+    int queueLimit;
+    std::string marshal;
+    std::string transport;
+    int writers;               // WAN-facing sender ranks (0 = all)
+    int readers;               // Receiver ranks (0 = all)
+    std::string compression;   // "none" or OP[:key=value,...]
+};
+
+const char* const defaultTuneSweep = "queue:1/5/20;marshal:BP5/FFS";
+
+inline std::vector<std::string> splitList(const std::string& text, char separator)
+{
+    std::vector<std::string> items;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, separator)) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Spec for CompressionPipeline::addSpec, or "" for none
+inline std::string tuneCompressionSpec(const TuneTrial& trial)
+{
+    return trial.compression == "none" ? "" : "*:" + trial.compression;
+}
+
+// All trials of a sweep. Throws std::invalid_argument on unknown knobs or
+// values.
+inline std::vector<TuneTrial> parseTuneSweep(const std::string& text)
+{
+    std::map<std::string, std::vector<std::string>> knobs = {
+        {"queue", {"5"}}, {"marshal", {"BP5"}}, {"transport", {"sockets"}},
+        {"writers", {"0"}}, {"readers", {"0"}}, {"compress", {"none"}}
+    };
+    for (const std::string& item : splitList(text, ';')) {
+        size_t colon = item.find(':');
+        std::string key = item.substr(0, colon);
+        if (colon == std::string::npos || !knobs.count(key)) {
+            throw std::invalid_argument("invalid autotune knob '" + item +
+                                        "' (use queue, marshal, transport, writers, readers or compress)");
+        }
+        auto values = splitList(item.substr(colon + 1), '/');
+        if (values.empty()) throw std::invalid_argument("no values for autotune knob '" + key + "'");
+        knobs[key] = values;
+    }
+
+    std::vector<TuneTrial> trials;
+    for (const auto& queue : knobs["queue"])
+    for (const auto& marshal : knobs["marshal"])
+    for (const auto& transport : knobs["transport"])
+    for (const auto& writers : knobs["writers"])
+    for (const auto& readers : knobs["readers"])
+    for (const auto& compress : knobs["compress"]) {
+        TuneTrial trial{std::stoi(queue), marshal, transport, std::stoi(writers), std::stoi(readers), compress};
+        if (trial.queueLimit < 1 || trial.writers < 0 || trial.readers < 0) {
+            throw std::invalid_argument("autotune queue must be positive and writers/readers non-negative");
+        }
+        transportCandidates(transport);                 // Validate now, not mid-sweep
+        if (compress != "none") parseCompressionSpec(tuneCompressionSpec(trial));
+        trials.push_back(trial);
+    }
+    return trials;
+}
+
+inline std::string tuneContact(const std::string& contact, size_t trial)
+{
+    return contact + "-tune" + std::to_string(trial);
+}
+
+inline std::string describeTrial(const TuneTrial& trial)
+{
+    std::ostringstream out;
+    out << "queue=" << trial.queueLimit << " marshal=" << trial.marshal
+        << " transport=" << trial.transport
+        << " writers=" << (trial.writers > 0 ? std::to_string(trial.writers) : "all")
+        << " readers=" << (trial.readers > 0 ? std::to_string(trial.readers) : "all")
+        << " compress=" << trial.compression;
+    return out.str();
+}
+
+// The winning trial as a runtime config for IO `ioName` carrying `field`.
+// Rank counts have no XML form, so they go into the header comment.
+inline void writeTunedConfig(const std::string& path, const std::string& ioName, const std::string& field,
+                             const TuneTrial& best, Transport used, double throughputMBps, double stepMB)
+{
+    std::ofstream out(path);
+    out << "<?xml version=\"1.0\"?>\n"
+        << "<!--\n"
+        << "  Tuned by sender --autotune: " << std::fixed << std::setprecision(1) << throughputMBps
+        << " MB/s for " << stepMB << " MB steps\n"
+        << "  Best trial: " << describeTrial(best) << "\n"
+        << "  Run the sender with --aggregators=" << best.writers << " and the receiver with "
+        << (best.readers > 0 ? std::to_string(best.readers) : std::string("all its")) << " ranks";
+    if (best.compression != "none") {
+        out << ";\n  other senders' fields need --compress=" << tuneCompressionSpec(best);
+    }
+    out << "\n-->\n"
+        << "<adios-config>\n"
+        << "  <io name=\"" << ioName << "\">\n"
+        << "    <engine type=\"SST\">\n";
+
+    adios2::Params params = {
+        {"RendezvousReaderCount", "1"},
+        {"QueueLimit", std::to_string(best.queueLimit)},
+        {"QueueFullPolicy", "Block"},
+        {"MarshalMethod", best.marshal}
+    };
+    for (const auto& p : transportParams(used)) params[p.first] = p.second;
+    for (const auto& p : params) {
+        out << "      <parameter key=\"" << p.first << "\" value=\"" << p.second << "\"/>\n";
+    }
+    out << "    </engine>\n";
+
+    if (best.compression != "none") {
+        CompressionSpec spec = parseCompressionSpec(tuneCompressionSpec(best));
+        out << "    <variable name=\"" << field << "\">\n"
+            << "      <operation type=\"" << spec.type << "\">\n";
+        for (const auto& p : spec.params) {
+            out << "        <parameter key=\"" << p.first << "\" value=\"" << p.second << "\"/>\n";
+        }
+        out << "      </operation>\n"
+            << "    </variable>\n";
+    }
+    out << "  </io>\n"
+        << "</adios-config>\n";
+}
+
+#endif // AUTOTUNE_H
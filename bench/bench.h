@@ -0,0 +1,92 @@
+/*
+ * Benchmark harness shared by the bench/ executables
+ *
+ *   --repeat=N     timed repetitions per case (default 5, after one warm-up)
+ *   --json=FILE    append every result to FILE as a JSON line
+ *
+ * Each case is timed N times. A repetition counts as long as the slowest
+ * rank took (every rank runs it, then the times are max-reduced), and the
+ * median repetition is reported, which is steadier than the mean on a
+ * shared node. Results go to stdout on rank 0 and, with --json, one object
+ * per line:
+ *
+ *   {"suite": "gs_bench", "case": "stencil/optimized", "params": "128^3 ranks=4 threads=1",
+ *    "metric": "Mcells/s", "value": 812.4, "better": "higher"}
+ *
+ * bench/compare.py matches results to a stored baseline by suite, case,
+ * params and metric.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class BenchReport {
+public:
+    BenchReport(const std::string& suite, const std::string& jsonFile, int repeat, MPI_Comm comm)
+        : suite_(suite), jsonFile_(jsonFile), repeat_(std::max(1, repeat)), comm_(comm)
+    {
+        MPI_Comm_rank(comm_, &rank_);
+    }
+
+    // Median over the repetitions of the slowest rank's seconds for fn()
+    template <class F>
+    double time(F fn) {
+        fn();   // Warm-up: first touch, caches, MPI connections
+        std::vector<double> times;
+        for (int r = 0; r < repeat_; ++r) {
+            MPI_Barrier(comm_);
+            auto start = std::chrono::high_resolution_clock::now();
+            fn();
+            double local = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            double slowest = 0.0;
+            MPI_Allreduce(&local, &slowest, 1, MPI_DOUBLE, MPI_MAX, comm_);
+            times.push_back(slowest);
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    // One result (rank 0 prints and records it)
+    void add(const std::string& name, const std::string& params, const std::string& metric, double value,
+             bool higherIsBetter) {
+        if (rank_ != 0) return;
+        std::cout << std::left << std::setw(28) << name << std::setw(40) << params << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(12) << value << " " << metric << std::endl;
+        if (jsonFile_.empty()) return;
+        std::ostringstream line;
+        line << std::setprecision(6) << "{\"suite\": \"" << suite_ << "\", \"case\": \"" << name
+             << "\", \"params\": \"" << params << "\", \"metric\": \"" << metric << "\", \"value\": " << value
+             << ", \"better\": \"" << (higherIsBetter ? "higher" : "lower") << "\"}";
+        std::ofstream out(jsonFile_, std::ios::app);
+        out << line.str() << "\n";
+    }
+
+    int repeat() const { return repeat_; }
+
+private:
+    std::string suite_;
+    std::string jsonFile_;
+    int repeat_;
+    MPI_Comm comm_;
+    int rank_ = 0;
+};
+
+// Match a "--name=value" command line option and extract its value
+inline bool parseBenchOption(const std::string& arg, const std::string& name, std::string& value)
+{
+    if (arg.compare(0, name.size(), name) != 0) return false;
+    value = arg.substr(name.size());
+    return true;
+}
+
+#endif // BENCH_H
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+Compare benchmark results against a stored baseline
+
+Usage: bench/compare.py BASELINE.jsonl RESULTS.jsonl... [--tolerance=0.10] [--update]
+
+Results and baseline are JSON lines as written by bench.h and loopback.sh.
+A result matches a baseline entry with the same suite, case, params and
+metric; "better" says which direction is an improvement. A result more
+than the tolerance worse than its baseline is a regression, and any
+regression makes the exit status 1. Cases missing on either side are
+listed but do not fail. --update replaces the baseline with the results.
+"""
+
+import json
+import sys
+
+
+def load(path):
+    entries = {}
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                entry = json.loads(line)
+            except ValueError as e:
+                sys.exit("%s:%d: %s" % (path, number, e))
+            key = (entry["suite"], entry["case"], entry["params"], entry["metric"])
+            entries[key] = entry   # A later run of the same case wins
+    return entries
+
+
+def main(argv):
+    tolerance = 0.10
+    update = False
+    paths = []
+    for arg in argv[1:]:
+        if arg.startswith("--tolerance="):
+            tolerance = float(arg[len("--tolerance="):])
+        elif arg == "--update":
+            update = True
+        else:
+            paths.append(arg)
+    if len(paths) < 2:
+        sys.exit(__doc__.strip())
+    baseline_path, result_paths = paths[0], paths[1:]
+
+    results = {}
+    for path in result_paths:
+        try:
+            results.update(load(path))
+        except IOError as e:
+            sys.exit("Error: %s" % e)
+
+    if update:
+        with open(baseline_path, "w") as f:
+            for key in sorted(results):
+                f.write(json.dumps(results[key], sort_keys=True) + "\n")
+        print("Baseline %s updated with %d results" % (baseline_path, len(results)))
+        return 0
+
+    try:
+        baseline = load(baseline_path)
+    except IOError:
+        sys.exit("Error: no baseline at %s (record one with --update, or make bench_baseline)" % baseline_path)
+
+    regressions = 0
+    print("%-10s %-28s %-40s %12s %12s %8s" % ("suite", "case", "params", "baseline", "result", "change"))
+    for key in sorted(results):
+        result = results[key]
+        suite, case, params, metric = key
+        if key not in baseline:
+            print("%-10s %-28s %-40s %12s %12.2f %8s  new" % (suite, case, params, "-", result["value"], "-"))
+            continue
+        base = baseline[key]["value"]
+        value = result["value"]
+        change = (value - base) / base if base else 0.0
+        # Positive gain is an improvement whichever way the metric runs
+        gain = change if result.get("better", "higher") == "higher" else -change
+        status = ""
+        if gain < -tolerance:
+            status = "REGRESSION"
+            regressions += 1
+        elif gain > tolerance:
+            status = "improved"
+        print("%-10s %-28s %-40s %12.2f %12.2f %+7.1f%%  %s %s"
+              % (suite, case, params, base, value, 100.0 * change, metric, status))
+    for key in sorted(set(baseline) - set(results)):
+        print("%-10s %-28s %-40s %12.2f %12s %8s  missing" % (key[0], key[1], key[2], baseline[key]["value"], "-", "-"))
+
+    print("")
+    if regressions:
+        print("%d regressions beyond %.0f%% of the baseline" % (regressions, 100.0 * tolerance))
+        return 1
+    print("No regressions beyond %.0f%% of the baseline" % (100.0 * tolerance))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
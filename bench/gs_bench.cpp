@@ -0,0 +1,176 @@
+/*
+ * Gray-Scott microbenchmarks
+ *
+ * Times the pieces of a gs_sender step on their own: the stencil kernels,
+ * the halo exchanges, the copy of the interior out of the ghosted arrays
+ * (strided once Y/X are decomposed) and a whole step.
+ *
+ *   mpirun -np 4 ./gs_bench [N] [--iterations=10] [--threads=T]
+ *                           [--huge-pages=thp] [--repeat=5] [--json=FILE]
+ *
+ * N is the global grid edge (default 128). Each timed repetition runs
+ * --iterations sweeps or exchanges. The 2D/3D halo and the strided copy
+ * need a decomposition of Y or X, i.e. at least 2 ranks.
+ */
+
+#include <mpi.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "bench.h"
+#include "buffers.h"
+#include "gray_scott.h"
+
+static std::string gridName(const GrayScottSimulation& sim)
+{
+    const int* grid = sim.getProcGrid();
+    return "grid=" + std::to_string(grid[0]) + "x" + std::to_string(grid[1]) + "x" + std::to_string(grid[2]);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t gridSize = 128;
+    int iterations = 10;
+    int threads = 1;
+    int repeat = 5;
+    std::string jsonFile;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseBenchOption(arg, "--iterations=", value)) {
+            iterations = std::max(1, std::stoi(value));
+        } else if (parseBenchOption(arg, "--threads=", value)) {
+            threads = std::stoi(value);
+        } else if (parseBenchOption(arg, "--repeat=", value)) {
+            repeat = std::stoi(value);
+        } else if (parseBenchOption(arg, "--json=", value)) {
+            jsonFile = value;
+        } else if (parseBenchOption(arg, "--huge-pages=", value)) {
+            if (!parseHugePages(value, bufferConfig().hugePages)) {
+                std::cerr << "Invalid --huge-pages: " << value << " (expected off, thp or explicit)" << std::endl;
+                return 1;
+            }
+        } else {
+            gridSize = std::stoul(arg);
+        }
+    }
+    
+    int provided;
+    MPI_Init_thread(&argc, &argv, threads != 1 ? MPI_THREAD_FUNNELED : MPI_THREAD_SINGLE, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    
+#ifdef _OPENMP
+    if (threads > 0) omp_set_num_threads(threads);
+    threads = omp_get_max_threads();
+#else
+    threads = 1;
+#endif
+    
+    GSParams params;
+    params.F = 0.0545;
+    params.k = 0.062;
+    
+    BenchReport report("gs_bench", jsonFile, repeat, MPI_COMM_WORLD);
+    std::string common = std::to_string(gridSize) + "^3 ranks=" + std::to_string(size) +
+                         " threads=" + std::to_string(threads);
+    if (bufferConfig().hugePages != HugePages::Off) common += " pages=huge";
+    double cells = static_cast<double>(gridSize) * gridSize * gridSize * iterations;
+    
+    if (rank == 0) {
+        std::cout << "=== Gray-Scott microbenchmarks ===" << std::endl;
+        std::cout << "Iterations per repetition: " << iterations << " | Repetitions: " << report.repeat()
+                  << " (median of the slowest rank)" << std::endl;
+        std::cout << bufferBanner() << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+    }
+    
+    // Stencil kernels on the default 1D decomposition
+    const KernelMode kernels[2] = {KernelMode::Reference, KernelMode::Optimized};
+    const char* kernelNames[2] = {"stencil/reference", "stencil/optimized"};
+    for (int k = 0; k < 2; ++k) {
+        GSSolverOptions options;
+        options.kernelMode = kernels[k];
+        options.threads = threads;
+        GrayScottSimulation sim(rank, size, gridSize, gridSize, gridSize, params, options);
+        double t = report.time([&]() {
+            for (int i = 0; i < iterations; ++i) sim.updatePlanes(1, sim.getLocalNz() + 1);
+        });
+        report.add(kernelNames[k], common, "Mcells/s", cells / t / 1e6, true);
+    }
+    
+    // Halo exchanges: packed 1D planes, overlapped persistent requests, and
+    // derived datatypes on the decomposition MPI_Dims_create picks
+    {
+        GSSolverOptions options;
+        options.threads = threads;
+        GrayScottSimulation sim(rank, size, gridSize, gridSize, gridSize, params, options);
+        double t = report.time([&]() {
+            for (int i = 0; i < iterations; ++i) sim.exchangeHalos();
+        });
+        report.add("halo/blocking", common + " " + gridName(sim), "us", t / iterations * 1e6, false);
+    }
+    {
+        GSSolverOptions options;
+        options.threads = threads;
+        options.haloMode = HaloMode::Overlap;
+        GrayScottSimulation sim(rank, size, gridSize, gridSize, gridSize, params, options);
+        double t = report.time([&]() {
+            for (int i = 0; i < iterations; ++i) {
+                sim.beginHaloExchange();
+                sim.finishHaloExchange();
+            }
+        });
+        report.add("halo/overlap", common + " " + gridName(sim), "us", t / iterations * 1e6, false);
+    }
+    GSSolverOptions cartOptions;
+    cartOptions.threads = threads;
+    cartOptions.procGrid[0] = cartOptions.procGrid[1] = cartOptions.procGrid[2] = 0;
+    GrayScottSimulation cart(rank, size, gridSize, gridSize, gridSize, params, cartOptions);
+    if (cart.isMultiDimensional()) {
+        double t = report.time([&]() {
+            for (int i = 0; i < iterations; ++i) cart.exchangeHalosCart();
+        });
+        report.add("halo/cart", common + " " + gridName(cart), "us", t / iterations * 1e6, false);
+    }
+    
+    // Interior copy into a dense staging buffer: one memcpy on 1D, row by
+    // row past the ghost strips once Y/X are decomposed
+    {
+        GSSolverOptions options;
+        options.threads = threads;
+        GrayScottSimulation sim(rank, size, gridSize, gridSize, gridSize, params, options);
+        AlignedVector<double> dense(sim.getLocalSize());
+        double t = report.time([&]() {
+            for (int i = 0; i < iterations; ++i) sim.copyU(dense.data());
+        });
+        report.add("copy/contiguous", common + " " + gridName(sim), "GB/s", cells * sizeof(double) / t / 1e9, true);
+    }
+    if (cart.isMultiDimensional()) {
+        AlignedVector<double> dense(cart.getLocalSize());
+        double t = report.time([&]() {
+            for (int i = 0; i < iterations; ++i) cart.copyU(dense.data());
+        });
+        report.add("copy/ghost-strip", common + " " + gridName(cart), "GB/s", cells * sizeof(double) / t / 1e9, true);
+    }
+    
+    // Whole steps (halo + kernel + swap) as gs_sender runs them
+    {
+        GSSolverOptions options;
+        options.threads = threads;
+        GrayScottSimulation sim(rank, size, gridSize, gridSize, gridSize, params, options);
+        double t = report.time([&]() {
+            for (int i = 0; i < iterations; ++i) sim.step();
+        });
+        report.add("step/blocking", common, "Mcells/s", cells / t / 1e6, true);
+    }
+    
+    MPI_Finalize();
+    return 0;
+}
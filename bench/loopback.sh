@@ -0,0 +1,114 @@
+#!/bin/bash
+#
+# Loopback SST benchmark: gs_sender streams to a receiver on this node, once
+# per transport and setting, and the throughput of each run is appended to a
+# JSON lines file in the bench.h format (suite "loopback")
+#
+# Usage: bench/loopback.sh BIN_DIR [results.jsonl]
+#   TRANSPORTS="sockets"                    SST transports to run (e.g. "sockets ucx rdma")
+#   CASES="double float32 fixed16 delta"    settings, see case_options below (also zfp, blosc, async)
+#   RANKS=2 GRID=64 STEPS=200 INTERVAL=10   sender ranks and simulation size
+#   MPIEXEC=mpirun                          launcher, with any flags it needs
+#
+
+set -f   # The compression options contain a '*'
+
+BIN_DIR=$(cd "${1:?Usage: $0 BIN_DIR [results.jsonl]}" && pwd) || exit 1
+RESULTS_FILE=$(realpath -m "${2:-loopback_results.jsonl}")
+TRANSPORTS=${TRANSPORTS:-sockets}
+CASES=${CASES:-double float32 fixed16 delta}
+RANKS=${RANKS:-2}
+GRID=${GRID:-64}
+STEPS=${STEPS:-200}
+INTERVAL=${INTERVAL:-10}
+MPIEXEC=${MPIEXEC:-mpirun}
+TIMEOUT=${TIMEOUT:-300}
+
+WORK_DIR=$(mktemp -d "${TMPDIR:-/tmp}/loopback.XXXXXX")
+trap 'rm -rf "$WORK_DIR"' EXIT
+# Run in it with a relative contact name: the receiver would take a path
+# containing "0x" or ':' for a contact string
+cd "$WORK_DIR"
+
+# gs_sender options, then receiver options, for one case
+case_options() {
+    case $1 in
+        double)  echo "|" ;;
+        float32) echo "--precision=float32|--widen" ;;
+        fixed16) echo "--precision=fixed16|--widen" ;;
+        delta)   echo "--delta|" ;;
+        zfp)     echo "--compress=*:zfp:accuracy=1e-4|" ;;
+        blosc)   echo "--compress=*:blosc:clevel=5|" ;;
+        async)   echo "--async-output|" ;;
+        *)       return 1 ;;
+    esac
+}
+
+# Append one result line
+record() {
+    echo "{\"suite\": \"loopback\", \"case\": \"$1\", \"params\": \"${GRID}^3 ranks=${RANKS} steps=${STEPS}/${INTERVAL}\", \"metric\": \"$2\", \"value\": $3, \"better\": \"$4\"}" >> "$RESULTS_FILE"
+}
+
+FAILED=0
+for TRANSPORT in $TRANSPORTS; do
+    for CASE in $CASES; do
+        if ! OPTIONS=$(case_options "$CASE"); then
+            echo "Unknown case: $CASE"
+            FAILED=$((FAILED + 1))
+            continue
+        fi
+        SENDER_ARGS=${OPTIONS%%|*}
+        RECEIVER_ARGS=${OPTIONS#*|}
+        NAME="${TRANSPORT}/${CASE}"
+        CONTACT=loopback
+        rm -rf "$CONTACT".sst* received.bp
+
+        echo "=== ${NAME} ==="
+        $MPIEXEC -np "$RANKS" "$BIN_DIR/gs_sender" "$GRID" "$STEPS" "$INTERVAL" "$CONTACT" \
+            --transport="$TRANSPORT" $SENDER_ARGS > sender.log 2>&1 &
+        SENDER_PID=$!
+
+        # Wait for the writer's contact file
+        COUNT=0
+        while [ ! -f "$CONTACT.sst" ] && [ $COUNT -lt 30 ] && kill -0 $SENDER_PID 2>/dev/null; do
+            sleep 1
+            COUNT=$((COUNT + 1))
+        done
+        if [ ! -f "$CONTACT.sst" ]; then
+            echo "FAILED: no contact file from gs_sender"
+            tail -n 20 sender.log
+            kill $SENDER_PID 2>/dev/null
+            wait $SENDER_PID 2>/dev/null
+            FAILED=$((FAILED + 1))
+            continue
+        fi
+
+        timeout "$TIMEOUT" $MPIEXEC -np 1 "$BIN_DIR/receiver" "$CONTACT" received.bp \
+            --transport="$TRANSPORT" $RECEIVER_ARGS > receiver.log 2>&1
+        RECEIVER_EXIT=$?
+        wait $SENDER_PID 2>/dev/null
+        SENDER_EXIT=$?
+
+        THROUGHPUT=$(grep -m1 "Average throughput:" receiver.log | awk '{print $3}')
+        LATENCY=$(grep -m1 "End-to-end latency p50/p95/p99:" receiver.log | awk '{print $3}')
+        OUTPUT_TIME=$(grep -m1 "Output time:" sender.log | awk '{print $3}')
+        if [ $SENDER_EXIT -ne 0 ] || [ $RECEIVER_EXIT -ne 0 ] || [ -z "$THROUGHPUT" ]; then
+            echo "FAILED: sender exit $SENDER_EXIT, receiver exit $RECEIVER_EXIT"
+            tail -n 20 sender.log receiver.log
+            FAILED=$((FAILED + 1))
+            continue
+        fi
+
+        echo "Throughput: ${THROUGHPUT} MB/s | latency p50: ${LATENCY:-n/a} ms | output time: ${OUTPUT_TIME:-n/a} s"
+        record "$NAME" "MB/s" "$THROUGHPUT" higher
+        [ -n "$LATENCY" ] && record "$NAME" "ms p50" "$LATENCY" lower
+        [ -n "$OUTPUT_TIME" ] && record "$NAME" "s output" "$OUTPUT_TIME" lower
+    done
+done
+
+echo ""
+echo "Results appended to: ${RESULTS_FILE}"
+if [ $FAILED -gt 0 ]; then
+    echo "${FAILED} runs failed"
+    exit 1
+fi
@@ -0,0 +1,117 @@
+/*
+ * Transfer-buffer microbenchmarks
+ *
+ * Times what the senders and the receiver do with a step's buffers around
+ * the SST transfer itself: receiving into a vector allocated for the step
+ * versus one kept across steps, and encoding/widening the reduced wire
+ * precisions (precision.h).
+ *
+ *   mpirun -np 4 ./relay_bench [ELEMENTS] [--iterations=10]
+ *                              [--huge-pages=thp] [--repeat=5] [--json=FILE]
+ *
+ * ELEMENTS is the doubles per rank and step (default 8M, 64 MB). Results
+ * are in GB/s of doubles over all ranks.
+ */
+
+#include <mpi.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "buffers.h"
+#include "precision.h"
+
+int main(int argc, char* argv[])
+{
+    size_t elements = size_t(8) << 20;
+    int iterations = 10;
+    int repeat = 5;
+    std::string jsonFile;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseBenchOption(arg, "--iterations=", value)) {
+            iterations = std::max(1, std::stoi(value));
+        } else if (parseBenchOption(arg, "--repeat=", value)) {
+            repeat = std::stoi(value);
+        } else if (parseBenchOption(arg, "--json=", value)) {
+            jsonFile = value;
+        } else if (parseBenchOption(arg, "--huge-pages=", value)) {
+            if (!parseHugePages(value, bufferConfig().hugePages)) {
+                std::cerr << "Invalid --huge-pages: " << value << " (expected off, thp or explicit)" << std::endl;
+                return 1;
+            }
+        } else {
+            elements = std::stoull(arg);
+        }
+    }
+    
+    MPI_Init(&argc, &argv);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    
+    BenchReport report("relay_bench", jsonFile, repeat, MPI_COMM_WORLD);
+    std::string common = std::to_string(elements) + " per-rank ranks=" + std::to_string(size);
+    if (bufferConfig().hugePages != HugePages::Off) common += " pages=huge";
+    double bytes = static_cast<double>(elements) * sizeof(double) * size * iterations;
+    
+    if (rank == 0) {
+        std::cout << "=== Transfer-buffer microbenchmarks ===" << std::endl;
+        std::cout << "Iterations per repetition: " << iterations << " | Repetitions: " << report.repeat()
+                  << " (median of the slowest rank)" << std::endl;
+        std::cout << bufferBanner() << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+    }
+    
+    // A field-like source in [0, 1]
+    AlignedVector<double> field(elements);
+    for (size_t i = 0; i < elements; ++i) field[i] = 0.5 + 0.5 * std::sin(i * 1e-3);
+    
+    // Receiving into a fresh vector each step pays the allocation and a
+    // page fault per page; a kept buffer only pays the copy
+    double t = report.time([&]() {
+        for (int i = 0; i < iterations; ++i) {
+            std::vector<double> step(elements);
+            std::memcpy(step.data(), field.data(), elements * sizeof(double));
+        }
+    });
+    report.add("receive/fresh-vector", common, "GB/s", bytes / t / 1e9, true);
+    
+    AlignedVector<double> kept(elements);
+    t = report.time([&]() {
+        for (int i = 0; i < iterations; ++i) std::memcpy(kept.data(), field.data(), elements * sizeof(double));
+    });
+    report.add("receive/kept-buffer", common, "GB/s", bytes / t / 1e9, true);
+    
+    // Wire precisions: sender encode, receiver --widen
+    AlignedVector<float> floats(elements);
+    AlignedVector<uint16_t> fixed(elements);
+    t = report.time([&]() {
+        for (int i = 0; i < iterations; ++i) narrowToFloat(field.data(), floats.data(), elements);
+    });
+    report.add("encode/float32", common, "GB/s", bytes / t / 1e9, true);
+    
+    double lo = 0.0, hi = 1.0, scale = (hi - lo) / 65535.0;
+    t = report.time([&]() {
+        for (int i = 0; i < iterations; ++i) quantize16(field.data(), fixed.data(), elements, lo, 1.0 / scale);
+    });
+    report.add("encode/fixed16", common, "GB/s", bytes / t / 1e9, true);
+    
+    t = report.time([&]() {
+        for (int i = 0; i < iterations; ++i) widenToDouble(floats.data(), kept.data(), elements);
+    });
+    report.add("widen/float32", common, "GB/s", bytes / t / 1e9, true);
+    
+    t = report.time([&]() {
+        for (int i = 0; i < iterations; ++i) widenToDouble(fixed.data(), kept.data(), elements, lo, scale);
+    });
+    report.add("widen/fixed16", common, "GB/s", bytes / t / 1e9, true);
+    
+    MPI_Finalize();
+    return 0;
+}
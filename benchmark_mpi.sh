@@ -5,6 +5,10 @@
 GRID_SIZE=${1:-128}
 TOTAL_STEPS=${2:-1000}
 OUTPUT_INTERVAL=${3:-100}
+# Extra gs_sender options for every run, e.g. GS_ARGS="--async-output"
+GS_ARGS=${GS_ARGS:-}
+# SST transport for every run (auto, rdma, ucx, wan or sockets)
+TRANSPORT=${TRANSPORT:-sockets}
 SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
 RESULTS_FILE="${SCRIPT_DIR}/mpi_benchmark_results.csv"
 HOSTFILE="${SCRIPT_DIR}/hostfile.txt"
@@ -28,6 +32,8 @@ echo "=== MPI Benchmark Suite ==="
 echo "Grid size: ${GRID_SIZE}^3"
 echo "Total steps: ${TOTAL_STEPS}"
 echo "Output interval: ${OUTPUT_INTERVAL}"
+echo "gs_sender options: ${GS_ARGS:-none}"
+echo "SST transport: ${TRANSPORT}"
 echo "Results will be saved to: ${RESULTS_FILE}"
 echo ""
 
@@ -39,9 +45,12 @@ cd "${SCRIPT_DIR}/build"
 # MPI options for multi-node
 MPI_OPTS="--mca btl_tcp_if_include 10.10.1.0/24 --mca oob_tcp_if_include 10.10.1.0/24"
 
-# Disable UCX to prevent SST segfaults with many ranks
-export UCX_TLS=tcp
-export UCX_NET_DEVICES=all
+# The sockets transport no longer goes through UCX, so UCX_TLS is only
+# forwarded when set explicitly (e.g. UCX_TLS=tcp for a flaky UCX install)
+UCX_ENV="-x UCX_NET_DEVICES=${UCX_NET_DEVICES:-all}"
+if [ -n "${UCX_TLS}" ]; then
+    UCX_ENV="${UCX_ENV} -x UCX_TLS=${UCX_TLS}"
+fi
 
 # Force use of /usr/local ADIOS2 (not system package with UCX bugs)
 export LD_LIBRARY_PATH=/usr/local/lib:$LD_LIBRARY_PATH
@@ -60,15 +69,15 @@ for CONFIG in "${CONFIGS[@]}"; do
     if [ "$NODE_TYPE" == "multi_node" ]; then
         # Multi-node run with hostfile
         timeout 300 mpirun -np ${RANKS} ${MPI_OPTS} --hostfile "${HOSTFILE}" \
-            -x UCX_TLS=tcp -x UCX_NET_DEVICES=all \
+            ${UCX_ENV} \
             -x LD_LIBRARY_PATH=/usr/local/lib:$LD_LIBRARY_PATH \
-            ./gs_sender ${GRID_SIZE} ${TOTAL_STEPS} ${OUTPUT_INTERVAL} benchmark-test 2>&1 | tee "${TEMP_OUTPUT}"
+            ./gs_sender ${GRID_SIZE} ${TOTAL_STEPS} ${OUTPUT_INTERVAL} benchmark-test --transport=${TRANSPORT} ${GS_ARGS} 2>&1 | tee "${TEMP_OUTPUT}"
     else
         # Single node run
         timeout 300 mpirun -np ${RANKS} \
-            -x UCX_TLS=tcp -x UCX_NET_DEVICES=all \
+            ${UCX_ENV} \
             -x LD_LIBRARY_PATH=/usr/local/lib:$LD_LIBRARY_PATH \
-            ./gs_sender ${GRID_SIZE} ${TOTAL_STEPS} ${OUTPUT_INTERVAL} benchmark-test 2>&1 | tee "${TEMP_OUTPUT}"
+            ./gs_sender ${GRID_SIZE} ${TOTAL_STEPS} ${OUTPUT_INTERVAL} benchmark-test --transport=${TRANSPORT} ${GS_ARGS} 2>&1 | tee "${TEMP_OUTPUT}"
     fi
     
     # Parse results
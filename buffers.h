@@ -0,0 +1,171 @@
+/*
+ * Aligned, optionally huge-page-backed buffers for fields and transfers
+ *
+ *   --huge-pages=off|thp|explicit   back large buffers with huge pages
+ *                                   (default off)
+ *
+ * AlignedVector<T> is a std::vector whose storage is 64-byte aligned (a
+ * cache line, one AVX-512 vector) and whose resize() leaves new elements
+ * uninitialized, so the first write, by the thread that later works on
+ * them, decides their NUMA placement and no page is faulted in twice.
+ * Buffers of 2 MB and more are mapped on huge-page boundaries: with thp the
+ * kernel is asked to back them with transparent huge pages (madvise), with
+ * explicit they come from the hugetlbfs pool (vm.nr_hugepages) and fall
+ * back to thp when it is empty. Fewer, larger pages cut TLB misses in the
+ * stencil sweeps and the page faults at the start of a large transfer.
+ *
+ * The owners of the buffers (fields, staging slots, relay and wire buffers)
+ * keep them across steps and only grow them, so after the first step no
+ * transfer allocates, and a transport that registers memory sees the same
+ * addresses every step. Set the mode before the first AlignedVector is
+ * allocated; freeing uses it to tell mapped storage from malloc'd.
+ */
+
+#ifndef BUFFERS_H
+#define BUFFERS_H
+
+#include <mpi.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class HugePages {
+    Off,           // Aligned malloc for everything
+    Transparent,   // Huge-page aligned mappings with MADV_HUGEPAGE
+    Explicit       // MAP_HUGETLB, falling back to Transparent
+};
+
+const size_t bufferAlignment = 64;
+const size_t hugePageSize = size_t(2) << 20;   // The default on x86-64 and aarch64
+
+struct BufferConfig {
+    HugePages hugePages = HugePages::Off;
+    std::atomic<size_t> hugetlbFallbacks{0};   // Explicit requests served by THP
+};
+
+inline BufferConfig& bufferConfig()
+{
+    static BufferConfig config;
+    return config;
+}
+
+inline bool parseHugePages(const std::string& name, HugePages& mode)
+{
+    if (name == "off") mode = HugePages::Off;
+    else if (name == "thp") mode = HugePages::Transparent;
+    else if (name == "explicit") mode = HugePages::Explicit;
+    else return false;
+    return true;
+}
+
+inline const char* hugePagesName(HugePages mode)
+{
+    switch (mode) {
+        case HugePages::Transparent: return "transparent huge pages";
+        case HugePages::Explicit: return "explicit huge pages";
+        default: return "normal pages";
+    }
+}
+
+inline bool mappedBuffer(size_t bytes)
+{
+    return bufferConfig().hugePages != HugePages::Off && bytes >= hugePageSize;
+}
+
+inline size_t mappedLength(size_t bytes)
+{
+    return (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+}
+
+inline void* allocateBuffer(size_t bytes)
+{
+    if (!mappedBuffer(bytes)) {
+        void* p = nullptr;
+        if (posix_memalign(&p, bufferAlignment, std::max<size_t>(bytes, 1)) != 0) throw std::bad_alloc();
+        return p;
+    }
+    size_t length = mappedLength(bytes);
+    if (bufferConfig().hugePages == HugePages::Explicit) {
+        void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) return p;
+        bufferConfig().hugetlbFallbacks++;
+    }
+    // Over-map by one huge page and trim, so the buffer starts on a boundary
+    // and every 2 MB of it can become one huge page
+    void* raw = mmap(nullptr, length + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) throw std::bad_alloc();
+    uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (begin + hugePageSize - 1) / hugePageSize * hugePageSize;
+    if (aligned > begin) munmap(raw, aligned - begin);
+    size_t tail = hugePageSize - (aligned - begin);
+    if (tail > 0) munmap(reinterpret_cast<void*>(aligned + length), tail);
+    void* p = reinterpret_cast<void*>(aligned);
+    madvise(p, length, MADV_HUGEPAGE);   // Advisory: a kernel without THP keeps normal pages
+    return p;
+}
+
+inline void freeBuffer(void* p, size_t bytes)
+{
+    if (!p) return;
+    if (mappedBuffer(bytes)) {
+        munmap(p, mappedLength(bytes));
+    } else {
+        std::free(p);
+    }
+}
+
+// Aligned storage whose value-less construct() leaves elements uninitialized
+template <class T>
+struct BufferAllocator {
+    typedef T value_type;
+
+    BufferAllocator() = default;
+    template <class U> BufferAllocator(const BufferAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(allocateBuffer(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { freeBuffer(p, n * sizeof(T)); }
+
+    template <class U> void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <class U, class... Args> void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <class T, class U>
+bool operator==(const BufferAllocator<T>&, const BufferAllocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const BufferAllocator<T>&, const BufferAllocator<U>&) { return false; }
+
+template <class T>
+using AlignedVector = std::vector<T, BufferAllocator<T>>;
+
+// Startup line for the banner, e.g. "Buffers: 64-byte aligned, transparent
+// huge pages from 2 MB"
+inline std::string bufferBanner()
+{
+    HugePages mode = bufferConfig().hugePages;
+    std::string line = "Buffers: " + std::to_string(bufferAlignment) + "-byte aligned";
+    if (mode != HugePages::Off) line += std::string(", ") + hugePagesName(mode) + " from 2 MB";
+    return line;
+}
+
+// Buffers that wanted explicit huge pages and got transparent ones, summed
+// over comm (collective). Empty unless there were some, and on other ranks.
+inline std::string bufferSummary(MPI_Comm comm)
+{
+    unsigned long long local = bufferConfig().hugetlbFallbacks.load(), total = 0;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Reduce(&local, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm);
+    if (rank != 0 || total == 0) return "";
+    return "Warning: " + std::to_string(total) + " buffers found no free explicit huge pages and used "
+           "transparent ones (raise vm.nr_hugepages)";
+}
+
+#endif // BUFFERS_H
@@ -0,0 +1,312 @@
+/*
+ * Sender/receiver clock offset for end-to-end latency
+ *
+ * The senders Put a `timestamp` scalar (system clock, seconds since the
+ * epoch) when a step is produced; the receiver subtracts it from the time
+ * the step has fully arrived. The two clocks are on different hosts, so
+ * sender rank 0 runs a tiny TCP time server and advertises it as the
+ * `clock_server` attribute ("host:port"). Receiver rank 0 connects and does
+ * NTP-style exchanges: it sends its time t0, the server answers with its
+ * time t1, the reply arrives at t2, and the round with the smallest
+ * t2 - t0 gives offset = t1 - (t0 + t2) / 2 (sender minus receiver clock),
+ * good to about half that round trip. The exchange is repeated every few
+ * steps to follow drift. The server answers any number of receivers at
+ * once, each on the connection it keeps for the run. Times travel as raw
+ * doubles, so both hosts must share a byte order.
+ *
+ *   --clock-port=P   (senders)  server port (default 0 = any free port)
+ *   --clock-host=H   (senders)  name to advertise (default: hostname)
+ *   --clock-sync=N   (receiver) re-measure every N steps (default 10, 0 = once)
+ *
+ * Only receiver rank 0 talks to the server. The other receiver ranks may be
+ * on other hosts, so at startup each measures its own offset to rank 0 the
+ * same way over MPI and puts its arrival times on rank 0's clock first.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <adios2.h>
+#include <mpi.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Wall clock in seconds since the epoch, as Put in `timestamp`
+inline double wallClock()
+{
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline bool sendAll(int fd, const void* data, size_t bytes)
+{
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = ::send(fd, p, bytes, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+inline bool recvAll(int fd, void* data, size_t bytes)
+{
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t n = ::recv(fd, p, bytes, 0);
+        if (n <= 0) return false;
+        p += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Answers each 8-byte request with the server's wallClock(), for all
+// connected clients, on one background thread that polls them
+class ClockServer {
+public:
+    explicit ClockServer(int port)
+    {
+        listen_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_ < 0) throw std::runtime_error("clock server: socket() failed");
+        int on = 1;
+        setsockopt(listen_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        socklen_t length = sizeof(addr);
+        if (::bind(listen_, reinterpret_cast<sockaddr*>(&addr), length) != 0 || ::listen(listen_, 16) != 0 ||
+            ::getsockname(listen_, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+            ::close(listen_);
+            throw std::runtime_error("clock server: cannot listen on port " + std::to_string(port));
+        }
+        port_ = ntohs(addr.sin_port);
+        if (::pipe(wake_) != 0) {
+            ::close(listen_);
+            throw std::runtime_error("clock server: pipe() failed");
+        }
+        thread_ = std::thread(&ClockServer::serve, this);
+    }
+
+    ~ClockServer() {
+        char byte = 0;
+        if (::write(wake_[1], &byte, 1) != 1) {}   // Wakes poll()
+        thread_.join();
+        ::close(wake_[0]);
+        ::close(wake_[1]);
+        ::close(listen_);
+    }
+
+    ClockServer(const ClockServer&) = delete;
+    ClockServer& operator=(const ClockServer&) = delete;
+
+    int port() const { return port_; }
+
+    // "host:port" for the clock_server attribute; host defaults to this
+    // machine's name
+    std::string endpoint(const std::string& host) const {
+        char name[256] = "localhost";
+        if (host.empty()) gethostname(name, sizeof(name) - 1);
+        return (host.empty() ? std::string(name) : host) + ":" + std::to_string(port_);
+    }
+
+private:
+    // fds[0] is the wake pipe, fds[1] the listener, the rest clients
+    void serve() {
+        std::vector<pollfd> fds(2);
+        fds[0].fd = wake_[0];
+        fds[1].fd = listen_;
+        for (auto& p : fds) p.events = POLLIN;
+        while (true) {
+            if (::poll(fds.data(), fds.size(), -1) < 0) continue;   // EINTR
+            if (fds[0].revents) break;
+            for (size_t i = 2; i < fds.size();) {
+                bool keep = true;
+                if (fds[i].revents) {
+                    double request, now = 0.0;
+                    keep = recvAll(fds[i].fd, &request, sizeof(request));
+                    if (keep) {
+                        now = wallClock();
+                        keep = sendAll(fds[i].fd, &now, sizeof(now));
+                    }
+                }
+                if (keep) {
+                    ++i;
+                } else {
+                    ::close(fds[i].fd);
+                    fds.erase(fds.begin() + i);
+                }
+            }
+            if (fds[1].revents & POLLIN) {
+                int fd = ::accept(listen_, nullptr, nullptr);
+                if (fd >= 0) {
+                    int on = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                    // A client that stalls mid-request cannot hold up the others for long
+                    timeval timeout{1, 0};
+                    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                    pollfd client;
+                    client.fd = fd;
+                    client.events = POLLIN;
+                    client.revents = 0;
+                    fds.push_back(client);
+                }
+            }
+        }
+        for (size_t i = 2; i < fds.size(); ++i) ::close(fds[i].fd);
+    }
+
+    int listen_ = -1;
+    int port_ = 0;
+    int wake_[2] = {-1, -1};   // Written by the destructor to stop serve()
+    std::thread thread_;
+};
+
+// Rank 0 starts the time server and sets the clock_server attribute on io
+// (before the engine opens). Without a server the receiver reports
+// uncorrected latency, so a failure only warns.
+inline std::unique_ptr<ClockServer> advertiseClock(adios2::IO& io, int port, const std::string& host, int rank)
+{
+    if (rank != 0) return nullptr;
+    try {
+        std::unique_ptr<ClockServer> server(new ClockServer(port));
+        io.DefineAttribute<std::string>("clock_server", server->endpoint(host));
+        return server;
+    } catch (const std::exception& e) {
+        std::cerr << "Warning on rank " << rank << ": " << e.what()
+                  << "; receiver latency will not be clock-corrected" << std::endl;
+        return nullptr;
+    }
+}
+
+// Receiver side: keeps the connection open between measurements
+class ClockSync {
+public:
+    ClockSync() {}
+    ~ClockSync() { if (fd_ >= 0) ::close(fd_); }
+
+    ClockSync(const ClockSync&) = delete;
+    ClockSync& operator=(const ClockSync&) = delete;
+
+    // Connect to "host:port". Returns false (and leaves the offset at 0) if
+    // the server cannot be reached within a few seconds.
+    bool connect(const std::string& endpoint) {
+        size_t colon = endpoint.rfind(':');
+        if (colon == std::string::npos) return false;
+        std::string host = endpoint.substr(0, colon), port = endpoint.substr(colon + 1);
+
+        addrinfo hints, *found = nullptr;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) return false;
+
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0) {
+            freeaddrinfo(found);
+            return false;
+        }
+        timeval timeout{5, 0};   // Bounds connect() and every exchange
+        setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        int on = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        bool ok = ::connect(fd_, found->ai_addr, found->ai_addrlen) == 0;
+        freeaddrinfo(found);
+        if (!ok) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        return ok;
+    }
+
+    bool connected() const { return fd_ >= 0; }
+
+    // `rounds` exchanges; keeps the offset of the fastest round
+    bool sync(int rounds = 8) {
+        if (fd_ < 0) return false;
+        double bestRtt = std::numeric_limits<double>::infinity(), bestOffset = 0.0;
+        for (int r = 0; r < rounds; ++r) {
+            double t0 = wallClock(), t1;
+            if (!sendAll(fd_, &t0, sizeof(t0)) || !recvAll(fd_, &t1, sizeof(t1))) {
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+            double t2 = wallClock();
+            if (t2 - t0 < bestRtt) {
+                bestRtt = t2 - t0;
+                bestOffset = t1 - 0.5 * (t0 + t2);
+            }
+        }
+        offset_ = bestOffset;
+        rtt_ = bestRtt;
+        syncs_++;
+        return true;
+    }
+
+    double offset() const { return offset_; }   // Sender clock minus receiver clock
+    double rtt() const { return rtt_; }         // Of the round the offset came from
+    int syncs() const { return syncs_; }
+
+    // Receiver wall time `t` on the sender's clock
+    double toSender(double t) const { return t + offset_; }
+
+private:
+    int fd_ = -1;
+    double offset_ = 0.0;
+    double rtt_ = 0.0;
+    int syncs_ = 0;
+};
+
+// This rank's offset to rank 0's clock (rank 0 minus this rank, 0 on rank
+// 0), from `rounds` MPI ping-pongs per rank, one rank at a time (collective)
+inline double rankClockOffset(MPI_Comm comm, int rounds = 8)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    const int tag = 7302;
+    double bestRtt = std::numeric_limits<double>::infinity(), bestOffset = 0.0;
+    for (int r = 1; r < size; ++r) {
+        for (int i = 0; i < rounds; ++i) {
+            if (rank == 0) {
+                double request, now;
+                MPI_Recv(&request, 1, MPI_DOUBLE, r, tag, comm, MPI_STATUS_IGNORE);
+                now = wallClock();
+                MPI_Send(&now, 1, MPI_DOUBLE, r, tag, comm);
+            } else if (rank == r) {
+                double t0 = wallClock(), t1;
+                MPI_Send(&t0, 1, MPI_DOUBLE, 0, tag, comm);
+                MPI_Recv(&t1, 1, MPI_DOUBLE, 0, tag, comm, MPI_STATUS_IGNORE);
+                double t2 = wallClock();
+                if (t2 - t0 < bestRtt) {
+                    bestRtt = t2 - t0;
+                    bestOffset = t1 - 0.5 * (t0 + t2);
+                }
+            }
+        }
+    }
+    return bestOffset;
+}
+
+#endif // CLOCK_H
@@ -0,0 +1,495 @@
+/*
+ * Per-variable ADIOS2 compression for the senders
+ *
+ * Operators are chosen at runtime, one spec per variable:
+ *   --compress=U:zfp:accuracy=1e-4
+ *   --compress=V:blosc:clevel=5,compressor=zstd
+ *   --compress=*:sz:accuracy=1e-3       (every floating-point array)
+ *
+ * Lossy operators (zfp, sz, mgard) are only attached to float/double
+ * arrays; lossless ones (blosc, bzip2) to any array. Scalars are never
+ * compressed.
+ *
+ * ADIOS2 does not report how many bytes an operator produced, so the
+ * pipeline periodically compresses one rank-local block into a throwaway
+ * BP5 file on node-local storage (/dev/shm when available) and measures
+ * the resulting size and Put time. Steps in between are extrapolated from
+ * the last probe of each variable.
+ *
+ * CompressionController closes the loop: each step it compares the measured
+ * step time with a target and loosens or tightens one operator parameter
+ * (e.g. zfp accuracy, blosc clevel) within user-given limits.
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <adios2.h>
+#include <mpi.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct CompressionSpec {
+    std::string variable;   // Variable name, or "*" for all floating-point arrays
+    std::string type;       // ADIOS2 operator type (zfp, sz, mgard, blosc, bzip2, ...)
+    adios2::Params params;  // Operator parameters, e.g. accuracy=1e-4
+};
+
+// Parse "VAR:TYPE[:key=value[,key=value...]]"
+inline CompressionSpec parseCompressionSpec(const std::string& text)
+{
+    CompressionSpec spec;
+    size_t first = text.find(':');
+    if (first == std::string::npos || first == 0) {
+        throw std::invalid_argument("invalid compression spec '" + text +
+                                    "' (expected VAR:OPERATOR[:key=value,...])");
+    }
+    spec.variable = text.substr(0, first);
+    size_t second = text.find(':', first + 1);
+    spec.type = text.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1);
+    if (spec.type.empty()) {
+        throw std::invalid_argument("missing operator in compression spec '" + text + "'");
+    }
+    if (second != std::string::npos) {
+        std::stringstream params(text.substr(second + 1));
+        std::string pair;
+        while (std::getline(params, pair, ',')) {
+            size_t eq = pair.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                throw std::invalid_argument("invalid operator parameter '" + pair + "'");
+            }
+            spec.params[pair.substr(0, eq)] = pair.substr(eq + 1);
+        }
+    }
+    return spec;
+}
+
+inline bool isLossyOperator(const std::string& type)
+{
+    return type == "zfp" || type == "sz" || type == "sz3" || type == "mgard" || type == "mgardplus";
+}
+
+class CompressionPipeline {
+public:
+    // Bytes and time for one output step (rank-local or reduced)
+    struct StepStats {
+        double rawBytes = 0.0;
+        double compressedBytes = 0.0;
+        double compressTime = 0.0;
+        double stepTime = 0.0;   // Set by the caller before reduce()
+    };
+
+    CompressionPipeline(adios2::ADIOS& adios, int rank)
+        : adios_(adios), probeAdios_(MPI_COMM_SELF), rank_(rank)
+    {
+        probeIO_ = probeAdios_.DeclareIO("CompressionProbe");
+        probeIO_.SetEngine("BP5");
+        probeDir_ = (access("/dev/shm", W_OK) == 0) ? "/dev/shm" : "/tmp";
+    }
+
+    void addSpec(const std::string& text) { specs_.push_back(parseCompressionSpec(text)); }
+    bool enabled() const { return !specs_.empty(); }
+
+    // Probe every N output steps (0 disables measurement)
+    void setProbeInterval(int interval) { probeInterval_ = interval; }
+    bool shouldProbe(size_t outputStep) const {
+        return enabled() && (probeStale_ || (probeInterval_ > 0 && outputStep % probeInterval_ == 0));
+    }
+
+    // Spec that applies to a variable, or nullptr. Exact names win over "*".
+    template <class T>
+    const CompressionSpec* lookup(const std::string& name) const {
+        const CompressionSpec* wildcard = nullptr;
+        for (const auto& spec : specs_) {
+            if (spec.variable == name) return applicable<T>(spec) ? &spec : nullptr;
+            if (spec.variable == "*" && !wildcard) wildcard = &spec;
+        }
+        if (wildcard && isFloatingPoint<T>() && applicable<T>(*wildcard)) return wildcard;
+        return nullptr;
+    }
+
+    // Attach the configured operator to an array variable. Returns false if
+    // no spec applies.
+    template <class T>
+    bool attach(adios2::Variable<T>& var) {
+        if (var.Shape().empty()) return false;
+        const CompressionSpec* spec = lookup<T>(var.Name());
+        if (!spec) return false;
+        size_t operation = var.AddOperation(getOperator(adios_, mainOperators_, spec->type), spec->params);
+        bindings_.push_back({static_cast<size_t>(spec - specs_.data()),
+                             [var, operation](const std::string& key, const std::string& value) mutable {
+                                 var.SetOperationParameter(operation, key, value);
+                             }});
+        stats_[var.Name()];  // Ratio 1 until the first probe
+        return true;
+    }
+
+    // Operator parameter lookup/update across all specs that set `key`.
+    // Updates apply to the attached variables from the next Put on, and the
+    // next step is probed again since the measured ratios are stale.
+    bool hasParameter(const std::string& key) const {
+        for (const auto& spec : specs_) {
+            if (spec.params.count(key)) return true;
+        }
+        return false;
+    }
+
+    std::string parameter(const std::string& key) const {
+        for (const auto& spec : specs_) {
+            auto it = spec.params.find(key);
+            if (it != spec.params.end()) return it->second;
+        }
+        return std::string();
+    }
+
+    void setParameter(const std::string& key, const std::string& value) {
+        for (auto& spec : specs_) {
+            if (spec.params.count(key)) spec.params[key] = value;
+        }
+        for (auto& binding : bindings_) {
+            if (specs_[binding.spec].params.count(key)) binding.set(key, value);
+        }
+        probeStale_ = true;
+    }
+
+    // Compress one local block (count elements, optionally a memory selection
+    // into a padded buffer) and update the variable's measured ratio/speed
+    template <class T>
+    void probe(const std::string& name, const T* data, const adios2::Dims& count,
+               const adios2::Box<adios2::Dims>& memorySelection = adios2::Box<adios2::Dims>()) {
+        const CompressionSpec* spec = lookup<T>(name);
+        if (!spec) return;
+
+        size_t elements = 1;
+        for (auto c : count) elements *= c;
+        if (elements == 0) return;
+
+        std::string path = probeDir_ + "/adios2-compress-probe-" + std::to_string(getpid()) +
+                           "-" + std::to_string(rank_) + ".bp";
+        adios2::Variable<T> var = probeIO_.DefineVariable<T>(name, count, adios2::Dims(count.size(), 0), count);
+        if (!memorySelection.first.empty()) var.SetMemorySelection(memorySelection);
+        var.AddOperation(getOperator(probeAdios_, probeOperators_, spec->type), spec->params);
+
+        adios2::Engine engine = probeIO_.Open(path, adios2::Mode::Write);
+        engine.BeginStep();
+        auto start = std::chrono::high_resolution_clock::now();
+        engine.Put(var, data, adios2::Mode::Sync);
+        double seconds = std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        engine.EndStep();
+        engine.Close();
+        probeIO_.RemoveAllVariables();
+
+        double rawBytes = static_cast<double>(elements * sizeof(T));
+        double compressedBytes = static_cast<double>(fileSize(path + "/data.0"));
+        removeBPDirectory(path);
+
+        VariableStats& vs = stats_[name];
+        vs.ratio = (compressedBytes > 0.0) ? rawBytes / compressedBytes : 1.0;
+        vs.secondsPerByte = seconds / rawBytes;
+    }
+
+    // Account for one Put of `elements` values of a variable in this step
+    template <class T>
+    void record(const std::string& name, size_t elements) {
+        double raw = static_cast<double>(elements * sizeof(T));
+        step_.rawBytes += raw;
+        auto it = stats_.find(name);
+        if (it == stats_.end()) {
+            step_.compressedBytes += raw;
+        } else {
+            step_.compressedBytes += raw / it->second.ratio;
+            step_.compressTime += raw * it->second.secondsPerByte;
+        }
+    }
+
+    // Return this rank's totals for the step and reset them
+    StepStats takeStepStats() {
+        StepStats s = step_;
+        step_ = StepStats();
+        probeStale_ = false;
+        return s;
+    }
+
+    // Sum bytes across ranks; compression and step time are the slowest rank's
+    static StepStats reduce(const StepStats& local, MPI_Comm comm) {
+        StepStats global;
+        double bytes[2] = {local.rawBytes, local.compressedBytes};
+        double sums[2] = {0.0, 0.0};
+        double times[2] = {local.compressTime, local.stepTime};
+        double maxima[2] = {0.0, 0.0};
+        MPI_Reduce(bytes, sums, 2, MPI_DOUBLE, MPI_SUM, 0, comm);
+        MPI_Reduce(times, maxima, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+        global.rawBytes = sums[0];
+        global.compressedBytes = sums[1];
+        global.compressTime = maxima[0];
+        global.stepTime = maxima[1];
+        return global;
+    }
+
+    // Per-step report suffix: compressed size, ratio, compression time and
+    // the throughput actually put on the wire
+    static std::string formatStep(const StepStats& global, double stepTime) {
+        double compressedMB = global.compressedBytes / (1024.0 * 1024.0);
+        double ratio = global.compressedBytes > 0.0 ? global.rawBytes / global.compressedBytes : 1.0;
+        std::ostringstream out;
+        out << std::fixed
+            << " | Compressed: " << std::setw(8) << std::setprecision(2) << compressedMB << " MB"
+            << " (" << std::setprecision(2) << ratio << "x)"
+            << " | Compress: " << std::setprecision(3) << global.compressTime << " s"
+            << " | Wire: " << std::setw(8) << std::setprecision(2) << compressedMB / stepTime << " MB/s";
+        return out.str();
+    }
+
+    // Accumulate reduced step totals for the end-of-run summary (rank 0)
+    void accumulate(const StepStats& global) {
+        total_.rawBytes += global.rawBytes;
+        total_.compressedBytes += global.compressedBytes;
+        total_.compressTime += global.compressTime;
+    }
+
+    void printConfig(std::ostream& out) const {
+        if (!enabled()) return;
+        out << "Compression: ";
+        for (size_t i = 0; i < specs_.size(); ++i) {
+            out << (i ? ", " : "") << specs_[i].variable << "=" << specs_[i].type;
+            for (const auto& kv : specs_[i].params) out << ":" << kv.first << "=" << kv.second;
+        }
+        out << " (probe every " << probeInterval_ << " steps)" << std::endl;
+    }
+
+    void printSummary(std::ostream& out) const {
+        if (!enabled()) return;
+        double ratio = total_.compressedBytes > 0.0 ? total_.rawBytes / total_.compressedBytes : 1.0;
+        out << std::fixed
+            << "Raw data: " << std::setprecision(2) << total_.rawBytes / (1024.0 * 1024.0) << " MB"
+            << " | Compressed (estimated): " << total_.compressedBytes / (1024.0 * 1024.0) << " MB"
+            << " | Ratio: " << ratio << "x"
+            << " | Compression time: " << std::setprecision(3) << total_.compressTime << " s"
+            << std::endl;
+    }
+
+private:
+    struct VariableStats {
+        double ratio = 1.0;
+        double secondsPerByte = 0.0;
+    };
+
+    // Attached variable and the spec its operator was built from
+    struct Binding {
+        size_t spec;
+        std::function<void(const std::string&, const std::string&)> set;
+    };
+
+    template <class T> static bool isFloatingPoint() {
+        return std::is_floating_point<T>::value;
+    }
+
+    template <class T> static bool applicable(const CompressionSpec& spec) {
+        return !isLossyOperator(spec.type) || isFloatingPoint<T>();
+    }
+
+    static adios2::Operator getOperator(adios2::ADIOS& adios, std::map<std::string, adios2::Operator>& cache,
+                                        const std::string& type) {
+        auto it = cache.find(type);
+        if (it != cache.end()) return it->second;
+        adios2::Operator op = adios.DefineOperator(type + "-compressor", type);
+        cache[type] = op;
+        return op;
+    }
+
+    static size_t fileSize(const std::string& path) {
+        struct stat st;
+        return (stat(path.c_str(), &st) == 0) ? static_cast<size_t>(st.st_size) : 0;
+    }
+
+    // BP5 output is a flat directory of data/metadata files
+    static void removeBPDirectory(const std::string& path) {
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return;
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") unlink((path + "/" + name).c_str());
+        }
+        closedir(dir);
+        rmdir(path.c_str());
+    }
+
+    adios2::ADIOS& adios_;
+    adios2::ADIOS probeAdios_;
+    adios2::IO probeIO_;
+    std::string probeDir_;
+    int rank_;
+    int probeInterval_ = 10;
+    bool probeStale_ = false;
+
+    std::vector<CompressionSpec> specs_;
+    std::vector<Binding> bindings_;
+    std::map<std::string, adios2::Operator> mainOperators_, probeOperators_;
+    std::map<std::string, VariableStats> stats_;
+    StepStats step_, total_;
+};
+
+// Step-time feedback for one operator parameter.
+//
+//   --adapt=PARAM:MIN:MAX      parameter and the accuracy limits it may span
+//   --adapt-target=2.5s        target step time, or
+//   --adapt-target=400MB/s     target application (uncompressed) bandwidth
+//
+// A step slower than the target by more than the tolerance loosens the
+// parameter (more compression), a faster one tightens it (more accuracy).
+// Integer limits (clevel, precision, rate) move by 1, others by a factor 2.
+// Rank 0 decides and broadcasts, so all ranks always use the same setting.
+class CompressionController {
+public:
+    CompressionController(CompressionPipeline& pipeline, int rank)
+        : pipeline_(pipeline), rank_(rank) {}
+
+    // Throws std::invalid_argument on malformed options
+    void configure(const std::string& adapt, const std::string& target, const std::string& logPath) {
+        if (adapt.empty() && target.empty()) return;
+        if (adapt.empty() || target.empty()) {
+            throw std::invalid_argument("adaptive compression needs both --adapt and --adapt-target");
+        }
+
+        size_t first = adapt.find(':');
+        size_t second = (first == std::string::npos) ? first : adapt.find(':', first + 1);
+        if (first == 0 || second == std::string::npos) {
+            throw std::invalid_argument("invalid --adapt '" + adapt + "' (expected PARAM:MIN:MAX)");
+        }
+        key_ = adapt.substr(0, first);
+        std::string minText = adapt.substr(first + 1, second - first - 1);
+        std::string maxText = adapt.substr(second + 1);
+        min_ = std::stod(minText);
+        max_ = std::stod(maxText);
+        integer_ = isInteger(minText) && isInteger(maxText);
+        if (min_ > max_ || (!integer_ && min_ <= 0.0)) {
+            throw std::invalid_argument("invalid --adapt range " + minText + ":" + maxText);
+        }
+        if (!pipeline_.hasParameter(key_)) {
+            throw std::invalid_argument("--adapt parameter '" + key_ + "' is not set by any --compress spec");
+        }
+        // Error bounds compress more as they grow; rate/precision as they shrink
+        looserIsLarger_ = (key_ != "rate" && key_ != "precision");
+
+        size_t unit = target.find_first_not_of("0123456789.eE+-");
+        targetValue_ = std::stod(target.substr(0, unit));
+        std::string suffix = (unit == std::string::npos) ? "" : target.substr(unit);
+        if (suffix == "MB/s") {
+            targetIsBandwidth_ = true;
+        } else if (!suffix.empty() && suffix != "s") {
+            throw std::invalid_argument("invalid --adapt-target '" + target + "' (use e.g. 2.5s or 400MB/s)");
+        }
+        if (targetValue_ <= 0.0) {
+            throw std::invalid_argument("--adapt-target must be positive");
+        }
+
+        // Start from the configured value, clamped into the limits
+        value_ = clamp(std::stod(pipeline_.parameter(key_)));
+        pipeline_.setParameter(key_, format(value_));
+
+        if (rank_ == 0) {
+            log_.open(logPath);
+            if (!log_) throw std::runtime_error("cannot open " + logPath);
+            log_ << "Step,StepTime(s),TargetTime(s),Raw(MB),Compressed(MB),Ratio,Param,Value,NextValue,Decision\n";
+        }
+        enabled_ = true;
+        logPath_ = logPath;
+    }
+
+    bool enabled() const { return enabled_; }
+
+    void printConfig(std::ostream& out) const {
+        if (!enabled_) return;
+        out << "Adaptive compression: " << key_ << " in [" << format(min_) << ", " << format(max_)
+            << "], target " << targetValue_ << (targetIsBandwidth_ ? " MB/s" : " s")
+            << ", start " << format(value_) << " (log: " << logPath_ << ")" << std::endl;
+    }
+
+    // Collective. Rank 0 decides from the reduced step totals and the
+    // slowest rank's step time; the new value takes effect from the next step.
+    void update(size_t step, const CompressionPipeline::StepStats& global) {
+        if (!enabled_) return;
+
+        double next = value_;
+        if (rank_ == 0) {
+            double stepTime = global.stepTime;
+            double rawMB = global.rawBytes / (1024.0 * 1024.0);
+            double compressedMB = global.compressedBytes / (1024.0 * 1024.0);
+            double targetTime = targetIsBandwidth_ ? rawMB / targetValue_ : targetValue_;
+
+            const char* decision = "hold";
+            if (stepTime > targetTime * (1.0 + tolerance_)) {
+                next = clamp(loosen(value_));
+                decision = (next != value_) ? "loosen" : "limit";
+            } else if (stepTime < targetTime * (1.0 - tolerance_)) {
+                next = clamp(tighten(value_));
+                decision = (next != value_) ? "tighten" : "limit";
+            }
+
+            log_ << step << "," << stepTime << "," << targetTime << "," << rawMB << "," << compressedMB << ","
+                 << (compressedMB > 0.0 ? rawMB / compressedMB : 1.0) << "," << key_ << ","
+                 << format(value_) << "," << format(next) << "," << decision << std::endl;
+            if (next != value_) {
+                std::cout << "  Adapt: " << key_ << " " << format(value_) << " -> " << format(next)
+                          << " (" << decision << ", step " << std::fixed << std::setprecision(3) << stepTime
+                          << " s vs target " << targetTime << " s)" << std::endl;
+            }
+        }
+
+        MPI_Bcast(&next, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (next != value_) {
+            value_ = next;
+            pipeline_.setParameter(key_, format(value_));
+        }
+    }
+
+private:
+    static bool isInteger(const std::string& text) {
+        return !text.empty() && text.find_first_not_of("0123456789") == std::string::npos;
+    }
+
+    double clamp(double v) const { return v < min_ ? min_ : (v > max_ ? max_ : v); }
+    double larger(double v) const { return integer_ ? v + 1.0 : v * factor_; }
+    double smaller(double v) const { return integer_ ? v - 1.0 : v / factor_; }
+    double loosen(double v) const { return looserIsLarger_ ? larger(v) : smaller(v); }
+    double tighten(double v) const { return looserIsLarger_ ? smaller(v) : larger(v); }
+
+    std::string format(double v) const {
+        if (integer_) return std::to_string(static_cast<long>(std::lround(v)));
+        std::ostringstream out;
+        out << std::setprecision(6) << v;
+        return out.str();
+    }
+
+    CompressionPipeline& pipeline_;
+    int rank_;
+    bool enabled_ = false;
+    std::string key_;
+    double min_ = 0.0, max_ = 0.0, value_ = 0.0;
+    bool integer_ = false;
+    bool looserIsLarger_ = true;
+    double targetValue_ = 0.0;
+    bool targetIsBandwidth_ = false;
+    double tolerance_ = 0.1;   // Dead band around the target, avoids flapping
+    double factor_ = 2.0;
+    std::string logPath_;
+    std::ofstream log_;
+};
+
+#endif // COMPRESSION_H
@@ -0,0 +1,40 @@
+/*
+ * ADIOS2 runtime configuration files
+ *
+ *   --config=FILE   e.g. adios2_config_sender.xml / adios2_config_receiver.xml
+ *
+ * Every ADIOS object is created with the config file (an empty name means
+ * none). The executables only fill in the engine type and the parameters
+ * an <io> section leaves unset, so QueueLimit, MarshalMethod,
+ * StepDistributionMode, ... can be tuned without a recompile. Command line
+ * options that name a parameter explicitly (--bp-async, the autotuner's
+ * trials) still win. SST transport parameters come from --transport, or
+ * from the XML's DataTransport when --transport is not given
+ * (see transport.h).
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <adios2.h>
+#include <string>
+
+// Engine and default parameters of io, below whatever the XML set. An IO
+// without its own <io> section takes the one of `inherit` (stripe k > 0 of
+// a striped stream uses stripe 0's section).
+inline void configureIO(adios2::IO& io, const std::string& engine, const adios2::Params& defaults,
+                        adios2::IO* inherit = nullptr)
+{
+    adios2::Params params = defaults;
+    adios2::IO* source = io.InConfigFile() ? &io
+                       : (inherit && inherit->InConfigFile()) ? inherit : nullptr;
+    if (source) {
+        for (const auto& p : source->Parameters()) params[p.first] = p.second;
+        io.SetEngine(source->EngineType().empty() ? engine : source->EngineType());
+    } else {
+        io.SetEngine(engine);
+    }
+    io.SetParameters(params);
+}
+
+#endif // CONFIG_H
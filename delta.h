@@ -0,0 +1,295 @@
+/*
+ * Temporal delta encoding of double fields
+ *
+ *   --delta[=TOL]        send only tiles that changed since the last output
+ *                        (TOL > 0: changed by more than TOL anywhere)
+ *   --delta-tile=N       elements per tile (default 4096, 32 KB)
+ *   --delta-keyframe=K   send every tile every K outputs (default 50)
+ *
+ * Each rank cuts its block of a field into tiles of N elements (row-major)
+ * and compares them with what it last sent. Only changed tiles go out, as
+ * one local array per rank, "<name>/delta" (doubles):
+ *
+ *   version, flags (1 = keyframe), output sequence, ndim, shape[ndim],
+ *   start[ndim], count[ndim], tile elements, changed tiles, their tile
+ *   indices, then their values
+ *
+ * With TOL the sender compares against its copy of what the receiver holds,
+ * not the previous step, so the rebuilt field never drifts by more than TOL.
+ * Keyframes let a receiver that joins late, or fell out of step, start over.
+ * The receiver keeps each writer block, applies the tiles and writes the
+ * whole field <name> to BP5 as if it had been sent in full.
+ *
+ * A delta only applies on top of the one before it, so every reader must
+ * get every output: the sender refuses steps that SST may drop (Discard)
+ * or hand to another reader (a distribution other than all). A receiver
+ * that still misses one (--monitor) sees the gap in the output sequence
+ * and warns that the block is stale until the next keyframe.
+ */
+
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <adios2.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "buffers.h"
+#include "relay.h"
+
+struct DeltaOptions {
+    bool enabled = false;
+    double tolerance = 0.0;      // 0 = bit-exact
+    size_t tileElements = 4096;
+    int keyframeInterval = 50;   // 0 = only the first output
+};
+
+const double deltaVersion = 2.0;
+
+// Throws unless the (final) SST parameters deliver every step to every reader
+inline void checkDeltaStream(const adios2::Params& params)
+{
+    auto policy = params.find("QueueFullPolicy");
+    if (policy != params.end() && policy->second == "Discard") {
+        throw std::invalid_argument("--delta cannot be used with QueueFullPolicy=Discard");
+    }
+    auto mode = params.find("StepDistributionMode");
+    if (mode != params.end() && mode->second != "AllToAll") {
+        throw std::invalid_argument("--delta needs --distribute=all (got " + mode->second + ")");
+    }
+}
+
+// Sender side: one rank's block of a field
+class DeltaField {
+public:
+    DeltaField(adios2::IO& io, const std::string& name, const adios2::Dims& shape, const adios2::Dims& start,
+               const adios2::Dims& count, const DeltaOptions& options)
+        : shape_(shape), start_(start), count_(count), options_(options)
+    {
+        options_.tileElements = std::max<size_t>(1, options_.tileElements);
+        elements_ = blockElements(count);
+        tiles_ = (elements_ + options_.tileElements - 1) / options_.tileElements;
+        var_ = io.DefineVariable<double>(name + "/delta", {}, {}, {1});
+    }
+
+    // Encode src (count elements, dense) and Put the changed tiles. The Put
+    // is deferred: the payload stays untouched until the next put().
+    void put(adios2::Engine& engine, const double* src, int outputIndex) {
+        bool keyframe = sent_ == 0 || reference_.empty() ||
+                        (options_.keyframeInterval > 0 && outputIndex % options_.keyframeInterval == 0);
+        if (reference_.size() != elements_) reference_.resize(elements_);
+
+        changed_.clear();
+        for (size_t t = 0; t < tiles_; ++t) {
+            size_t begin = t * options_.tileElements;
+            size_t n = std::min(options_.tileElements, elements_ - begin);
+            if (keyframe || tileChanged(src + begin, reference_.data() + begin, n)) {
+                changed_.push_back(t);
+                std::memcpy(reference_.data() + begin, src + begin, n * sizeof(double));
+            }
+        }
+
+        size_t nd = count_.size();
+        payload_.clear();
+        payload_.push_back(deltaVersion);
+        payload_.push_back(keyframe ? 1.0 : 0.0);
+        payload_.push_back(static_cast<double>(sent_));
+        payload_.push_back(static_cast<double>(nd));
+        for (auto v : shape_) payload_.push_back(static_cast<double>(v));
+        for (auto v : start_) payload_.push_back(static_cast<double>(v));
+        for (auto v : count_) payload_.push_back(static_cast<double>(v));
+        payload_.push_back(static_cast<double>(options_.tileElements));
+        payload_.push_back(static_cast<double>(changed_.size()));
+        for (size_t t : changed_) payload_.push_back(static_cast<double>(t));
+        for (size_t t : changed_) {
+            size_t begin = t * options_.tileElements;
+            size_t n = std::min(options_.tileElements, elements_ - begin);
+            payload_.insert(payload_.end(), reference_.data() + begin, reference_.data() + begin + n);
+        }
+
+        var_.SetSelection({{}, {payload_.size()}});
+        engine.Put(var_, payload_.data());
+        sent_++;
+        tilesSent_ += changed_.size();
+        tilesTotal_ += tiles_;
+        bytesSent_ += payload_.size() * sizeof(double);
+        bytesFull_ += elements_ * sizeof(double);
+    }
+
+    size_t lastBytes() const { return payload_.size() * sizeof(double); }
+    size_t lastTiles() const { return changed_.size(); }
+    size_t tiles() const { return tiles_; }
+
+    // Totals over all put() calls
+    size_t tilesSent() const { return tilesSent_; }
+    size_t tilesTotal() const { return tilesTotal_; }
+    size_t bytesSent() const { return bytesSent_; }
+    size_t bytesFull() const { return bytesFull_; }
+
+private:
+    bool tileChanged(const double* now, const double* held, size_t n) const {
+        if (options_.tolerance <= 0.0) return std::memcmp(now, held, n * sizeof(double)) != 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (!(std::fabs(now[i] - held[i]) <= options_.tolerance)) return true;   // NaN counts as changed
+        }
+        return false;
+    }
+
+    adios2::Dims shape_, start_, count_;
+    DeltaOptions options_;
+    size_t elements_ = 0;
+    size_t tiles_ = 0;
+    adios2::Variable<double> var_;
+    AlignedVector<double> reference_;   // What the receiver holds
+    std::vector<size_t> changed_;
+    AlignedVector<double> payload_;
+    size_t sent_ = 0;
+    size_t tilesSent_ = 0, tilesTotal_ = 0;
+    size_t bytesSent_ = 0, bytesFull_ = 0;
+};
+
+// Receiver side: relays "<name>/delta" as the full double field <name>.
+// Writer blocks are split across ranks by index, not size, so each rank
+// keeps rebuilding the same blocks as long as the writer count holds.
+class DeltaRelay : public TypedRelay<double> {
+public:
+    DeltaRelay(const std::string& name, size_t slots)
+        : TypedRelay<double>(name, slots), packets_(slots) {}
+
+    size_t get(adios2::IO& io, adios2::Engine& reader, size_t slot, int rank, int size) override {
+        Buffer& b = buffers_[slot];
+        b.pending = false;
+        b.blocks.clear();
+        if (!in_) in_ = io.InquireVariable<double>(name_ + "/delta");
+        if (!in_) return 0;
+
+        auto infos = reader.BlocksInfo(in_, reader.CurrentStep());
+        std::vector<size_t> mine = blockAssignment(std::vector<size_t>(infos.size(), 1), rank, size);
+        // Packets are kept across steps and only resized, so a steady
+        // stream receives into the same memory every step
+        std::vector<Packet>& packets = packets_[slot];
+        packets.resize(mine.size());
+        size_t bytes = 0;
+        for (size_t j = 0; j < mine.size(); ++j) {
+            Packet& packet = packets[j];
+            packet.block = infos[mine[j]].BlockID;
+            packet.data.resize(blockElements(infos[mine[j]].Count));
+            in_.SetBlockSelection(packet.block);
+            reader.Get(in_, packet.data.data(), adios2::Mode::Deferred);
+            bytes += packet.data.size() * sizeof(double);
+        }
+        b.pending = !packets.empty();
+        return bytes;
+    }
+
+    // Apply the tiles to the kept blocks and copy them into slot's buffer
+    void received(size_t slot) override {
+        Buffer& b = buffers_[slot];
+        if (!b.pending) return;
+        size_t elements = 0;
+        for (const Packet& packet : packets_[slot]) {
+            Held& held = held_[packet.block];
+            apply(packet.data, held);
+            b.shape = held.shape;
+            b.blocks.push_back(Block{held.start, held.count, elements});
+            elements += held.data.size();
+        }
+        if (b.data.size() != elements) b.data.resize(elements);
+        for (size_t j = 0; j < b.blocks.size(); ++j) {
+            const Held& held = held_[packets_[slot][j].block];
+            std::copy(held.data.begin(), held.data.end(), b.data.begin() + b.blocks[j].offset);
+        }
+    }
+
+private:
+    struct Packet {
+        size_t block = 0;            // Writer block ID
+        AlignedVector<double> data;
+    };
+
+    struct Held {
+        adios2::Dims shape, start, count;
+        std::vector<double> data;
+        bool valid = false;           // Seen a keyframe and every output since
+        double sequence = -1.0;       // Of the last applied output
+    };
+
+    // Throws std::runtime_error on a packet that does not fit its header,
+    // before anything is applied
+    void apply(const AlignedVector<double>& p, Held& held) {
+        if (p.size() < 4 || p[0] != deltaVersion) {
+            throw std::runtime_error("unsupported delta encoding of " + name_);
+        }
+        auto malformed = [&]() { return std::runtime_error("malformed delta packet of " + name_); };
+        // A whole number in [0, limit) or the packet is malformed
+        auto whole = [&](double v, double limit) {
+            if (!(v >= 0.0 && v < limit && v == std::floor(v))) throw malformed();
+            return static_cast<size_t>(v);
+        };
+        const double anySize = 9007199254740992.0;   // 2^53, exact in a double
+        bool keyframe = p[1] != 0.0;
+        double sequence = p[2];
+        size_t nd = whole(p[3], 33), pos = 4;
+        if (p.size() < pos + 3 * nd + 2) throw malformed();
+        auto dims = [&]() {
+            adios2::Dims d(nd);
+            for (auto& v : d) v = whole(p[pos++], anySize);
+            return d;
+        };
+        adios2::Dims shape = dims(), start = dims(), count = dims();
+        size_t tileElements = whole(p[pos], anySize);
+        size_t changed = whole(p[pos + 1], static_cast<double>(p.size() - pos - 2) + 1.0);
+        size_t elements = blockElements(count);
+        pos += 2;
+        if (tileElements == 0) throw malformed();
+
+        // Every tile inside the block, every value inside the packet
+        size_t tiles = (elements + tileElements - 1) / tileElements;
+        size_t values = pos + changed;
+        for (size_t i = 0; i < changed; ++i) {
+            size_t begin = whole(p[pos + i], static_cast<double>(tiles)) * tileElements;
+            values += std::min(tileElements, elements - begin);
+            if (values > p.size()) throw malformed();
+        }
+
+        values = pos + changed;
+        held.shape = shape;
+        held.start = start;
+        if (count != held.count) {
+            held.count = count;
+            held.data.assign(elements, 0.0);
+            held.valid = false;
+        }
+        if (keyframe) {
+            held.valid = true;
+        } else if (held.valid && sequence != held.sequence + 1.0) {
+            std::cerr << "Warning: " << name_ << " missed outputs " << static_cast<long long>(held.sequence) + 1
+                      << ".." << static_cast<long long>(sequence) - 1 << " of a writer block, "
+                      << "parts stay stale until the next keyframe" << std::endl;
+            held.valid = false;
+        } else if (!held.valid && held.sequence < 0.0 && !warned_) {
+            std::cerr << "Warning: " << name_ << " joined between keyframes, "
+                      << "parts stay zero until the next one" << std::endl;
+            warned_ = true;
+        }
+        held.sequence = sequence;
+        for (size_t i = 0; i < changed; ++i) {
+            size_t begin = static_cast<size_t>(p[pos + i]) * tileElements;
+            size_t n = std::min(tileElements, elements - begin);
+            std::copy(p.begin() + values, p.begin() + values + n, held.data.begin() + begin);
+            values += n;
+        }
+    }
+
+    std::vector<std::vector<Packet>> packets_;   // [slot][assigned block]
+    std::map<size_t, Held> held_;                // Rebuilt writer blocks by ID
+    bool warned_ = false;
+};
+
+#endif // DELTA_H
@@ -0,0 +1,74 @@
+/*
+ * Several receivers on one SST stream
+ *
+ *   --readers=N                              readers to wait for at open (default 1, 0 = none)
+ *   --distribute=all|round-robin|on-demand   how steps go to the readers (default all)
+ *
+ * SST lets readers join a running stream and leave it at any time; N only
+ * sets how many must have connected before the first step is written.
+ *
+ *   all          every reader gets every step (live analysis plus archive)
+ *   round-robin  step i goes to reader i mod readers, splitting the rate
+ *   on-demand    each step goes to the next reader that asks for one
+ *
+ * A step stays in the writer's queue until every reader it went to has
+ * released it. With all or round-robin a slow reader therefore fills the
+ * queue for everyone (QueueFullPolicy=Block stalls the writer, Discard drops
+ * steps); on-demand only hands it steps when it is ready, so the others keep
+ * their pace. A striped step must reach one reader as a whole, which only
+ * all guarantees.
+ */
+
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <adios2.h>
+#include <stdexcept>
+#include <string>
+
+// StepDistributionMode for --distribute
+inline std::string stepDistributionMode(const std::string& text)
+{
+    if (text == "all") return "AllToAll";
+    if (text == "round-robin") return "RoundRobin";
+    if (text == "on-demand") return "OnDemand";
+    throw std::invalid_argument("unknown step distribution '" + text + "' (use all, round-robin or on-demand)");
+}
+
+// RendezvousReaderCount for --readers
+inline std::string rendezvousReaders(const std::string& text)
+{
+    int readers = std::stoi(text);
+    if (readers < 0) throw std::invalid_argument("--readers must be 0 or more");
+    return std::to_string(readers);
+}
+
+// SST parameters for the fan-out options that were given ("" = not
+// given, keeping the XML's or the built-in value); they override the XML
+inline adios2::Params fanOutParams(const std::string& readers, const std::string& distribution)
+{
+    adios2::Params params;
+    if (!readers.empty()) params["RendezvousReaderCount"] = rendezvousReaders(readers);
+    if (!distribution.empty()) params["StepDistributionMode"] = stepDistributionMode(distribution);
+    return params;
+}
+
+// Throws if the (final) SST parameters would split a striped step
+inline void checkFanOut(const adios2::Params& params, int stripes)
+{
+    auto mode = params.find("StepDistributionMode");
+    if (stripes > 1 && mode != params.end() && mode->second != "AllToAll") {
+        throw std::invalid_argument("--stripes needs --distribute=all (got " + mode->second + ")");
+    }
+}
+
+// e.g. "wait for 2 at open, steps RoundRobin"
+inline std::string describeFanOut(const adios2::Params& params)
+{
+    auto readers = params.find("RendezvousReaderCount");
+    auto mode = params.find("StepDistributionMode");
+    return "wait for " + (readers != params.end() ? readers->second : std::string("1")) + " at open, steps " +
+           (mode != params.end() ? mode->second : std::string("AllToAll"));
+}
+
+#endif // FANOUT_H
@@ -0,0 +1,726 @@
+/*
+ * Gray-Scott reaction-diffusion solver
+ *
+ * GrayScottSimulation advances U and V on a Cartesian decomposition of a
+ * 3D grid: Z has fixed boundaries, Y and X are periodic, and every rank
+ * keeps one ghost layer per decomposed dimension. gs_sender streams its
+ * fields; the benchmarks in bench/ time its kernel, halo exchange and
+ * interior copy on their own.
+ */
+
+#ifndef GRAY_SCOTT_H
+#define GRAY_SCOTT_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "buffers.h"
+#include "trace.h"
+
+// Gray-Scott parameters
+struct GSParams {
+    double Du = 0.2;      // Diffusion rate for U
+    double Dv = 0.1;      // Diffusion rate for V
+    double F  = 0.04;     // Feed rate
+    double k  = 0.06;     // Kill rate
+    double dt = 1.0;      // Time step
+    double dx = 1.0;      // Grid spacing
+};
+
+// resize() does not touch the pages, so the first write (by the thread that
+// will later compute on them) decides their NUMA placement (buffers.h)
+using FieldVector = AlignedVector<double>;
+
+// Contiguous share [begin, end) of [0, total) for thread `part` of `nparts`
+inline void partitionRange(size_t total, int part, int nparts, size_t& begin, size_t& end)
+{
+    size_t base = total / nparts;
+    size_t remainder = total % nparts;
+    size_t p = static_cast<size_t>(part);
+    begin = p * base + std::min(p, remainder);
+    end = begin + base + (p < remainder ? 1 : 0);
+}
+
+inline void currentThread(int& tid, int& nthreads)
+{
+#ifdef _OPENMP
+    tid = omp_get_thread_num();
+    nthreads = omp_get_num_threads();
+#else
+    tid = 0;
+    nthreads = 1;
+#endif
+}
+
+// memcpy split across the OpenMP team (plain memcpy without OpenMP)
+inline void parallelCopy(double* dst, const double* src, size_t n)
+{
+    #pragma omp parallel
+    {
+        int tid, nthreads;
+        currentThread(tid, nthreads);
+        size_t begin, end;
+        partitionRange(n, tid, nthreads, begin, end);
+        if (end > begin) {
+            std::memcpy(dst + begin, src + begin, (end - begin) * sizeof(double));
+        }
+    }
+}
+
+// Halo exchange strategies
+enum class HaloMode {
+    Blocking,   // Four MPI_Sendrecv calls before any compute (reference)
+    Overlap     // Persistent Isend/Irecv, interior computed while in flight
+};
+
+// Stencil kernel implementations
+enum class KernelMode {
+    Reference,  // Straightforward per-cell loop with index() and wrap branches
+    Optimized   // Row-pointer, peeled-boundary, Y-tiled loop the compiler can vectorize
+};
+
+// Solver execution options (independent of the Gray-Scott physics)
+struct GSSolverOptions {
+    HaloMode haloMode = HaloMode::Blocking;
+    KernelMode kernelMode = KernelMode::Optimized;
+    size_t tileRows = 0;    // Y rows per cache tile in the optimized kernel (0 = auto)
+    int threads = 1;        // OpenMP threads per rank (0 = OpenMP default)
+    // Ranks along Z, Y, X; 0 lets MPI_Dims_create choose. {0, 1, 1} is the
+    // original 1D split along Z.
+    int procGrid[3] = {0, 1, 1};
+};
+
+// Even split of n cells over p ranks: extent and offset of part c
+inline void splitExtent(size_t n, int p, int c, size_t& count, size_t& start)
+{
+    size_t base = n / p;
+    size_t remainder = n % p;
+    size_t cc = static_cast<size_t>(c);
+    count = base + (cc < remainder ? 1 : 0);
+    start = cc * base + std::min(cc, remainder);
+}
+
+// Target working set for one Y tile of the optimized kernel: three Z planes
+// of tileRows rows for U and V should stay resident in L2 while streaming Z.
+const size_t kStencilTileBytes = 512 * 1024;
+
+class GrayScottSimulation {
+public:
+    GrayScottSimulation(int rank, int size, 
+                        size_t globalNz, size_t globalNy, size_t globalNx,
+                        const GSParams& params,
+                        const GSSolverOptions& options = GSSolverOptions())
+        : rank_(rank), size_(size), 
+          globalNz_(globalNz), globalNy_(globalNy), globalNx_(globalNx),
+          params_(params), options_(options)
+    {
+        // Cartesian decomposition over Z, Y, X. Z has fixed boundaries, Y and X
+        // are periodic. The communicator is private to the halo exchange so it
+        // never interleaves with collectives issued by an asynchronous output
+        // thread, and reorder=0 keeps cart ranks equal to MPI_COMM_WORLD ranks.
+        int dims[3] = {options_.procGrid[0], options_.procGrid[1], options_.procGrid[2]};
+        int periods[3] = {0, 1, 1};
+        MPI_Dims_create(size_, 3, dims);
+        MPI_Cart_create(MPI_COMM_WORLD, 3, dims, periods, 0, &comm_);
+        int coords[3];
+        MPI_Cart_coords(comm_, rank_, 3, coords);
+        for (int d = 0; d < 3; ++d) procGrid_[d] = dims[d];
+
+        splitExtent(globalNz_, dims[0], coords[0], localNz_, zStart_);
+        splitExtent(globalNy_, dims[1], coords[1], localNy_, yStart_);
+        splitExtent(globalNx_, dims[2], coords[2], localNx_, xStart_);
+
+        // Ghost layers: always 1 cell on each side of Z. Y and X only get
+        // ghosts when they are decomposed; otherwise the periodic wrap is
+        // resolved locally and rows stay dense.
+        ghostY_ = (dims[1] > 1) ? 1 : 0;
+        ghostX_ = (dims[2] > 1) ? 1 : 0;
+        strideY_ = localNx_ + 2 * ghostX_;
+        strideZ_ = (localNy_ + 2 * ghostY_) * strideY_;
+
+        size_t totalSize = (localNz_ + 2) * strideZ_;
+        U_.resize(totalSize);
+        V_.resize(totalSize);
+        U_new_.resize(totalSize);
+        V_new_.resize(totalSize);
+        firstTouch();
+
+        // Seed initial perturbation in center of global domain
+        seedInitialCondition();
+
+        // Determine neighbors for halo exchange (MPI_PROC_NULL at the fixed
+        // Z boundaries; for periodic Z set periods[0] = 1 above)
+        MPI_Cart_shift(comm_, 0, 1, &rankBelow_, &rankAbove_);
+        MPI_Cart_shift(comm_, 1, 1, &rankSouth_, &rankNorth_);
+        MPI_Cart_shift(comm_, 2, 1, &rankWest_, &rankEast_);
+
+        if (isMultiDimensional()) {
+            // The overlapped exchange only splits off Z boundary planes
+            options_.haloMode = HaloMode::Blocking;
+            setupFaceTypes();
+        } else if (options_.haloMode == HaloMode::Overlap) {
+            setupPersistentHalos();
+        }
+    }
+
+    ~GrayScottSimulation() {
+        // The simulation lives in main() and may outlive MPI_Finalize
+        int finalized = 0;
+        MPI_Finalized(&finalized);
+        if (finalized) return;
+        if (options_.haloMode == HaloMode::Overlap) {
+            for (auto& req : haloRequests_) MPI_Request_free(&req);
+        }
+        if (isMultiDimensional()) {
+            MPI_Type_free(&faceTypeZ_);
+            MPI_Type_free(&faceTypeY_);
+            MPI_Type_free(&faceTypeX_);
+        }
+        MPI_Comm_free(&comm_);
+    }
+
+    GrayScottSimulation(const GrayScottSimulation&) = delete;
+    GrayScottSimulation& operator=(const GrayScottSimulation&) = delete;
+
+    // Initialize U=1, V=0 with the same plane partition the kernel threads
+    // use, so each thread's slab is faulted in on its own NUMA node
+    void firstTouch() {
+        size_t plane = strideZ_;
+        #pragma omp parallel
+        {
+            int tid, nthreads;
+            currentThread(tid, nthreads);
+            size_t zBegin, zEnd;
+            partitionRange(localNz_ + 2, tid, nthreads, zBegin, zEnd);
+            for (size_t i = zBegin * plane; i < zEnd * plane; ++i) {
+                U_[i] = 1.0;    // U starts at 1
+                V_[i] = 0.0;    // V starts at 0
+                U_new_[i] = 0.0;
+                V_new_[i] = 0.0;
+            }
+        }
+    }
+
+    void seedInitialCondition() {
+        // Seed a cube of V=0.25, U=0.5 in the center of the domain
+        size_t centerZ = globalNz_ / 2;
+        size_t centerY = globalNy_ / 2;
+        size_t centerX = globalNx_ / 2;
+        size_t seedRadius = std::min({globalNz_, globalNy_, globalNx_}) / 10;
+
+        for (size_t lz = 0; lz < localNz_; ++lz) {
+            size_t gz = zStart_ + lz;
+            for (size_t ly = 0; ly < localNy_; ++ly) {
+                size_t gy = yStart_ + ly;
+                for (size_t lx = 0; lx < localNx_; ++lx) {
+                    size_t gx = xStart_ + lx;
+                    // Check if within seed region
+                    if (std::abs(static_cast<int>(gz) - static_cast<int>(centerZ)) <= static_cast<int>(seedRadius) &&
+                        std::abs(static_cast<int>(gy) - static_cast<int>(centerY)) <= static_cast<int>(seedRadius) &&
+                        std::abs(static_cast<int>(gx) - static_cast<int>(centerX)) <= static_cast<int>(seedRadius)) {
+                        size_t idx = index(lz + 1, ly, lx); // +1 for ghost layer
+                        U_[idx] = 0.5;
+                        V_[idx] = 0.25;
+                    }
+                }
+            }
+        }
+    }
+
+    void exchangeHalos() {
+        TraceScope trace("halo");
+        size_t sliceSize = localNy_ * localNx_;
+        // Eight planes, kept across steps so the exchange never allocates
+        if (haloPlanes_.size() != 8 * sliceSize) haloPlanes_.resize(8 * sliceSize);
+        double* sendBufDown = &haloPlanes_[0];
+        double* recvBufDown = &haloPlanes_[sliceSize];
+        double* sendBufUp = &haloPlanes_[2 * sliceSize];
+        double* recvBufUp = &haloPlanes_[3 * sliceSize];
+        double* sendBufDownV = &haloPlanes_[4 * sliceSize];
+        double* recvBufDownV = &haloPlanes_[5 * sliceSize];
+        double* sendBufUpV = &haloPlanes_[6 * sliceSize];
+        double* recvBufUpV = &haloPlanes_[7 * sliceSize];
+
+        // Pack bottom slice (z=1, first real layer) to send down
+        // Pack top slice (z=localNz_, last real layer) to send up
+        #pragma omp parallel for
+        for (size_t ly = 0; ly < localNy_; ++ly) {
+            for (size_t lx = 0; lx < localNx_; ++lx) {
+                size_t sIdx = ly * localNx_ + lx;
+                sendBufDown[sIdx] = U_[index(1, ly, lx)];
+                sendBufUp[sIdx] = U_[index(localNz_, ly, lx)];
+                sendBufDownV[sIdx] = V_[index(1, ly, lx)];
+                sendBufUpV[sIdx] = V_[index(localNz_, ly, lx)];
+            }
+        }
+
+        // Exchange U halos
+        MPI_Sendrecv(sendBufDown, sliceSize, MPI_DOUBLE, rankBelow_, 0,
+                     recvBufUp, sliceSize, MPI_DOUBLE, rankAbove_, 0,
+                     comm_, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(sendBufUp, sliceSize, MPI_DOUBLE, rankAbove_, 1,
+                     recvBufDown, sliceSize, MPI_DOUBLE, rankBelow_, 1,
+                     comm_, MPI_STATUS_IGNORE);
+
+        // Exchange V halos
+        MPI_Sendrecv(sendBufDownV, sliceSize, MPI_DOUBLE, rankBelow_, 2,
+                     recvBufUpV, sliceSize, MPI_DOUBLE, rankAbove_, 2,
+                     comm_, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(sendBufUpV, sliceSize, MPI_DOUBLE, rankAbove_, 3,
+                     recvBufDownV, sliceSize, MPI_DOUBLE, rankBelow_, 3,
+                     comm_, MPI_STATUS_IGNORE);
+
+        // Unpack into ghost layers
+        #pragma omp parallel for
+        for (size_t ly = 0; ly < localNy_; ++ly) {
+            for (size_t lx = 0; lx < localNx_; ++lx) {
+                size_t sIdx = ly * localNx_ + lx;
+                if (rankAbove_ != MPI_PROC_NULL) {
+                    U_[index(localNz_ + 1, ly, lx)] = recvBufUp[sIdx];
+                    V_[index(localNz_ + 1, ly, lx)] = recvBufUpV[sIdx];
+                }
+                if (rankBelow_ != MPI_PROC_NULL) {
+                    U_[index(0, ly, lx)] = recvBufDown[sIdx];
+                    V_[index(0, ly, lx)] = recvBufDownV[sIdx];
+                }
+            }
+        }
+
+        // Fixed boundary conditions at domain edges
+        if (rankBelow_ == MPI_PROC_NULL) {
+            #pragma omp parallel for
+            for (size_t ly = 0; ly < localNy_; ++ly) {
+                for (size_t lx = 0; lx < localNx_; ++lx) {
+                    U_[index(0, ly, lx)] = U_[index(1, ly, lx)];
+                    V_[index(0, ly, lx)] = V_[index(1, ly, lx)];
+                }
+            }
+        }
+        if (rankAbove_ == MPI_PROC_NULL) {
+            #pragma omp parallel for
+            for (size_t ly = 0; ly < localNy_; ++ly) {
+                for (size_t lx = 0; lx < localNx_; ++lx) {
+                    U_[index(localNz_ + 1, ly, lx)] = U_[index(localNz_, ly, lx)];
+                    V_[index(localNz_ + 1, ly, lx)] = V_[index(localNz_, ly, lx)];
+                }
+            }
+        }
+    }
+
+    // Derived datatypes for the faces of the padded local block. Each face
+    // spans the full padded extent of the other two dimensions, so after
+    // exchanging Z, then Y, then X the ghosts are complete.
+    void setupFaceTypes() {
+        size_t paddedNz = localNz_ + 2;
+        size_t paddedNy = localNy_ + 2 * ghostY_;
+        MPI_Type_contiguous(static_cast<int>(strideZ_), MPI_DOUBLE, &faceTypeZ_);
+        MPI_Type_vector(static_cast<int>(paddedNz), static_cast<int>(strideY_),
+                        static_cast<int>(strideZ_), MPI_DOUBLE, &faceTypeY_);
+        MPI_Type_vector(static_cast<int>(paddedNz * paddedNy), 1,
+                        static_cast<int>(strideY_), MPI_DOUBLE, &faceTypeX_);
+        MPI_Type_commit(&faceTypeZ_);
+        MPI_Type_commit(&faceTypeY_);
+        MPI_Type_commit(&faceTypeX_);
+    }
+
+    // Exchange one dimension's faces of a field in place. Offsets are to the
+    // first/last real layer and the two ghost layers along that dimension.
+    void exchangeFaces(FieldVector& f, MPI_Datatype faceType, int tag,
+                       int rankLow, int rankHigh,
+                       size_t firstReal, size_t lastReal, size_t ghostLow, size_t ghostHigh) {
+        MPI_Sendrecv(&f[firstReal], 1, faceType, rankLow, tag,
+                     &f[ghostHigh], 1, faceType, rankHigh, tag,
+                     comm_, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(&f[lastReal], 1, faceType, rankHigh, tag + 1,
+                     &f[ghostLow], 1, faceType, rankLow, tag + 1,
+                     comm_, MPI_STATUS_IGNORE);
+    }
+
+    // Halo exchange for 2D/3D decompositions, sending straight from the
+    // field arrays with derived datatypes (no pack/unpack buffers)
+    void exchangeHalosCart() {
+        TraceScope trace("halo");
+        FieldVector* fields[2] = {&U_, &V_};
+        for (int f = 0; f < 2; ++f) {
+            FieldVector& field = *fields[f];
+            int tag = 10 * f;
+
+            exchangeFaces(field, faceTypeZ_, tag, rankBelow_, rankAbove_,
+                          strideZ_, localNz_ * strideZ_, 0, (localNz_ + 1) * strideZ_);
+            // Fixed boundary conditions at domain edges
+            if (rankBelow_ == MPI_PROC_NULL) {
+                std::memcpy(&field[0], &field[strideZ_], strideZ_ * sizeof(double));
+            }
+            if (rankAbove_ == MPI_PROC_NULL) {
+                std::memcpy(&field[(localNz_ + 1) * strideZ_], &field[localNz_ * strideZ_],
+                            strideZ_ * sizeof(double));
+            }
+
+            if (ghostY_) {
+                exchangeFaces(field, faceTypeY_, tag + 2, rankSouth_, rankNorth_,
+                              strideY_, localNy_ * strideY_, 0, (localNy_ + 1) * strideY_);
+            }
+            if (ghostX_) {
+                exchangeFaces(field, faceTypeX_, tag + 4, rankWest_, rankEast_,
+                              1, localNx_, 0, localNx_ + 1);
+            }
+        }
+    }
+
+    // Persistent U+V plane buffers and requests for HaloMode::Overlap. Each
+    // message carries the U plane followed by the V plane, so every step is
+    // one send and one receive per neighbour.
+    void setupPersistentHalos() {
+        size_t sliceSize = localNy_ * localNx_;
+        int count = static_cast<int>(2 * sliceSize);
+        haloSendDown_.resize(2 * sliceSize);
+        haloSendUp_.resize(2 * sliceSize);
+        haloRecvDown_.resize(2 * sliceSize);
+        haloRecvUp_.resize(2 * sliceSize);
+
+        // Tag 0 travels downwards (to rankBelow_), tag 1 upwards
+        MPI_Recv_init(haloRecvUp_.data(), count, MPI_DOUBLE, rankAbove_, 0, comm_, &haloRequests_[0]);
+        MPI_Recv_init(haloRecvDown_.data(), count, MPI_DOUBLE, rankBelow_, 1, comm_, &haloRequests_[1]);
+        MPI_Send_init(haloSendDown_.data(), count, MPI_DOUBLE, rankBelow_, 0, comm_, &haloRequests_[2]);
+        MPI_Send_init(haloSendUp_.data(), count, MPI_DOUBLE, rankAbove_, 1, comm_, &haloRequests_[3]);
+    }
+
+    // Pack the first/last real planes and start the persistent requests
+    void beginHaloExchange() {
+        TraceScope trace("halo_start");
+        size_t sliceSize = localNy_ * localNx_;
+        parallelCopy(&haloSendDown_[0], &U_[index(1, 0, 0)], sliceSize);
+        parallelCopy(&haloSendDown_[sliceSize], &V_[index(1, 0, 0)], sliceSize);
+        parallelCopy(&haloSendUp_[0], &U_[index(localNz_, 0, 0)], sliceSize);
+        parallelCopy(&haloSendUp_[sliceSize], &V_[index(localNz_, 0, 0)], sliceSize);
+        MPI_Startall(4, haloRequests_);
+    }
+
+    // Wait for the halo planes and fill the ghost layers
+    void finishHaloExchange() {
+        TraceScope trace("halo_wait");
+        MPI_Waitall(4, haloRequests_, MPI_STATUSES_IGNORE);
+
+        size_t sliceSize = localNy_ * localNx_;
+        if (rankAbove_ != MPI_PROC_NULL) {
+            parallelCopy(&U_[index(localNz_ + 1, 0, 0)], &haloRecvUp_[0], sliceSize);
+            parallelCopy(&V_[index(localNz_ + 1, 0, 0)], &haloRecvUp_[sliceSize], sliceSize);
+        } else {
+            // Fixed boundary condition at the top of the domain
+            parallelCopy(&U_[index(localNz_ + 1, 0, 0)], &U_[index(localNz_, 0, 0)], sliceSize);
+            parallelCopy(&V_[index(localNz_ + 1, 0, 0)], &V_[index(localNz_, 0, 0)], sliceSize);
+        }
+        if (rankBelow_ != MPI_PROC_NULL) {
+            parallelCopy(&U_[index(0, 0, 0)], &haloRecvDown_[0], sliceSize);
+            parallelCopy(&V_[index(0, 0, 0)], &haloRecvDown_[sliceSize], sliceSize);
+        } else {
+            // Fixed boundary condition at the bottom of the domain
+            parallelCopy(&U_[index(0, 0, 0)], &U_[index(1, 0, 0)], sliceSize);
+            parallelCopy(&V_[index(0, 0, 0)], &V_[index(1, 0, 0)], sliceSize);
+        }
+    }
+
+    void step() {
+        if (options_.haloMode == HaloMode::Overlap) {
+            // Planes 2..localNz_-1 only read real layers, so they are
+            // computed while the halo planes are in flight. The two boundary
+            // planes need the ghosts and are finished last.
+            beginHaloExchange();
+            if (localNz_ > 2) {
+                updatePlanes(2, localNz_);
+            }
+            finishHaloExchange();
+            if (localNz_ > 0) {
+                updatePlanes(1, 2);
+            }
+            if (localNz_ > 1) {
+                updatePlanes(localNz_, localNz_ + 1);
+            }
+        } else {
+            if (isMultiDimensional()) {
+                exchangeHalosCart();
+            } else {
+                exchangeHalos();
+            }
+            updatePlanes(1, localNz_ + 1);
+        }
+
+        // Swap buffers
+        std::swap(U_, U_new_);
+        std::swap(V_, V_new_);
+    }
+
+    // Advance the real planes [lzBegin, lzEnd) (ghost-offset indices) into
+    // U_new_/V_new_. Ghost layers must be current for planes 1 and localNz_.
+    void updatePlanes(size_t lzBegin, size_t lzEnd) {
+        TraceScope trace("compute");
+        if (options_.kernelMode == KernelMode::Optimized) {
+            updatePlanesOptimized(lzBegin, lzEnd);
+        } else {
+            updatePlanesReference(lzBegin, lzEnd);
+        }
+    }
+
+    void updatePlanesReference(size_t lzBegin, size_t lzEnd) {
+        double dx2 = params_.dx * params_.dx;
+        double dt = params_.dt;
+        double Du = params_.Du;
+        double Dv = params_.Dv;
+        double F = params_.F;
+        double k = params_.k;
+
+        #pragma omp parallel for schedule(static)
+        for (size_t lz = lzBegin; lz < lzEnd; ++lz) {
+            for (size_t ly = 0; ly < localNy_; ++ly) {
+                for (size_t lx = 0; lx < localNx_; ++lx) {
+                    size_t idx = index(lz, ly, lx);
+
+                    double u = U_[idx];
+                    double v = V_[idx];
+
+                    // 7-point stencil Laplacian
+                    double laplacianU = 0.0;
+                    double laplacianV = 0.0;
+
+                    // Z direction
+                    laplacianU += U_[index(lz - 1, ly, lx)] + U_[index(lz + 1, ly, lx)];
+                    laplacianV += V_[index(lz - 1, ly, lx)] + V_[index(lz + 1, ly, lx)];
+
+                    // Y direction (periodic: local wrap, or ghost rows when decomposed)
+                    size_t idxYM = (ly > 0 || ghostY_) ? idx - strideY_ : index(lz, localNy_ - 1, lx);
+                    size_t idxYP = (ly < localNy_ - 1 || ghostY_) ? idx + strideY_ : index(lz, 0, lx);
+                    laplacianU += U_[idxYM] + U_[idxYP];
+                    laplacianV += V_[idxYM] + V_[idxYP];
+
+                    // X direction (periodic: local wrap, or ghost columns when decomposed)
+                    size_t idxXM = (lx > 0 || ghostX_) ? idx - 1 : index(lz, ly, localNx_ - 1);
+                    size_t idxXP = (lx < localNx_ - 1 || ghostX_) ? idx + 1 : index(lz, ly, 0);
+                    laplacianU += U_[idxXM] + U_[idxXP];
+                    laplacianV += V_[idxXM] + V_[idxXP];
+
+                    laplacianU = (laplacianU - 6.0 * u) / dx2;
+                    laplacianV = (laplacianV - 6.0 * v) / dx2;
+
+                    // Gray-Scott reaction terms
+                    double uvv = u * v * v;
+                    double dudt = Du * laplacianU - uvv + F * (1.0 - u);
+                    double dvdt = Dv * laplacianV + uvv - (F + k) * v;
+
+                    U_new_[idx] = u + dt * dudt;
+                    V_new_[idx] = v + dt * dvdt;
+
+                    // Clamp values to [0, 1]
+                    U_new_[idx] = std::max(0.0, std::min(1.0, U_new_[idx]));
+                    V_new_[idx] = std::max(0.0, std::min(1.0, V_new_[idx]));
+                }
+            }
+        }
+
+    }
+
+    // Same arithmetic as updatePlanesReference, evaluated in the same order so
+    // results match bit-for-bit (barring compiler FMA contraction). The Y/X
+    // periodic wraps are resolved once per row, the first and last cell of
+    // each row are peeled so the inner loop is branch-free unit-stride, and Y
+    // is tiled so the three Z planes of a tile stay in cache while Z streams.
+    void updatePlanesOptimized(size_t lzBegin, size_t lzEnd) {
+        const size_t nx = localNx_;
+        const size_t ny = localNy_;
+        const size_t plane = strideZ_;
+
+        size_t tileRows = options_.tileRows;
+        if (tileRows == 0) {
+            tileRows = std::max<size_t>(1, kStencilTileBytes / (2 * 3 * nx * sizeof(double)));
+        }
+
+        // Each thread streams Z through its own slab of planes (the same
+        // partition firstTouch() used). Ranges with fewer planes than threads,
+        // such as the boundary planes of the overlapped halo mode, are split
+        // by rows instead.
+        #pragma omp parallel
+        {
+            int tid, nthreads;
+            currentThread(tid, nthreads);
+            size_t zBegin = lzBegin, zEnd = lzEnd;
+            size_t yBegin = 0, yEnd = ny;
+            if (lzEnd - lzBegin >= static_cast<size_t>(nthreads)) {
+                partitionRange(lzEnd - lzBegin, tid, nthreads, zBegin, zEnd);
+                zBegin += lzBegin;
+                zEnd += lzBegin;
+            } else {
+                partitionRange(ny, tid, nthreads, yBegin, yEnd);
+            }
+
+            for (size_t y0 = yBegin; y0 < yEnd; y0 += tileRows) {
+                size_t y1 = std::min(yEnd, y0 + tileRows);
+                for (size_t lz = zBegin; lz < zEnd; ++lz) {
+                    for (size_t ly = y0; ly < y1; ++ly) {
+                        size_t row = index(lz, ly, 0);
+                        size_t rowM = (ly > 0 || ghostY_) ? row - strideY_ : index(lz, ny - 1, 0);
+                        size_t rowP = (ly < ny - 1 || ghostY_) ? row + strideY_ : index(lz, 0, 0);
+
+                        updateRow(&U_[row], &U_[row - plane], &U_[row + plane], &U_[rowM], &U_[rowP],
+                                  &V_[row], &V_[row - plane], &V_[row + plane], &V_[rowM], &V_[rowP],
+                                  &U_new_[row], &V_new_[row], nx, ghostX_ != 0);
+                    }
+                }
+            }
+        }
+    }
+
+    // Data pointer to hand to Put(). For the 1D decomposition ghosts are
+    // only in Z, so the interior is one contiguous block of getLocalSize()
+    // elements starting at the first real layer and can be written without
+    // a copy. With Y/X ghosts this is the padded array base instead, to be
+    // combined with the memory selection from getMemoryStart()/Count(). The
+    // pointers stay valid until the next step() swaps the buffers.
+    const double* getUData() const { return isInteriorContiguous() ? &U_[index(1, 0, 0)] : U_.data(); }
+    const double* getVData() const { return isInteriorContiguous() ? &V_[index(1, 0, 0)] : V_.data(); }
+
+    bool isInteriorContiguous() const { return !ghostY_ && !ghostX_; }
+    std::vector<size_t> getMemoryStart() const { return {1, ghostY_, ghostX_}; }
+    std::vector<size_t> getMemoryCount() const {
+        return {localNz_ + 2, localNy_ + 2 * ghostY_, localNx_ + 2 * ghostX_};
+    }
+
+    // Copy the interior into a caller-owned buffer of getLocalSize() elements
+    void copyU(double* dst) const {
+        copyInterior(U_, dst);
+    }
+
+    void copyV(double* dst) const {
+        copyInterior(V_, dst);
+    }
+
+    size_t getLocalSize() const { return localNz_ * localNy_ * localNx_; }
+    size_t getLocalNz() const { return localNz_; }
+    size_t getLocalNy() const { return localNy_; }
+    size_t getLocalNx() const { return localNx_; }
+    size_t getZStart() const { return zStart_; }
+    size_t getYStart() const { return yStart_; }
+    size_t getXStart() const { return xStart_; }
+    const int* getProcGrid() const { return procGrid_; }
+    bool isMultiDimensional() const { return ghostY_ || ghostX_; }
+    size_t getGlobalNz() const { return globalNz_; }
+    size_t getGlobalNy() const { return globalNy_; }
+    size_t getGlobalNx() const { return globalNx_; }
+
+private:
+    // Gray-Scott update of one cell from its value and neighbour sums (sums
+    // are formed Z, then Y, then X to match the reference accumulation order)
+    inline void updateCell(double u, double v,
+                           double sumZU, double sumYU, double sumXU,
+                           double sumZV, double sumYV, double sumXV,
+                           double* __restrict__ uOut, double* __restrict__ vOut) const {
+        double laplacianU = (((sumZU + sumYU) + sumXU) - 6.0 * u) / (params_.dx * params_.dx);
+        double laplacianV = (((sumZV + sumYV) + sumXV) - 6.0 * v) / (params_.dx * params_.dx);
+        double uvv = u * v * v;
+        double dudt = params_.Du * laplacianU - uvv + params_.F * (1.0 - u);
+        double dvdt = params_.Dv * laplacianV + uvv - (params_.F + params_.k) * v;
+        *uOut = std::max(0.0, std::min(1.0, u + params_.dt * dudt));
+        *vOut = std::max(0.0, std::min(1.0, v + params_.dt * dvdt));
+    }
+
+    // One X row of the optimized kernel. The periodic X neighbours of the
+    // first and last cell are handled outside the vectorizable inner loop,
+    // either by wrapping within the row or from the ghost cells at [-1]/[nx].
+    void updateRow(const double* __restrict__ u, const double* __restrict__ uZM,
+                   const double* __restrict__ uZP, const double* __restrict__ uYM,
+                   const double* __restrict__ uYP,
+                   const double* __restrict__ v, const double* __restrict__ vZM,
+                   const double* __restrict__ vZP, const double* __restrict__ vYM,
+                   const double* __restrict__ vYP,
+                   double* __restrict__ uOut, double* __restrict__ vOut,
+                   size_t nx, bool ghostX) const {
+        const double dx2 = params_.dx * params_.dx;
+        const double dt = params_.dt;
+        const double Du = params_.Du;
+        const double Dv = params_.Dv;
+        const double F = params_.F;
+        const double Fk = params_.F + params_.k;
+
+        // Peeled first cell (X neighbour on the left wraps to nx-1)
+        ptrdiff_t xM0 = ghostX ? -1 : static_cast<ptrdiff_t>(nx - 1);
+        ptrdiff_t xP0 = (nx > 1 || ghostX) ? 1 : 0;
+        updateCell(u[0], v[0],
+                   uZM[0] + uZP[0], uYM[0] + uYP[0], u[xM0] + u[xP0],
+                   vZM[0] + vZP[0], vYM[0] + vYP[0], v[xM0] + v[xP0],
+                   &uOut[0], &vOut[0]);
+        if (nx == 1) return;
+
+        for (size_t lx = 1; lx < nx - 1; ++lx) {
+            double uc = u[lx];
+            double vc = v[lx];
+            double laplacianU = (((uZM[lx] + uZP[lx]) + (uYM[lx] + uYP[lx])) + (u[lx - 1] + u[lx + 1]) - 6.0 * uc) / dx2;
+            double laplacianV = (((vZM[lx] + vZP[lx]) + (vYM[lx] + vYP[lx])) + (v[lx - 1] + v[lx + 1]) - 6.0 * vc) / dx2;
+            double uvv = uc * vc * vc;
+            double dudt = Du * laplacianU - uvv + F * (1.0 - uc);
+            double dvdt = Dv * laplacianV + uvv - Fk * vc;
+            uOut[lx] = std::max(0.0, std::min(1.0, uc + dt * dudt));
+            vOut[lx] = std::max(0.0, std::min(1.0, vc + dt * dvdt));
+        }
+
+        // Peeled last cell (X neighbour on the right wraps to 0)
+        size_t last = nx - 1;
+        size_t xPLast = ghostX ? nx : 0;
+        updateCell(u[last], v[last],
+                   uZM[last] + uZP[last], uYM[last] + uYP[last], u[last - 1] + u[xPLast],
+                   vZM[last] + vZP[last], vYM[last] + vYP[last], v[last - 1] + v[xPLast],
+                   &uOut[last], &vOut[last]);
+    }
+
+    inline size_t index(size_t lz, size_t ly, size_t lx) const {
+        // lz includes ghost layer offset (0 = bottom ghost, 1..localNz_ = real, localNz_+1 = top ghost);
+        // ly/lx are interior coordinates, shifted past the Y/X ghosts when present
+        return lz * strideZ_ + (ly + ghostY_) * strideY_ + (lx + ghostX_);
+    }
+
+    void copyInterior(const FieldVector& f, double* dst) const {
+        if (isInteriorContiguous()) {
+            parallelCopy(dst, &f[index(1, 0, 0)], getLocalSize());
+            return;
+        }
+        #pragma omp parallel for
+        for (size_t lz = 0; lz < localNz_; ++lz) {
+            for (size_t ly = 0; ly < localNy_; ++ly) {
+                std::memcpy(dst + (lz * localNy_ + ly) * localNx_, &f[index(lz + 1, ly, 0)],
+                            localNx_ * sizeof(double));
+            }
+        }
+    }
+
+    int rank_, size_;
+    size_t globalNz_, globalNy_, globalNx_;
+    size_t localNz_, localNy_, localNx_;
+    size_t zStart_, yStart_, xStart_;
+    size_t ghostY_, ghostX_;        // 1 when Y/X is decomposed and carries ghosts
+    size_t strideY_, strideZ_;      // Padded row and plane lengths
+    int procGrid_[3];
+    int rankBelow_, rankAbove_;     // Z neighbours
+    int rankSouth_, rankNorth_;     // Y neighbours
+    int rankWest_, rankEast_;       // X neighbours
+    MPI_Datatype faceTypeZ_, faceTypeY_, faceTypeX_;
+    MPI_Comm comm_;
+    GSParams params_;
+    GSSolverOptions options_;
+
+    AlignedVector<double> haloPlanes_;   // Pack/unpack planes of exchangeHalos()
+
+    // Persistent halo state (HaloMode::Overlap only)
+    AlignedVector<double> haloSendDown_, haloSendUp_;
+    AlignedVector<double> haloRecvDown_, haloRecvUp_;
+    MPI_Request haloRequests_[4];
+
+    FieldVector U_, V_;
+    FieldVector U_new_, V_new_;
+};
+
+#endif // GRAY_SCOTT_H
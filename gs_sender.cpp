@@ -15,282 +15,566 @@
 #include <fstream>
 #include <thread>
 #include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <memory>
 
-// Gray-Scott parameters
-struct GSParams {
-    double Du = 0.2;      // Diffusion rate for U
-    double Dv = 0.1;      // Diffusion rate for V
-    double F  = 0.04;     // Feed rate
-    double k  = 0.06;     // Kill rate
-    double dt = 1.0;      // Time step
-    double dx = 1.0;      // Grid spacing
-};
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "aggregation.h"
+#include "buffers.h"
+#include "clock.h"
+#include "compression.h"
+#include "config.h"
+#include "delta.h"
+#include "fanout.h"
+#include "gray_scott.h"
+#include "metrics.h"
+#include "precision.h"
+#include "spill.h"
+#include "striping.h"
+#include "trace.h"
+#include "transport.h"
 
-class GrayScottSimulation {
+// Per-output accounting shared by the synchronous and asynchronous paths.
+// The totals are reduced in batches (metrics.h); rank 0 prints the output
+// line once they arrive, with the slowest rank's time.
+static void reportOutput(int outputIndex, int simStep, double stepTime,
+                         size_t localBytes, CompressionPipeline& compression,
+                         CompressionController& controller, StepMetrics& metrics, const char* tag)
+{
+    CompressionPipeline::StepStats localStats = compression.takeStepStats();
+    // The adaptive controller needs every step's totals at once
+    if (controller.enabled()) {
+        localStats.stepTime = stepTime;
+        controller.update(outputIndex, CompressionPipeline::reduce(localStats, MPI_COMM_WORLD));
+    }
+    
+    std::string suffix = tag;
+    metrics.record({localBytes / (1024.0 * 1024.0), stepTime, localStats.rawBytes, localStats.compressedBytes,
+                    localStats.compressTime},
+                   [&compression, outputIndex, simStep, suffix](const StepMetrics::Reduced& global) {
+        double globalDataMB = global.sum[0], time = global.max[1];
+        std::cout << "Output " << std::setw(4) << outputIndex 
+                  << " (sim step " << std::setw(6) << simStep << ")"
+                  << " | Time: " << std::fixed << std::setprecision(3) << time << " s"
+                  << " | Size: " << std::setprecision(2) << globalDataMB << " MB"
+                  << " | Throughput: " << std::setprecision(2) << globalDataMB / time << " MB/s";
+        if (compression.enabled()) {
+            CompressionPipeline::StepStats globalStats;
+            globalStats.rawBytes = global.sum[2];
+            globalStats.compressedBytes = global.sum[3];
+            globalStats.compressTime = global.max[4];
+            compression.accumulate(globalStats);
+            std::cout << CompressionPipeline::formatStep(globalStats, time);
+        }
+        std::cout << " | Imbalance: " << global.imbalance(1) << suffix << std::endl;
+    });
+}
+
+// Asynchronous output: the simulation snapshots U/V into one of a rotating set
+// of staging buffers and keeps computing, while a dedicated I/O thread runs
+// BeginStep/Put/EndStep on filled buffers in submission order. The simulation
+// only waits when every buffer is still queued or in flight; in monitoring
+// mode it drops the output instead, and with a burst buffer spills it to
+// disk (offer()).
+class AsyncOutputWriter {
 public:
-    GrayScottSimulation(int rank, int size, 
-                        size_t globalNz, size_t globalNy, size_t globalNx,
-                        const GSParams& params)
-        : rank_(rank), size_(size), 
-          globalNz_(globalNz), globalNy_(globalNy), globalNx_(globalNx),
-          params_(params)
+    AsyncOutputWriter(StripedWriter& writer,
+                      WanAggregator& aggregator,
+                      StripedField& fieldU,
+                      StripedField& fieldV,
+                      DeltaField* deltaU, DeltaField* deltaV,
+                      BurstBuffer* spill,
+                      adios2::Variable<int32_t> varStep,
+                      adios2::Variable<double> varTimestamp,
+                      CompressionPipeline& compression, CompressionController& controller,
+                      StepMetrics& metrics, int rank, size_t localSize, int numBuffers)
+        : writer_(writer), aggregator_(aggregator), fieldU_(fieldU), fieldV_(fieldV),
+          deltaU_(deltaU), deltaV_(deltaV), spill_(spill), varStep_(varStep),
+          varTimestamp_(varTimestamp),
+          compression_(compression), controller_(controller), metrics_(metrics), rank_(rank),
+          localSize_(localSize), slots_(numBuffers)
     {
-        // 1D decomposition along Z axis
-        size_t baseSlices = globalNz_ / size_;
-        size_t remainder = globalNz_ % size_;
-        
-        localNz_ = baseSlices + (static_cast<size_t>(rank_) < remainder ? 1 : 0);
-        zStart_ = rank_ * baseSlices + std::min(static_cast<size_t>(rank_), remainder);
-        
-        localNy_ = globalNy_;
-        localNx_ = globalNx_;
-        
-        // Allocate with ghost layers (1 cell on each side of Z)
-        size_t totalSize = (localNz_ + 2) * localNy_ * localNx_;
-        U_.resize(totalSize, 1.0);  // U starts at 1
-        V_.resize(totalSize, 0.0);  // V starts at 0
-        U_new_.resize(totalSize);
-        V_new_.resize(totalSize);
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].U.resize(localSize_);
+            slots_[i].V.resize(localSize_);
+            free_.push_back(i);
+        }
+        if (spill_) {
+            spillU_.resize(localSize_);
+            spillV_.resize(localSize_);
+            drainSlot_.U.resize(localSize_);
+            drainSlot_.V.resize(localSize_);
+        }
+        MPI_Comm_dup(MPI_COMM_WORLD, &offerComm_);
+        thread_ = std::thread(&AsyncOutputWriter::run, this);
+    }
+    
+    ~AsyncOutputWriter() {
+        finish();
+        MPI_Comm_free(&offerComm_);
+    }
+    
+    // Copy the current fields into a free staging buffer and queue it for
+    // output. Returns the time the caller was blocked (wait + copy).
+    double submit(const GrayScottSimulation& sim, int simStep, int outputIndex) {
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t slotIdx;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            freeCv_.wait(lock, [this]() { return !free_.empty(); });
+            slotIdx = free_.front();
+            free_.pop_front();
+        }
         
-        // Seed initial perturbation in center of global domain
-        seedInitialCondition();
+        Slot& slot = slots_[slotIdx];
+        {
+            TraceScope trace("copy");
+            sim.copyU(slot.U.data());
+            sim.copyV(slot.V.data());
+        }
+        slot.simStep = simStep;
+        slot.outputIndex = outputIndex;
+        slot.timestamp = wallClock();
         
-        // Determine neighbors for halo exchange
-        rankBelow_ = (rank_ > 0) ? rank_ - 1 : MPI_PROC_NULL;
-        rankAbove_ = (rank_ < size_ - 1) ? rank_ + 1 : MPI_PROC_NULL;
+        queue(Queued{slotIdx, -1});
         
-        // For periodic BCs (optional - currently using fixed boundaries)
-        // rankBelow_ = (rank_ > 0) ? rank_ - 1 : size_ - 1;
-        // rankAbove_ = (rank_ < size_ - 1) ? rank_ + 1 : 0;
+        double blocked = std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        exposedTime_ += blocked;
+        return blocked;
     }
     
-    void seedInitialCondition() {
-        // Seed a cube of V=0.25, U=0.5 in the center of the domain
-        size_t centerZ = globalNz_ / 2;
-        size_t centerY = globalNy_ / 2;
-        size_t centerX = globalNx_ / 2;
-        size_t seedRadius = std::min({globalNz_, globalNy_, globalNx_}) / 10;
-        
-        for (size_t lz = 0; lz < localNz_; ++lz) {
-            size_t gz = zStart_ + lz;
-            for (size_t ly = 0; ly < localNy_; ++ly) {
-                for (size_t lx = 0; lx < localNx_; ++lx) {
-                    // Check if within seed region
-                    if (std::abs(static_cast<int>(gz) - static_cast<int>(centerZ)) <= static_cast<int>(seedRadius) &&
-                        std::abs(static_cast<int>(ly) - static_cast<int>(centerY)) <= static_cast<int>(seedRadius) &&
-                        std::abs(static_cast<int>(lx) - static_cast<int>(centerX)) <= static_cast<int>(seedRadius)) {
-                        size_t idx = index(lz + 1, ly, lx); // +1 for ghost layer
-                        U_[idx] = 0.5;
-                        V_[idx] = 0.25;
-                    }
-                }
-            }
+    // Monitoring and burst-buffer mode: submit() if every rank has a free
+    // buffer, otherwise drop or spill the output on all ranks so the
+    // simulation never waits. Collective; returns false if the output did not
+    // go into memory.
+    bool offer(const GrayScottSimulation& sim, int simStep, int outputIndex) {
+        int available;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            available = free_.empty() ? 0 : 1;
+        }
+        // Only this thread takes buffers, so a free one stays free until submit()
+        MPI_Allreduce(MPI_IN_PLACE, &available, 1, MPI_INT, MPI_MIN, offerComm_);
+        if (!available && spill_) {
+            auto start = std::chrono::high_resolution_clock::now();
+            TraceScope trace("spill");
+            sim.copyU(spillU_.data());
+            sim.copyV(spillV_.data());
+            int closed = spill_->write(spillU_.data(), spillV_.data(), simStep, outputIndex, wallClock());
+            if (closed >= 0) queue(Queued{0, closed});
+            exposedTime_ += std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - start).count();
+            return false;
         }
+        if (!available) {
+            dropped_++;
+            return false;
+        }
+        // Back in memory: the spilled outputs go out first
+        if (spill_) {
+            int closed = spill_->close();
+            if (closed >= 0) queue(Queued{0, closed});
+        }
+        submit(sim, simStep, outputIndex);
+        return true;
     }
     
-    void exchangeHalos() {
-        size_t sliceSize = localNy_ * localNx_;
-        std::vector<double> sendBufDown(sliceSize), recvBufDown(sliceSize);
-        std::vector<double> sendBufUp(sliceSize), recvBufUp(sliceSize);
-        std::vector<double> sendBufDownV(sliceSize), recvBufDownV(sliceSize);
-        std::vector<double> sendBufUpV(sliceSize), recvBufUpV(sliceSize);
-        
-        // Pack bottom slice (z=1, first real layer) to send down
-        // Pack top slice (z=localNz_, last real layer) to send up
-        for (size_t ly = 0; ly < localNy_; ++ly) {
-            for (size_t lx = 0; lx < localNx_; ++lx) {
-                size_t sIdx = ly * localNx_ + lx;
-                sendBufDown[sIdx] = U_[index(1, ly, lx)];
-                sendBufUp[sIdx] = U_[index(localNz_, ly, lx)];
-                sendBufDownV[sIdx] = V_[index(1, ly, lx)];
-                sendBufUpV[sIdx] = V_[index(localNz_, ly, lx)];
-            }
+    // Drain all queued outputs and stop the I/O thread
+    void finish() {
+        if (!thread_.joinable()) return;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (spill_) {
+            int closed = spill_->close();
+            if (closed >= 0) queue(Queued{0, closed});
         }
-        
-        // Exchange U halos
-        MPI_Sendrecv(sendBufDown.data(), sliceSize, MPI_DOUBLE, rankBelow_, 0,
-                     recvBufUp.data(), sliceSize, MPI_DOUBLE, rankAbove_, 0,
-                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        MPI_Sendrecv(sendBufUp.data(), sliceSize, MPI_DOUBLE, rankAbove_, 1,
-                     recvBufDown.data(), sliceSize, MPI_DOUBLE, rankBelow_, 1,
-                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        
-        // Exchange V halos
-        MPI_Sendrecv(sendBufDownV.data(), sliceSize, MPI_DOUBLE, rankBelow_, 2,
-                     recvBufUpV.data(), sliceSize, MPI_DOUBLE, rankAbove_, 2,
-                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        MPI_Sendrecv(sendBufUpV.data(), sliceSize, MPI_DOUBLE, rankAbove_, 3,
-                     recvBufDownV.data(), sliceSize, MPI_DOUBLE, rankBelow_, 3,
-                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        
-        // Unpack into ghost layers
-        for (size_t ly = 0; ly < localNy_; ++ly) {
-            for (size_t lx = 0; lx < localNx_; ++lx) {
-                size_t sIdx = ly * localNx_ + lx;
-                if (rankAbove_ != MPI_PROC_NULL) {
-                    U_[index(localNz_ + 1, ly, lx)] = recvBufUp[sIdx];
-                    V_[index(localNz_ + 1, ly, lx)] = recvBufUpV[sIdx];
-                }
-                if (rankBelow_ != MPI_PROC_NULL) {
-                    U_[index(0, ly, lx)] = recvBufDown[sIdx];
-                    V_[index(0, ly, lx)] = recvBufDownV[sIdx];
-                }
-            }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
         }
-        
-        // Fixed boundary conditions at domain edges
-        if (rankBelow_ == MPI_PROC_NULL) {
-            for (size_t ly = 0; ly < localNy_; ++ly) {
-                for (size_t lx = 0; lx < localNx_; ++lx) {
-                    U_[index(0, ly, lx)] = U_[index(1, ly, lx)];
-                    V_[index(0, ly, lx)] = V_[index(1, ly, lx)];
-                }
-            }
+        filledCv_.notify_one();
+        thread_.join();
+        exposedTime_ += std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+    
+    double getOutputTime() const { return outputTime_; }
+    double getExposedTime() const { return exposedTime_; }
+    int getDropped() const { return dropped_; }
+    
+private:
+    struct Slot {
+        AlignedVector<double> U, V;
+        int simStep = 0;
+        int outputIndex = 0;
+        double timestamp = 0.0;   // When the step was snapshotted
+    };
+    
+    // A staging buffer, or a closed spill segment (segment >= 0)
+    struct Queued {
+        size_t slot;
+        int segment;
+    };
+    
+    void queue(const Queued& entry) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            filled_.push_back(entry);
         }
-        if (rankAbove_ == MPI_PROC_NULL) {
-            for (size_t ly = 0; ly < localNy_; ++ly) {
-                for (size_t lx = 0; lx < localNx_; ++lx) {
-                    U_[index(localNz_ + 1, ly, lx)] = U_[index(localNz_, ly, lx)];
-                    V_[index(localNz_ + 1, ly, lx)] = V_[index(localNz_, ly, lx)];
-                }
+        filledCv_.notify_one();
+    }
+    
+    void run() {
+        traceThread("io");
+        while (true) {
+            Queued entry;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                filledCv_.wait(lock, [this]() { return !filled_.empty() || done_; });
+                if (filled_.empty()) break;  // done_ and fully drained
+                entry = filled_.front();
+                filled_.pop_front();
+            }
+            
+            if (entry.segment >= 0) {
+                spill_->drain(entry.segment, drainSlot_.U.data(), drainSlot_.V.data(),
+                              [this](int simStep, int outputIndex, double timestamp) {
+                    drainSlot_.simStep = simStep;
+                    drainSlot_.outputIndex = outputIndex;
+                    drainSlot_.timestamp = timestamp;
+                    write(drainSlot_, " [spilled]");
+                });
+                continue;
             }
+            
+            write(slots_[entry.slot], " [async]");
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                free_.push_back(entry.slot);
+            }
+            freeCv_.notify_one();
         }
     }
     
-    void step() {
-        exchangeHalos();
-        
-        double dx2 = params_.dx * params_.dx;
-        double dt = params_.dt;
-        double Du = params_.Du;
-        double Dv = params_.Dv;
-        double F = params_.F;
-        double k = params_.k;
+    // One output over SST (I/O thread)
+    void write(Slot& slot, const char* tag) {
+        auto stepStart = std::chrono::high_resolution_clock::now();
         
-        // Update interior points
-        for (size_t lz = 1; lz <= localNz_; ++lz) {
-            for (size_t ly = 0; ly < localNy_; ++ly) {
-                for (size_t lx = 0; lx < localNx_; ++lx) {
-                    size_t idx = index(lz, ly, lx);
-                    
-                    double u = U_[idx];
-                    double v = V_[idx];
-                    
-                    // 7-point stencil Laplacian
-                    double laplacianU = 0.0;
-                    double laplacianV = 0.0;
-                    
-                    // Z direction
-                    laplacianU += U_[index(lz - 1, ly, lx)] + U_[index(lz + 1, ly, lx)];
-                    laplacianV += V_[index(lz - 1, ly, lx)] + V_[index(lz + 1, ly, lx)];
-                    
-                    // Y direction (periodic)
-                    size_t lyM = (ly > 0) ? ly - 1 : localNy_ - 1;
-                    size_t lyP = (ly < localNy_ - 1) ? ly + 1 : 0;
-                    laplacianU += U_[index(lz, lyM, lx)] + U_[index(lz, lyP, lx)];
-                    laplacianV += V_[index(lz, lyM, lx)] + V_[index(lz, lyP, lx)];
-                    
-                    // X direction (periodic)
-                    size_t lxM = (lx > 0) ? lx - 1 : localNx_ - 1;
-                    size_t lxP = (lx < localNx_ - 1) ? lx + 1 : 0;
-                    laplacianU += U_[index(lz, ly, lxM)] + U_[index(lz, ly, lxP)];
-                    laplacianV += V_[index(lz, ly, lxM)] + V_[index(lz, ly, lxP)];
-                    
-                    laplacianU = (laplacianU - 6.0 * u) / dx2;
-                    laplacianV = (laplacianV - 6.0 * v) / dx2;
-                    
-                    // Gray-Scott reaction terms
-                    double uvv = u * v * v;
-                    double dudt = Du * laplacianU - uvv + F * (1.0 - u);
-                    double dvdt = Dv * laplacianV + uvv - (F + k) * v;
-                    
-                    U_new_[idx] = u + dt * dudt;
-                    V_new_[idx] = v + dt * dvdt;
-                    
-                    // Clamp values to [0, 1]
-                    U_new_[idx] = std::max(0.0, std::min(1.0, U_new_[idx]));
-                    V_new_[idx] = std::max(0.0, std::min(1.0, V_new_[idx]));
-                }
-            }
+        if (!deltaU_) {
+            TraceScope trace("encode");
+            fieldU_.encode(slot.U.data(), MPI_COMM_WORLD);
+            fieldV_.encode(slot.V.data(), MPI_COMM_WORLD);
+        }
+        double probeTime = 0.0;
+        if (!deltaU_ && compression_.shouldProbe(slot.outputIndex)) {
+            auto probeStart = std::chrono::high_resolution_clock::now();
+            fieldU_.probe(compression_, slot.U.data());
+            fieldV_.probe(compression_, slot.V.data());
+            probeTime = std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - probeStart).count();
         }
         
-        // Swap buffers
-        std::swap(U_, U_new_);
-        std::swap(V_, V_new_);
-    }
-    
-    // Get data without ghost layers for output
-    std::vector<double> getU() const {
-        std::vector<double> result(localNz_ * localNy_ * localNx_);
-        for (size_t lz = 0; lz < localNz_; ++lz) {
-            for (size_t ly = 0; ly < localNy_; ++ly) {
-                for (size_t lx = 0; lx < localNx_; ++lx) {
-                    result[lz * localNy_ * localNx_ + ly * localNx_ + lx] = 
-                        U_[index(lz + 1, ly, lx)];
-                }
+        if (aggregator_.isWriter()) writer_.beginStep();
+        size_t bytes;
+        {
+            TraceScope trace("put");
+            if (deltaU_) {
+                deltaU_->put(writer_.primary(), slot.U.data(), slot.outputIndex);
+                deltaV_->put(writer_.primary(), slot.V.data(), slot.outputIndex);
+                bytes = deltaU_->lastBytes() + deltaV_->lastBytes();
+            } else {
+                fieldU_.put(writer_, slot.U.data(), aggregator_);
+                fieldV_.put(writer_, slot.V.data(), aggregator_);
+                fieldU_.record(compression_);
+                fieldV_.record(compression_);
+                bytes = fieldU_.wireBytes() + fieldV_.wireBytes();
             }
-        }
-        return result;
-    }
-    
-    std::vector<double> getV() const {
-        std::vector<double> result(localNz_ * localNy_ * localNx_);
-        for (size_t lz = 0; lz < localNz_; ++lz) {
-            for (size_t ly = 0; ly < localNy_; ++ly) {
-                for (size_t lx = 0; lx < localNx_; ++lx) {
-                    result[lz * localNy_ * localNx_ + ly * localNx_ + lx] = 
-                        V_[index(lz + 1, ly, lx)];
-                }
+            if (rank_ == 0) {
+                int32_t stepVal = slot.simStep;
+                writer_.primary().Put(varStep_, stepVal);
+                writer_.primary().Put(varTimestamp_, slot.timestamp);
             }
         }
-        return result;
+        if (aggregator_.isWriter()) writer_.endStep();
+        
+        auto stepEnd = std::chrono::high_resolution_clock::now();
+        double stepTime = std::chrono::duration<double>(stepEnd - stepStart).count() - probeTime;
+        outputTime_ += stepTime;
+        
+        reportOutput(slot.outputIndex, slot.simStep, stepTime, bytes, compression_, controller_, metrics_, tag);
     }
     
-    size_t getLocalNz() const { return localNz_; }
-    size_t getLocalNy() const { return localNy_; }
-    size_t getLocalNx() const { return localNx_; }
-    size_t getZStart() const { return zStart_; }
-    size_t getGlobalNz() const { return globalNz_; }
-    size_t getGlobalNy() const { return globalNy_; }
-    size_t getGlobalNx() const { return globalNx_; }
+    StripedWriter& writer_;
+    WanAggregator& aggregator_;          // Group collectives run on the I/O thread only
+    StripedField& fieldU_;               // Encode buffers used by the I/O thread only
+    StripedField& fieldV_;
+    DeltaField* deltaU_;                 // Delta encoding instead of the fields (or nullptr)
+    DeltaField* deltaV_;
+    BurstBuffer* spill_;                 // Where offer() spills busy outputs (or nullptr)
+    adios2::Variable<int32_t> varStep_;
+    adios2::Variable<double> varTimestamp_;
+    CompressionPipeline& compression_;   // Used by the I/O thread only
+    CompressionController& controller_;
+    StepMetrics& metrics_;               // Recorded by the I/O thread only
+    int rank_;
+    size_t localSize_;
     
-private:
-    inline size_t index(size_t lz, size_t ly, size_t lx) const {
-        // lz includes ghost layer offset (0 = bottom ghost, 1..localNz_ = real, localNz_+1 = top ghost)
-        return lz * localNy_ * localNx_ + ly * localNx_ + lx;
-    }
+    std::vector<Slot> slots_;
+    std::deque<size_t> free_;
+    std::deque<Queued> filled_;
+    AlignedVector<double> spillU_, spillV_;   // Dense copy for the spill (simulation thread)
+    Slot drainSlot_;                        // Spilled outputs read back (I/O thread)
+    std::mutex mutex_;
+    std::condition_variable freeCv_, filledCv_;
+    bool done_ = false;
+    std::thread thread_;
+    MPI_Comm offerComm_;        // offer()'s vote, apart from the I/O thread's collectives
     
-    int rank_, size_;
-    size_t globalNz_, globalNy_, globalNx_;
-    size_t localNz_, localNy_, localNx_;
-    size_t zStart_;
-    int rankBelow_, rankAbove_;
-    GSParams params_;
-    
-    std::vector<double> U_, V_;
-    std::vector<double> U_new_, V_new_;
+    double outputTime_ = 0.0;   // Written by the I/O thread only
+    double exposedTime_ = 0.0;  // Written by the simulation thread only
+    int dropped_ = 0;           // Outputs offer() dropped
 };
 
+// Match a "--name=value" command line option and extract its value
+static bool parseOption(const std::string& arg, const std::string& name, std::string& value)
+{
+    if (arg.compare(0, name.size(), name) != 0) return false;
+    value = arg.substr(name.size());
+    return true;
+}
+
 
 int main(int argc, char* argv[])
 {
-    MPI_Init(&argc, &argv);
-    
-    int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
-    
     // Default parameters
     size_t gridSize = 128;       // Global grid size (cubic)
     int totalSteps = 10000;      // Total simulation steps
     int outputInterval = 100;    // Output every N steps
     std::string contactFile = "gs-simulation";
+    bool asyncOutput = false;    // Overlap SST output with computation
+    int outputBuffers = 2;       // Staging buffers for async output
+    bool monitorMode = false;    // Live monitoring: drop outputs rather than wait
+    DeltaOptions deltaOptions;   // Send only changed tiles of U/V
+    std::string spillDir;        // Burst buffer for outputs SST cannot take yet
+    int spillSegment = 16;       // Outputs per spill file
+    GSSolverOptions solverOptions;
+    std::vector<std::string> compressSpecs;
+    int compressProbeInterval = 10;
+    std::string adaptSpec, adaptTarget;
+    std::string adaptLog = "adaptive_compression.csv";
+    WirePrecision precision = WirePrecision::Double;
+    int aggregatorCount = 0;     // WAN-facing ranks (0 = every rank)
+    int stripes = 1;             // Parallel SST streams per output step
+    std::string transportRequest;   // Empty: the config's DataTransport, or sockets
+    int transportTimeout = 30;   // Seconds before falling back to the next transport
+    std::string configFile;      // ADIOS2 XML runtime config
+    std::string readersOption;      // --readers (empty: the config's, or 1)
+    std::string distributeOption;   // --distribute (empty: the config's, or all)
+    int metricsInterval = 10;    // Steps per batch of reduced output metrics
+    int clockPort = 0;           // Time server for receiver latency (0 = any port)
+    std::string clockHost;       // Name advertised for it (empty = hostname)
+    std::string traceFile;       // Chrome trace of every rank's phases
+    size_t traceEvents = 65536;  // Events kept per thread
     
-    // Parse command line
-    if (argc > 1) gridSize = std::stoul(argv[1]);
-    if (argc > 2) totalSteps = std::stoi(argv[2]);
-    if (argc > 3) outputInterval = std::stoi(argv[3]);
-    if (argc > 4) contactFile = argv[4];
+    // Parse command line: positional arguments, then optional --flags
+    // (parsed before MPI init since async output needs MPI_THREAD_MULTIPLE)
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        if (arg == "--async-output") {
+            asyncOutput = true;
+        } else if (arg == "--delta") {
+            deltaOptions.enabled = true;
+        } else if (parseOption(arg, "--delta=", value)) {
+            deltaOptions.enabled = true;
+            deltaOptions.tolerance = std::stod(value);
+        } else if (parseOption(arg, "--delta-tile=", value)) {
+            deltaOptions.tileElements = std::max<size_t>(1, std::stoull(value));
+        } else if (parseOption(arg, "--delta-keyframe=", value)) {
+            deltaOptions.keyframeInterval = std::max(0, std::stoi(value));
+        } else if (arg == "--monitor") {
+            monitorMode = true;
+            asyncOutput = true;
+        } else if (parseOption(arg, "--spill=", value)) {
+            spillDir = value;
+            asyncOutput = true;
+        } else if (parseOption(arg, "--spill-segment=", value)) {
+            spillSegment = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--output-buffers=", value)) {
+            outputBuffers = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--halo=", value)) {
+            if (value == "overlap") {
+                solverOptions.haloMode = HaloMode::Overlap;
+            } else if (value == "blocking") {
+                solverOptions.haloMode = HaloMode::Blocking;
+            } else {
+                std::cerr << "Unknown halo mode: " << value << " (use blocking or overlap)" << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--kernel=", value)) {
+            if (value == "optimized") {
+                solverOptions.kernelMode = KernelMode::Optimized;
+            } else if (value == "reference") {
+                solverOptions.kernelMode = KernelMode::Reference;
+            } else {
+                std::cerr << "Unknown kernel: " << value << " (use optimized or reference)" << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--tile-y=", value)) {
+            solverOptions.tileRows = std::stoul(value);
+        } else if (parseOption(arg, "--threads=", value)) {
+            solverOptions.threads = std::max(0, std::stoi(value));
+        } else if (parseOption(arg, "--decomp=", value)) {
+            // Dimensions left at 0 are chosen by MPI_Dims_create
+            int grid1d[3] = {0, 1, 1}, grid2d[3] = {0, 0, 1}, grid3d[3] = {0, 0, 0};
+            const int* grid = (value == "1d") ? grid1d : (value == "2d") ? grid2d : (value == "3d") ? grid3d : nullptr;
+            if (!grid) {
+                std::cerr << "Unknown decomposition: " << value << " (use 1d, 2d or 3d)" << std::endl;
+                return 1;
+            }
+            std::copy(grid, grid + 3, solverOptions.procGrid);
+        } else if (parseOption(arg, "--precision=", value)) {
+            try {
+                precision = parseWirePrecision(value);
+            } catch (std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--compress=", value)) {
+            compressSpecs.push_back(value);
+        } else if (parseOption(arg, "--compress-probe=", value)) {
+            compressProbeInterval = std::stoi(value);
+        } else if (parseOption(arg, "--adapt=", value)) {
+            adaptSpec = value;
+        } else if (parseOption(arg, "--adapt-target=", value)) {
+            adaptTarget = value;
+        } else if (parseOption(arg, "--adapt-log=", value)) {
+            adaptLog = value;
+        } else if (parseOption(arg, "--aggregators=", value)) {
+            aggregatorCount = std::stoi(value);
+        } else if (parseOption(arg, "--stripes=", value)) {
+            stripes = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--transport=", value)) {
+            transportRequest = value;
+        } else if (parseOption(arg, "--transport-timeout=", value)) {
+            transportTimeout = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--readers=", value)) {
+            readersOption = value;
+        } else if (parseOption(arg, "--distribute=", value)) {
+            distributeOption = value;
+        } else if (parseOption(arg, "--config=", value)) {
+            configFile = value;
+        } else if (parseOption(arg, "--metrics-interval=", value)) {
+            metricsInterval = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--clock-port=", value)) {
+            clockPort = std::stoi(value);
+        } else if (parseOption(arg, "--clock-host=", value)) {
+            clockHost = value;
+        } else if (parseOption(arg, "--huge-pages=", value)) {
+            // Before anything allocates an AlignedVector
+            if (!parseHugePages(value, bufferConfig().hugePages)) {
+                std::cerr << "Invalid --huge-pages: " << value << " (expected off, thp or explicit)" << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--trace=", value)) {
+            traceFile = value;
+        } else if (parseOption(arg, "--trace-events=", value)) {
+            traceEvents = std::stoul(value);
+        } else if (parseOption(arg, "--procs=", value)) {
+            // Explicit process grid "PZxPYxPX"
+            if (std::sscanf(value.c_str(), "%dx%dx%d", &solverOptions.procGrid[0],
+                            &solverOptions.procGrid[1], &solverOptions.procGrid[2]) != 3) {
+                std::cerr << "Invalid process grid: " << value << " (expected PZxPYxPX)" << std::endl;
+                return 1;
+            }
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() > 0) gridSize = std::stoul(positional[0]);
+    if (positional.size() > 1) totalSteps = std::stoi(positional[1]);
+    if (positional.size() > 2) outputInterval = std::stoi(positional[2]);
+    if (positional.size() > 3) contactFile = positional[3];
+    
+    // Compute threads never call MPI (only the master thread does), so they
+    // need FUNNELED; the async I/O thread calls MPI concurrently
+    int required = asyncOutput ? MPI_THREAD_MULTIPLE
+                 : (solverOptions.threads != 1 ? MPI_THREAD_FUNNELED : MPI_THREAD_SINGLE);
+    int provided = MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, required, &provided);
+    
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    
+    if (asyncOutput && provided < MPI_THREAD_MULTIPLE) {
+        if (rank == 0) {
+            std::cerr << "Warning: MPI_THREAD_MULTIPLE not available, "
+                      << "falling back to synchronous output"
+                      << (monitorMode ? " (monitoring relies on SST's Discard alone)" : "")
+                      << (!spillDir.empty() ? " (no burst buffer, outputs wait for SST)" : "") << std::endl;
+        }
+        asyncOutput = false;
+        spillDir.clear();
+    }
+    
+    // MPI_Dims_create needs the fixed dimensions to divide the rank count
+    int fixedRanks = 1;
+    for (int d = 0; d < 3; ++d) {
+        if (solverOptions.procGrid[d] > 0) fixedRanks *= solverOptions.procGrid[d];
+    }
+    if (monitorMode && !spillDir.empty()) {
+        if (rank == 0) {
+            std::cerr << "Error: --monitor drops outputs, --spill keeps them; use one of the two" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    if (deltaOptions.enabled && (precision != WirePrecision::Double || stripes > 1 || aggregatorCount > 0)) {
+        if (rank == 0) {
+            std::cerr << "Error: --delta needs --precision=double, one stripe and no --aggregators" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    if (deltaOptions.enabled && (monitorMode || (!distributeOption.empty() && distributeOption != "all"))) {
+        if (rank == 0) {
+            std::cerr << "Error: --delta needs every output at every reader, "
+                      << "so no --monitor and only --distribute=all" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    if (size % fixedRanks != 0) {
+        if (rank == 0) {
+            std::cerr << "Error: process grid " << solverOptions.procGrid[0] << "x"
+                      << solverOptions.procGrid[1] << "x" << solverOptions.procGrid[2]
+                      << " does not fit " << size << " ranks" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    
+#ifdef _OPENMP
+    if (solverOptions.threads > 0) {
+        omp_set_num_threads(solverOptions.threads);
+    }
+    int computeThreads = omp_get_max_threads();
+#else
+    if (solverOptions.threads != 1 && rank == 0) {
+        std::cerr << "Warning: built without OpenMP, --threads ignored" << std::endl;
+    }
+    int computeThreads = 1;
+#endif
     
     // Gray-Scott parameters (coral pattern)
     GSParams params;
@@ -307,123 +591,271 @@ int main(int argc, char* argv[])
         std::cout << "Total steps: " << totalSteps << std::endl;
         std::cout << "Output interval: " << outputInterval << " steps" << std::endl;
         std::cout << "MPI ranks: " << size << std::endl;
+        std::cout << "Threads per rank: " << computeThreads << std::endl;
+        std::cout << "Output mode: " << (asyncOutput ? "async (" + std::to_string(outputBuffers) + " buffers)" : "sync") << std::endl;
+        std::cout << "Output metrics: reduced every " << metricsInterval << " outputs" << std::endl;
+        std::cout << bufferBanner() << std::endl;
+        if (!traceFile.empty()) {
+            std::cout << "Tracing: " << traceFile << " (" << traceEvents << " events per thread)" << std::endl;
+        }
+        std::cout << "Halo exchange: " << (solverOptions.haloMode == HaloMode::Overlap ? "overlap" : "blocking") << std::endl;
+        std::cout << "Wire precision: " << wirePrecisionName(precision) << std::endl;
+        std::cout << "Stencil kernel: " << (solverOptions.kernelMode == KernelMode::Optimized ? "optimized" : "reference") << std::endl;
         std::cout << "Parameters: F=" << params.F << ", k=" << params.k << std::endl;
         std::cout << std::string(60, '=') << std::endl;
     }
     
+    std::unique_ptr<Tracer> tracer = startTracing(traceFile, "gs_sender", 0, traceEvents);
+    
     // Initialize simulation
-    GrayScottSimulation sim(rank, size, gridSize, gridSize, gridSize, params);
+    GrayScottSimulation sim(rank, size, gridSize, gridSize, gridSize, params, solverOptions);
+    
+    if (rank == 0) {
+        const int* grid = sim.getProcGrid();
+        std::cout << "Decomposition (Z x Y x X): " << grid[0] << " x " << grid[1] << " x " << grid[2] << std::endl;
+        if (sim.isMultiDimensional() && solverOptions.haloMode == HaloMode::Overlap) {
+            std::cerr << "Warning: --halo=overlap only supports the 1D decomposition, "
+                      << "using blocking halo exchange" << std::endl;
+        }
+    }
+    
+    // Only aggregator ranks open the SST stream
+    WanAggregator aggregator(MPI_COMM_WORLD, aggregatorCount);
+    if (rank == 0) {
+        if (aggregator.enabled()) {
+            std::cout << "WAN writers: " << aggregator.aggregators() << " aggregators (up to "
+                      << aggregator.maxGroupSize() << " ranks each)" << std::endl;
+        } else {
+            std::cout << "WAN writers: all ranks" << std::endl;
+        }
+        std::cout << "SST stripes: " << stripes << std::endl;
+        if (monitorMode) {
+            std::cout << "Monitoring: outputs dropped when staging or the SST queue is full" << std::endl;
+        }
+        if (!spillDir.empty()) {
+            std::cout << "Burst buffer: " << spillDir << " (" << spillSegment << " outputs per file)" << std::endl;
+        }
+        if (deltaOptions.enabled) {
+            std::cout << "Delta encoding: " << deltaOptions.tileElements << "-element tiles, "
+                      << (deltaOptions.tolerance > 0.0 ? "tolerance " + std::to_string(deltaOptions.tolerance)
+                                                       : std::string("bit-exact"))
+                      << ", keyframe every "
+                      << (deltaOptions.keyframeInterval > 0 ? std::to_string(deltaOptions.keyframeInterval)
+                                                            : std::string("(first only)"))
+                      << " outputs" << std::endl;
+        }
+        if (!configFile.empty()) {
+            std::cout << "Config file: " << configFile << std::endl;
+        }
+    }
     
     // Initialize ADIOS2
-    adios2::ADIOS adios(MPI_COMM_WORLD);
-    adios2::IO io = adios.DeclareIO("GrayScottIO");
-    io.SetEngine("SST");
-    io.SetParameters({
+    adios2::ADIOS adios(configFile, aggregator.adiosComm());
+    StripedWriter stream(adios, "GrayScottIO", stripes, "SST", {
         {"RendezvousReaderCount", "1"},
         {"QueueLimit", "5"},
         {"QueueFullPolicy", "Block"},
-        {"ControlTransport", "sockets"},
-        {"DataTransport", "sockets"},
-        {"OpenTimeoutSecs", "300"},
         {"MarshalMethod", "BP5"}
     });
+    try {
+        stream.setParameters(fanOutParams(readersOption, distributeOption));
+        if (monitorMode) stream.setParameters({{"QueueFullPolicy", "Discard"}});
+        checkFanOut(stream.primaryIO().Parameters(), stripes);
+        if (deltaOptions.enabled) checkDeltaStream(stream.primaryIO().Parameters());
+    } catch (std::exception& e) {
+        std::cerr << "Error on rank " << rank << ": " << e.what() << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    TransportSelector transports(transportRequest, transportTimeout, aggregator.adiosComm(),
+                                 stream.primaryIO().Parameters());
     
-    // Define variables
-    adios2::Variable<double> varU = io.DefineVariable<double>(
-        "U",
+    // Define variables in their wire precision, one block per stripe
+    StripedField fieldU(stream, "U", precision,
         {sim.getGlobalNz(), sim.getGlobalNy(), sim.getGlobalNx()},
-        {sim.getZStart(), 0, 0},
-        {sim.getLocalNz(), sim.getLocalNy(), sim.getLocalNx()}
+        {sim.getZStart(), sim.getYStart(), sim.getXStart()},
+        {sim.getLocalNz(), sim.getLocalNy(), sim.getLocalNx()},
+        rank
     );
     
-    adios2::Variable<double> varV = io.DefineVariable<double>(
-        "V",
+    StripedField fieldV(stream, "V", precision,
         {sim.getGlobalNz(), sim.getGlobalNy(), sim.getGlobalNx()},
-        {sim.getZStart(), 0, 0},
-        {sim.getLocalNz(), sim.getLocalNy(), sim.getLocalNx()}
+        {sim.getZStart(), sim.getYStart(), sim.getXStart()},
+        {sim.getLocalNz(), sim.getLocalNy(), sim.getLocalNx()},
+        rank
     );
     
+    // With Y/X ghosts the interior is strided inside the padded arrays; the
+    // memory selection lets the synchronous double path still Put without a
+    // copy (async staging buffers are already dense, and reduced precisions
+    // pack the interior while encoding). Aggregation gathers dense blocks,
+    // so there the double interior is packed into denseU/denseV instead.
+    adios2::Box<adios2::Dims> memorySelection;
+    if (!sim.isInteriorContiguous()) {
+        memorySelection = {sim.getMemoryStart(), sim.getMemoryCount()};
+    }
+    bool packDouble = !asyncOutput && precision == WirePrecision::Double && !sim.isInteriorContiguous();
+    AlignedVector<double> denseU, denseV;
+    if (packDouble && (aggregator.enabled() || deltaOptions.enabled)) {
+        denseU.resize(sim.getLocalSize());
+        denseV.resize(sim.getLocalSize());
+    } else if (packDouble) {
+        fieldU.setMemorySelection(memorySelection);
+        fieldV.setMemorySelection(memorySelection);
+    }
+    
+    // Delta encoding replaces U/V by U/delta and V/delta on the wire
+    std::unique_ptr<DeltaField> deltaU, deltaV;
+    if (deltaOptions.enabled) {
+        adios2::Dims shape = {sim.getGlobalNz(), sim.getGlobalNy(), sim.getGlobalNx()};
+        adios2::Dims start = {sim.getZStart(), sim.getYStart(), sim.getXStart()};
+        adios2::Dims count = {sim.getLocalNz(), sim.getLocalNy(), sim.getLocalNx()};
+        deltaU.reset(new DeltaField(stream.primaryIO(), "U", shape, start, count, deltaOptions));
+        deltaV.reset(new DeltaField(stream.primaryIO(), "V", shape, start, count, deltaOptions));
+    }
+    
     adios2::Variable<int32_t> varStep;
+    adios2::Variable<double> varTimestamp;
     if (rank == 0) {
-        varStep = io.DefineVariable<int32_t>("step");
+        varStep = stream.primaryIO().DefineVariable<int32_t>("step");
+        varTimestamp = stream.primaryIO().DefineVariable<double>("timestamp");
     }
+    std::unique_ptr<ClockServer> clock = advertiseClock(stream.primaryIO(), clockPort, clockHost, rank);
     
-    // Start SST monitor thread to display connection string
-    std::thread sstMonitor;
+    // Attach per-variable compression operators
+    CompressionPipeline compression(adios, rank);
+    CompressionController controller(compression, rank);
+    try {
+        for (const auto& spec : compressSpecs) compression.addSpec(spec);
+        compression.setProbeInterval(compressProbeInterval);
+        fieldU.attach(compression);
+        fieldV.attach(compression);
+        controller.configure(adaptSpec, adaptTarget, adaptLog);
+    } catch (std::exception& e) {
+        std::cerr << "Error on rank " << rank << ": " << e.what() << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
     if (rank == 0) {
-        sstMonitor = std::thread([contactFile]() {
-            std::string sstFileName = contactFile + ".sst";
-            for (int i = 0; i < 30; i++) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                std::ifstream sstFile(sstFileName);
-                if (sstFile.is_open()) {
-                    std::string line;
-                    std::getline(sstFile, line);
-                    std::getline(sstFile, line);
-                    sstFile.close();
-                    
-                    if (!line.empty()) {
-                        std::cout << "\n*** SST CONNECTION STRING ***" << std::endl;
-                        std::cout << line << std::endl;
-                        std::cout << "\nRun this on receiver machine (choose your MPI ranks):" << std::endl;
-                        std::cout << "  mpirun -np 8 ./receiver \"" << line << "\"" << std::endl;
-                        std::cout << std::string(60, '=') << std::endl;
-                        std::cout << "\nWaiting for receiver to connect..." << std::endl;
-                        break;
-                    }
-                }
-            }
-        });
+        compression.printConfig(std::cout);
+        controller.printConfig(std::cout);
     }
     
-    // Open SST writer
-    adios2::Engine writer = io.Open(contactFile, adios2::Mode::Write);
+    // Rank 0 prints the connection string of each open attempt (striped
+    // streams are found through their contact files instead)
+    std::unique_ptr<ContactAnnouncer> announcer;
+    if (rank == 0 && stripes > 1) {
+        std::cout << "\nRun this on receiver machine (sharing this directory):" << std::endl;
+        std::cout << "  mpirun -np 8 ./receiver " << contactFile << " received_data.bp --streams=" << stripes << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+    } else if (rank == 0) {
+        announcer.reset(new ContactAnnouncer(contactFile, "mpirun -np 8 ./receiver"));
+    }
     
-    if (rank == 0 && sstMonitor.joinable()) {
-        sstMonitor.join();
+    // Open SST writers
+    if (aggregator.isWriter()) {
+        stream.open(contactFile, transports, aggregator.adiosComm(), announcer.get());
+    }
+    announcer.reset();
+    if (rank == 0) {
+        std::cout << "SST transport: " << transports.report() << std::endl;
+        std::cout << "Readers: " << describeFanOut(stream.primaryIO().Parameters()) << std::endl;
+        if (clock) std::cout << "Clock server: " << clock->endpoint(clockHost) << std::endl;
     }
     
     auto overallStart = std::chrono::high_resolution_clock::now();
     int outputCount = 0;
+    double outputTime = 0.0;    // Time spent in BeginStep..EndStep
+    double exposedTime = 0.0;   // Output time the simulation actually waited for
+    
+    std::unique_ptr<StepMetrics> metrics(new StepMetrics(MPI_COMM_WORLD, 5, metricsInterval));
+    std::unique_ptr<BurstBuffer> spill;
+    std::unique_ptr<AsyncOutputWriter> asyncWriter;
+    if (asyncOutput) {
+        if (!spillDir.empty()) {
+            spill.reset(new BurstBuffer(spillDir, contactFile, sim.getLocalSize(), spillSegment, rank));
+        }
+        asyncWriter.reset(new AsyncOutputWriter(stream, aggregator, fieldU, fieldV, deltaU.get(), deltaV.get(),
+                                                spill.get(), varStep, varTimestamp,
+                                                compression, controller, *metrics, rank, sim.getLocalSize(),
+                                                outputBuffers));
+    }
     
     // Main simulation loop
     for (int step = 0; step <= totalSteps; ++step) {
         // Output at interval
         if (step % outputInterval == 0) {
-            auto stepStart = std::chrono::high_resolution_clock::now();
-            
-            writer.BeginStep();
-            
-            auto dataU = sim.getU();
-            auto dataV = sim.getV();
-            
-            writer.Put(varU, dataU.data());
-            writer.Put(varV, dataV.data());
-            
-            if (rank == 0) {
-                int32_t stepVal = step;
-                writer.Put(varStep, stepVal);
-            }
-            
-            writer.EndStep();
-            
-            auto stepEnd = std::chrono::high_resolution_clock::now();
-            double stepTime = std::chrono::duration<double>(stepEnd - stepStart).count();
-            
-            double localDataMB = (dataU.size() + dataV.size()) * sizeof(double) / (1024.0 * 1024.0);
-            double globalDataMB = 0.0;
-            MPI_Reduce(&localDataMB, &globalDataMB, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-            
-            if (rank == 0) {
-                std::cout << "Output " << std::setw(4) << outputCount 
-                          << " (sim step " << std::setw(6) << step << ")"
-                          << " | Time: " << std::fixed << std::setprecision(3) << stepTime << " s"
-                          << " | Size: " << std::setprecision(2) << globalDataMB << " MB"
-                          << " | Throughput: " << std::setprecision(2) << globalDataMB / stepTime << " MB/s"
-                          << std::endl;
+            if (asyncWriter && (monitorMode || spill)) {
+                asyncWriter->offer(sim, step, outputCount);
+                outputCount++;
+            } else if (asyncWriter) {
+                asyncWriter->submit(sim, step, outputCount);
+                outputCount++;
+            } else {
+                auto stepStart = std::chrono::high_resolution_clock::now();
+                double timestamp = wallClock();
+                
+                // Convert to the wire precision (no-op for double)
+                if (!deltaU) {
+                    TraceScope trace("encode");
+                    fieldU.encode(sim.getUData(), MPI_COMM_WORLD, memorySelection);
+                    fieldV.encode(sim.getVData(), MPI_COMM_WORLD, memorySelection);
+                }
+                
+                // Measure compression on sampled outputs (excluded from the step time)
+                double probeTime = 0.0;
+                if (!deltaU && compression.shouldProbe(outputCount)) {
+                    auto probeStart = std::chrono::high_resolution_clock::now();
+                    fieldU.probe(compression, sim.getUData(), memorySelection);
+                    fieldV.probe(compression, sim.getVData(), memorySelection);
+                    probeTime = std::chrono::duration<double>(
+                        std::chrono::high_resolution_clock::now() - probeStart).count();
+                }
+                
+                if (aggregator.isWriter()) stream.beginStep();
+                
+                // Zero-copy for double: Put straight from the simulation arrays.
+                // Deferred Puts are only consumed at EndStep, before sim.step() runs.
+                const double* dataU = sim.getUData();
+                const double* dataV = sim.getVData();
+                if (!denseU.empty()) {
+                    TraceScope trace("copy");
+                    sim.copyU(denseU.data());
+                    sim.copyV(denseV.data());
+                    dataU = denseU.data();
+                    dataV = denseV.data();
+                }
+                size_t bytes;
+                {
+                    TraceScope trace("put");
+                    if (deltaU) {
+                        deltaU->put(stream.primary(), dataU, outputCount);
+                        deltaV->put(stream.primary(), dataV, outputCount);
+                        bytes = deltaU->lastBytes() + deltaV->lastBytes();
+                    } else {
+                        fieldU.put(stream, dataU, aggregator);
+                        fieldV.put(stream, dataV, aggregator);
+                        fieldU.record(compression);
+                        fieldV.record(compression);
+                        bytes = fieldU.wireBytes() + fieldV.wireBytes();
+                    }
+                    
+                    if (rank == 0) {
+                        int32_t stepVal = step;
+                        stream.primary().Put(varStep, stepVal);
+                        stream.primary().Put(varTimestamp, timestamp);
+                    }
+                }
+                
+                if (aggregator.isWriter()) stream.endStep();
+                
+                auto stepEnd = std::chrono::high_resolution_clock::now();
+                double stepTime = std::chrono::duration<double>(stepEnd - stepStart).count() - probeTime;
+                outputTime += stepTime;
+                exposedTime += stepTime;
+                
+                reportOutput(outputCount, step, stepTime, bytes, compression, controller, *metrics, "");
+                
+                outputCount++;
             }
-            
-            outputCount++;
         }
         
         // Advance simulation (except on last iteration)
@@ -432,20 +864,92 @@ int main(int argc, char* argv[])
         }
     }
     
-    writer.Close();
+    int droppedOutputs = 0;   // Same on every rank (offer() is collective)
+    if (asyncWriter) {
+        asyncWriter->finish();
+        outputTime = asyncWriter->getOutputTime();
+        exposedTime = asyncWriter->getExposedTime();
+        droppedOutputs = asyncWriter->getDropped();
+        asyncWriter.reset();
+    }
+    
+    if (aggregator.isWriter()) stream.close();
+    metrics->flush();
     
     auto overallEnd = std::chrono::high_resolution_clock::now();
     double totalTime = std::chrono::duration<double>(overallEnd - overallStart).count();
     
+    // Slowest rank determines how much output time the run really paid for
+    double maxOutputTime = 0.0, maxExposedTime = 0.0;
+    MPI_Reduce(&outputTime, &maxOutputTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&exposedTime, &maxExposedTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    double gatherTime = aggregator.getGatherTime(), maxGatherTime = 0.0;
+    MPI_Reduce(&gatherTime, &maxGatherTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    std::string outputSpread = rankSpread("Output time per rank", outputTime, " s", MPI_COMM_WORLD);
+    double spillPeakMB = 0.0, spillTime = 0.0;
+    if (spill) {
+        double localPeakMB = spill->getPeakBytes() / (1024.0 * 1024.0), localSpillTime = spill->getSpillTime();
+        MPI_Reduce(&localPeakMB, &spillPeakMB, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&localSpillTime, &spillTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    }
+    double deltaTotals[4] = {0.0, 0.0, 0.0, 0.0};   // Tiles sent, tiles, bytes sent, full bytes
+    if (deltaU) {
+        double local[4] = {
+            static_cast<double>(deltaU->tilesSent() + deltaV->tilesSent()),
+            static_cast<double>(deltaU->tilesTotal() + deltaV->tilesTotal()),
+            static_cast<double>(deltaU->bytesSent() + deltaV->bytesSent()),
+            static_cast<double>(deltaU->bytesFull() + deltaV->bytesFull())
+        };
+        MPI_Reduce(local, deltaTotals, 4, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+    std::string traceSummary = finishTracing(tracer, MPI_COMM_WORLD);
+    std::string bufferWarning = bufferSummary(MPI_COMM_WORLD);
+    
     if (rank == 0) {
         std::cout << std::string(60, '=') << std::endl;
         std::cout << "=== Simulation Complete ===" << std::endl;
         std::cout << "Total simulation steps: " << totalSteps << std::endl;
         std::cout << "Total output steps: " << outputCount << std::endl;
         std::cout << "Total time: " << std::fixed << std::setprecision(3) << totalTime << " s" << std::endl;
+        if (monitorMode) {
+            int delivered = outputCount - droppedOutputs;
+            std::cout << "Monitoring: " << delivered << " outputs handed to SST, " << droppedOutputs
+                      << " dropped while staging was busy" << std::endl;
+            std::cout << "Frame rate: produced " << std::setprecision(2) << outputCount / totalTime
+                      << " /s | delivered to SST " << delivered / totalTime
+                      << " /s (SST may discard more on a full queue, see the receiver)" << std::endl;
+            std::cout << std::setprecision(3);
+        }
+        if (spill) {
+            std::cout << "Burst buffer: " << spill->getSpilled() << " outputs spilled in " << spill->getSegments()
+                      << " files, all drained | Peak on disk: " << std::setprecision(1) << spillPeakMB
+                      << " MB per rank | Spill writes: " << std::setprecision(3) << spillTime << " s" << std::endl;
+        }
+        double hiddenTime = std::max(0.0, maxOutputTime - maxExposedTime);
+        std::cout << "Output time: " << maxOutputTime << " s"
+                  << " | Exposed: " << maxExposedTime << " s"
+                  << " | Hidden: " << hiddenTime << " s ("
+                  << std::setprecision(1) << (maxOutputTime > 0.0 ? 100.0 * hiddenTime / maxOutputTime : 0.0)
+                  << "%)" << std::endl;
+        std::cout << outputSpread << std::endl;
+        std::cout << "SST transport: " << transports.usedName() << std::endl;
+        if (aggregator.enabled()) {
+            std::cout << "Aggregation gather time: " << std::setprecision(3) << maxGatherTime << " s" << std::endl;
+        }
+        if (deltaU && deltaTotals[1] > 0.0 && deltaTotals[2] > 0.0) {
+            std::cout << "Delta encoding: " << std::setprecision(1) << 100.0 * deltaTotals[0] / deltaTotals[1]
+                      << "% of tiles sent, " << deltaTotals[2] / (1024.0 * 1024.0) << " MB of "
+                      << deltaTotals[3] / (1024.0 * 1024.0) << " MB ("
+                      << std::setprecision(2) << deltaTotals[3] / deltaTotals[2] << "x)" << std::endl;
+        }
+        if (!traceSummary.empty()) std::cout << traceSummary << std::endl;
+        if (!bufferWarning.empty()) std::cerr << bufferWarning << std::endl;
+        compression.printSummary(std::cout);
         std::cout << std::string(60, '=') << std::endl;
     }
     
+    spill.reset();   // Its ADIOS instances before MPI_Finalize
+    metrics.reset();
     MPI_Finalize();
     return 0;
 }
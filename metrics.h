@@ -0,0 +1,155 @@
+/*
+ * Step metrics without per-step synchronization
+ *
+ *   --metrics-interval=N   reduce the step metrics every N steps (default 10)
+ *
+ * Each rank records its own values for a step (bytes, seconds, ...) and
+ * nothing is sent until N steps have collected. The batch is then reduced
+ * to rank 0 with nonblocking MPI_Ireduce (sum, min and max of every value)
+ * on a communicator of its own, and later calls only MPI_Test it, so no
+ * rank waits for another at a step boundary. Rank 0 prints a step once its
+ * batch has arrived: the per-step lines run up to about 2N steps behind,
+ * and flush() waits for the rest at close. Min and max next to the sum
+ * show stragglers that a single sum hides; the per-step lines print the
+ * max/mean imbalance of the step time, and the summaries the slowest and
+ * fastest rank.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class StepMetrics {
+public:
+    // One step over all ranks (rank 0 only)
+    struct Reduced {
+        std::vector<double> sum, min, max;
+        int ranks = 1;
+
+        double mean(size_t field) const { return sum[field] / ranks; }
+        // Slowest rank over the mean, 1 when balanced
+        double imbalance(size_t field) const {
+            return mean(field) > 0.0 ? max[field] / mean(field) : 1.0;
+        }
+    };
+    typedef std::function<void(const Reduced&)> Report;
+
+    StepMetrics(MPI_Comm comm, size_t fields, int interval)
+        : fields_(fields), interval_(std::max(1, interval))
+    {
+        MPI_Comm_dup(comm, &comm_);
+        MPI_Comm_rank(comm_, &rank_);
+        MPI_Comm_size(comm_, &size_);
+    }
+
+    // flush() and free the communicator; must run before MPI_Finalize
+    ~StepMetrics() {
+        flush();
+        MPI_Comm_free(&comm_);
+    }
+
+    StepMetrics(const StepMetrics&) = delete;
+    StepMetrics& operator=(const StepMetrics&) = delete;
+
+    // This rank's values (`fields` of them) for the next step. report runs
+    // on rank 0 once the step is reduced, in step order; other ranks drop it.
+    void record(const std::vector<double>& values, Report report) {
+        current_.local.insert(current_.local.end(), values.begin(), values.end());
+        current_.local.resize(++current_.steps * fields_);
+        if (rank_ == 0) current_.reports.push_back(report);
+        if (static_cast<int>(current_.steps) >= interval_) start();
+        poll(false);
+    }
+
+    // Reduce what is left and run every outstanding report (collective)
+    void flush() {
+        if (current_.steps > 0) start();
+        poll(true);
+    }
+
+    int interval() const { return interval_; }
+
+private:
+    struct Batch {
+        std::vector<double> local, sum, min, max;
+        std::vector<Report> reports;
+        size_t steps = 0;
+        MPI_Request requests[3];
+    };
+
+    void start() {
+        Batch& b = current_;
+        int count = static_cast<int>(b.local.size());
+        b.sum.resize(b.local.size());
+        b.min.resize(b.local.size());
+        b.max.resize(b.local.size());
+        MPI_Ireduce(b.local.data(), b.sum.data(), count, MPI_DOUBLE, MPI_SUM, 0, comm_, &b.requests[0]);
+        MPI_Ireduce(b.local.data(), b.min.data(), count, MPI_DOUBLE, MPI_MIN, 0, comm_, &b.requests[1]);
+        MPI_Ireduce(b.local.data(), b.max.data(), count, MPI_DOUBLE, MPI_MAX, 0, comm_, &b.requests[2]);
+        pending_.push_back(std::move(current_));   // Moving keeps the vectors' storage in place
+        current_ = Batch();
+    }
+
+    // Report finished batches in order; with wait, block until all are
+    void poll(bool wait) {
+        while (!pending_.empty()) {
+            Batch& b = pending_.front();
+            int done = 1;
+            if (wait) {
+                MPI_Waitall(3, b.requests, MPI_STATUSES_IGNORE);
+            } else {
+                MPI_Testall(3, b.requests, &done, MPI_STATUSES_IGNORE);
+            }
+            if (!done) return;
+            for (size_t s = 0; s < b.reports.size(); ++s) {
+                Reduced step;
+                step.ranks = size_;
+                auto first = s * fields_;
+                step.sum.assign(b.sum.begin() + first, b.sum.begin() + first + fields_);
+                step.min.assign(b.min.begin() + first, b.min.begin() + first + fields_);
+                step.max.assign(b.max.begin() + first, b.max.begin() + first + fields_);
+                b.reports[s](step);
+            }
+            pending_.pop_front();
+        }
+    }
+
+    size_t fields_;
+    int interval_;
+    MPI_Comm comm_;
+    int rank_ = 0, size_ = 1;
+    Batch current_;
+    std::deque<Batch> pending_;
+};
+
+// Fastest and slowest rank for one per-rank total, e.g. "Output time per
+// rank: min 1.203 s (rank 3) | max 1.950 s (rank 7) | imbalance 1.41".
+// Collective; empty except on rank 0.
+inline std::string rankSpread(const std::string& label, double value, const char* unit, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    struct { double value; int rank; } local = {value, rank}, lo, hi;
+    double sum = 0.0;
+    MPI_Reduce(&local, &lo, 1, MPI_DOUBLE_INT, MPI_MINLOC, 0, comm);
+    MPI_Reduce(&local, &hi, 1, MPI_DOUBLE_INT, MPI_MAXLOC, 0, comm);
+    MPI_Reduce(&value, &sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    if (rank != 0) return "";
+    double mean = sum / size;
+    std::ostringstream out;
+    out << label << ": min " << std::fixed << std::setprecision(3) << lo.value << unit << " (rank " << lo.rank
+        << ") | max " << hi.value << unit << " (rank " << hi.rank << ") | imbalance " << std::setprecision(2)
+        << (mean > 0.0 ? hi.value / mean : 1.0);
+    return out.str();
+}
+
+#endif // METRICS_H
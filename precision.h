@@ -0,0 +1,315 @@
+/*
+ * Reduced-precision wire formats for double fields
+ *
+ *   --precision=double    unchanged (default)
+ *   --precision=float32   IEEE single precision, half the bytes
+ *   --precision=fixed16   16-bit fixed point, a quarter of the bytes
+ *
+ * fixed16 maps the step's global [min, max] of a field onto 0..65535, so
+ * the absolute error is at most (max - min) / 131070. The offset (min) and
+ * scale are written next to the field as the scalars "<name>/offset" and
+ * "<name>/scale", which the receiver uses to widen back to double.
+ *
+ * The conversion kernels are unit-stride loops over restrict pointers that
+ * the compiler vectorizes at -O2/-O3.
+ */
+
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <adios2.h>
+#include <mpi.h>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "aggregation.h"
+#include "buffers.h"
+#include "compression.h"
+
+enum class WirePrecision { Double, Float32, Fixed16 };
+
+inline WirePrecision parseWirePrecision(const std::string& text)
+{
+    if (text == "double") return WirePrecision::Double;
+    if (text == "float32") return WirePrecision::Float32;
+    if (text == "fixed16") return WirePrecision::Fixed16;
+    throw std::invalid_argument("unknown precision '" + text + "' (use double, float32 or fixed16)");
+}
+
+inline const char* wirePrecisionName(WirePrecision precision)
+{
+    switch (precision) {
+        case WirePrecision::Float32: return "float32";
+        case WirePrecision::Fixed16: return "fixed16";
+        default: return "double";
+    }
+}
+
+inline size_t wireElementSize(WirePrecision precision)
+{
+    switch (precision) {
+        case WirePrecision::Float32: return sizeof(float);
+        case WirePrecision::Fixed16: return sizeof(uint16_t);
+        default: return sizeof(double);
+    }
+}
+
+inline void narrowToFloat(const double* __restrict src, float* __restrict dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<float>(src[i]);
+    }
+}
+
+inline void accumulateRange(const double* __restrict src, size_t n, double& lo, double& hi)
+{
+    double l = lo, h = hi;
+    for (size_t i = 0; i < n; ++i) {
+        l = src[i] < l ? src[i] : l;
+        h = src[i] > h ? src[i] : h;
+    }
+    lo = l;
+    hi = h;
+}
+
+inline void quantize16(const double* __restrict src, uint16_t* __restrict dst, size_t n,
+                       double offset, double invScale)
+{
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<uint16_t>((src[i] - offset) * invScale + 0.5);
+    }
+}
+
+// Inverse of narrowToFloat (offset 0, scale 1) and quantize16
+template <class T>
+inline void widenToDouble(const T* __restrict src, double* __restrict dst, size_t n,
+                          double offset = 0.0, double scale = 1.0)
+{
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = offset + scale * static_cast<double>(src[i]);
+    }
+}
+
+// One double field and its wire representation. Double fields are Put
+// straight from the caller's memory; reduced formats are first encoded into
+// a persistent buffer that stays valid until the next encode().
+class WireField {
+public:
+    WireField(adios2::IO& io, const std::string& name, WirePrecision precision,
+              const adios2::Dims& shape, const adios2::Dims& start, const adios2::Dims& count,
+              int rank)
+        : name_(name), precision_(precision), start_(start), count_(count), rank_(rank)
+    {
+        elements_ = 1;
+        for (auto c : count) elements_ *= c;
+
+        switch (precision_) {
+            case WirePrecision::Double:
+                varDouble_ = io.DefineVariable<double>(name, shape, start, count);
+                break;
+            case WirePrecision::Float32:
+                varFloat_ = io.DefineVariable<float>(name, shape, start, count);
+                floatData_.resize(elements_);
+                break;
+            case WirePrecision::Fixed16:
+                varFixed_ = io.DefineVariable<uint16_t>(name, shape, start, count);
+                fixedData_.resize(elements_);
+                if (rank_ == 0) {
+                    varOffset_ = io.DefineVariable<double>(name + "/offset");
+                    varScale_ = io.DefineVariable<double>(name + "/scale");
+                }
+                break;
+        }
+    }
+
+    WirePrecision precision() const { return precision_; }
+    size_t elementSize() const { return wireElementSize(precision_); }
+    size_t wireBytes() const { return elements_ * elementSize(); }
+
+    // The double variable (Double precision only), e.g. for a memory selection
+    adios2::Variable<double>& doubleVariable() { return varDouble_; }
+
+    // Replace the constructor's selection by several blocks of the global
+    // array stored back to back in src (e.g. whole writer blocks); put()
+    // then writes one block each and probe() measures the first
+    void setBlocks(const std::vector<adios2::Box<adios2::Dims>>& blocks) {
+        blocks_ = blocks;
+        multiBlock_ = true;
+        elements_ = 0;
+        for (const auto& box : blocks_) elements_ += boxElements(box.second);
+        count_ = blocks_.empty() ? adios2::Dims() : blocks_.front().second;
+        if (precision_ == WirePrecision::Float32) floatData_.resize(elements_);
+        if (precision_ == WirePrecision::Fixed16) fixedData_.resize(elements_);
+    }
+
+    void attach(CompressionPipeline& compression) {
+        switch (precision_) {
+            case WirePrecision::Double: compression.attach(varDouble_); break;
+            case WirePrecision::Float32: compression.attach(varFloat_); break;
+            case WirePrecision::Fixed16: compression.attach(varFixed_); break;
+        }
+    }
+
+    // Convert the local block to the wire format. src holds count elements,
+    // or with a (3D) memory selection the padded array they are cut from.
+    // Fixed16 reduces the value range over comm, so it is collective.
+    void encode(const double* src, MPI_Comm comm,
+                const adios2::Box<adios2::Dims>& memorySelection = adios2::Box<adios2::Dims>()) {
+        double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+        if (precision_ == WirePrecision::Fixed16) {
+            localRange(src, memorySelection, lo, hi);
+            reduceRange(comm, lo, hi);
+        }
+        encodeWithRange(src, lo, hi, memorySelection);
+    }
+
+    // Widen [lo, hi] by the local block's values (fixed16 only needs it)
+    void localRange(const double* src, const adios2::Box<adios2::Dims>& memorySelection,
+                    double& lo, double& hi) const {
+        forEachRow(src, memorySelection, [&lo, &hi](const double* row, size_t, size_t n) {
+            accumulateRange(row, n, lo, hi);
+        });
+    }
+
+    static void reduceRange(MPI_Comm comm, double& lo, double& hi) {
+        double local[2] = {-lo, hi};  // One MAX reduction for both ends
+        double range[2];
+        MPI_Allreduce(local, range, 2, MPI_DOUBLE, MPI_MAX, comm);
+        lo = -range[0];
+        hi = range[1];
+    }
+
+    // encode() with the global fixed16 range already known; no communication
+    void encodeWithRange(const double* src, double lo, double hi,
+                         const adios2::Box<adios2::Dims>& memorySelection = adios2::Box<adios2::Dims>()) {
+        if (precision_ == WirePrecision::Float32) {
+            forEachRow(src, memorySelection, [this](const double* row, size_t at, size_t n) {
+                narrowToFloat(row, floatData_.data() + at, n);
+            });
+        } else if (precision_ == WirePrecision::Fixed16) {
+            offset_ = lo;
+            scale_ = (hi > lo) ? (hi - lo) / 65535.0 : 1.0;
+            double invScale = 1.0 / scale_;
+            forEachRow(src, memorySelection, [this, invScale](const double* row, size_t at, size_t n) {
+                quantize16(row, fixedData_.data() + at, n, offset_, invScale);
+            });
+        }
+    }
+
+    // Deferred Put of the last encode(), or of src for Double precision
+    void put(adios2::Engine& engine, const double* src) {
+        switch (precision_) {
+            case WirePrecision::Double:
+                putBlocks(engine, varDouble_, src);
+                break;
+            case WirePrecision::Float32:
+                putBlocks(engine, varFloat_, floatData_.data());
+                break;
+            case WirePrecision::Fixed16:
+                putBlocks(engine, varFixed_, fixedData_.data());
+                if (rank_ == 0) {
+                    engine.Put(varOffset_, offset_);
+                    engine.Put(varScale_, scale_);
+                }
+                break;
+        }
+    }
+
+    // Deferred Put through the WAN aggregator (collective over its group
+    // when enabled); src must be dense, and setBlocks() is not supported
+    void put(adios2::Engine& engine, const double* src, WanAggregator& aggregator) {
+        switch (precision_) {
+            case WirePrecision::Double:
+                aggregator.put(engine, varDouble_, src, start_, count_);
+                break;
+            case WirePrecision::Float32:
+                aggregator.put(engine, varFloat_, floatData_.data(), start_, count_);
+                break;
+            case WirePrecision::Fixed16:
+                aggregator.put(engine, varFixed_, fixedData_.data(), start_, count_);
+                if (rank_ == 0) {
+                    engine.Put(varOffset_, offset_);
+                    engine.Put(varScale_, scale_);
+                }
+                break;
+        }
+    }
+
+    // Compression measurement on what actually goes over the wire
+    void probe(CompressionPipeline& compression, const double* src,
+               const adios2::Box<adios2::Dims>& memorySelection = adios2::Box<adios2::Dims>()) {
+        switch (precision_) {
+            case WirePrecision::Double: compression.probe(name_, src, count_, memorySelection); break;
+            case WirePrecision::Float32: compression.probe(name_, floatData_.data(), count_); break;
+            case WirePrecision::Fixed16: compression.probe(name_, fixedData_.data(), count_); break;
+        }
+    }
+
+    void record(CompressionPipeline& compression) {
+        switch (precision_) {
+            case WirePrecision::Double: compression.record<double>(name_, elements_); break;
+            case WirePrecision::Float32: compression.record<float>(name_, elements_); break;
+            case WirePrecision::Fixed16: compression.record<uint16_t>(name_, elements_); break;
+        }
+    }
+
+private:
+    static size_t boxElements(const adios2::Dims& count) {
+        size_t elements = 1;
+        for (auto c : count) elements *= c;
+        return elements;
+    }
+
+    template <class W>
+    void putBlocks(adios2::Engine& engine, adios2::Variable<W>& var, const W* data) {
+        if (!multiBlock_) {
+            if (elements_ > 0) engine.Put(var, data);
+            return;
+        }
+        for (const auto& box : blocks_) {
+            var.SetSelection(box);
+            engine.Put(var, data);
+            data += boxElements(box.second);
+        }
+    }
+
+    // Call kernel(row, denseOffset, length) over the rows of the local block
+    template <class Kernel>
+    void forEachRow(const double* src, const adios2::Box<adios2::Dims>& memorySelection, Kernel kernel) const {
+        if (memorySelection.first.empty() || multiBlock_ || count_.size() != 3) {
+            kernel(src, 0, elements_);
+            return;
+        }
+        const adios2::Dims& ms = memorySelection.first;
+        const adios2::Dims& mc = memorySelection.second;
+        for (size_t z = 0; z < count_[0]; ++z) {
+            for (size_t y = 0; y < count_[1]; ++y) {
+                const double* row = src + ((z + ms[0]) * mc[1] + (y + ms[1])) * mc[2] + ms[2];
+                kernel(row, (z * count_[1] + y) * count_[2], count_[2]);
+            }
+        }
+    }
+
+    std::string name_;
+    WirePrecision precision_;
+    adios2::Dims start_;
+    adios2::Dims count_;
+    size_t elements_;
+    int rank_;
+
+    adios2::Variable<double> varDouble_;
+    adios2::Variable<float> varFloat_;
+    adios2::Variable<uint16_t> varFixed_;
+    adios2::Variable<double> varOffset_, varScale_;
+    AlignedVector<float> floatData_;
+    AlignedVector<uint16_t> fixedData_;
+    double offset_ = 0.0;
+    double scale_ = 1.0;
+    std::vector<adios2::Box<adios2::Dims>> blocks_;   // Set by setBlocks()
+    bool multiBlock_ = false;
+};
+
+#endif // PRECISION_H
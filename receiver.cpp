@@ -12,23 +12,686 @@
 #include <fstream>
 #include <mpi.h>
 #include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
-int main(int argc, char *argv[])
+#include "autotune.h"
+#include "buffers.h"
+#include "clock.h"
+#include "config.h"
+#include "delta.h"
+#include "metrics.h"
+#include "precision.h"
+#include "relay.h"
+#include "resume.h"
+#include "striping.h"
+#include "trace.h"
+#include "transport.h"
+
+// Match a "--name=value" command line option and extract its value
+static bool parseOption(const std::string& arg, const std::string& name, std::string& value)
 {
-    MPI_Init(&argc, &argv);
+    if (arg.compare(0, name.size(), name) != 0) return false;
+    value = arg.substr(name.size());
+    return true;
+}
+
+// Relays a float32/fixed16 field as double (--widen). fixed16 blocks are
+// widened with the step's "<name>/offset" and "<name>/scale" scalars.
+template <class T>
+class WideningRelay : public TypedRelay<T> {
+public:
+    WideningRelay(const std::string& name, size_t slots)
+        : TypedRelay<T>(name, slots), params_(slots), wide_(slots) {}
     
-    int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    size_t get(adios2::IO& io, adios2::Engine& reader, size_t slot, int rank, int size) override {
+        size_t bytes = TypedRelay<T>::get(io, reader, slot, rank, size);
+        Quantization& q = params_[slot];
+        q.valid = !std::is_same<T, uint16_t>::value;   // float32 needs no parameters
+        if (!q.valid) {
+            auto offset = io.InquireVariable<double>(this->name_ + "/offset");
+            auto scale = io.InquireVariable<double>(this->name_ + "/scale");
+            if (offset && scale) {
+                reader.Get(offset, q.offset, adios2::Mode::Deferred);
+                reader.Get(scale, q.scale, adios2::Mode::Deferred);
+                q.valid = true;
+            }
+        }
+        return bytes;
+    }
+    
+    void put(adios2::IO& io, adios2::Engine& writer, size_t slot, RelayContext& ctx) override {
+        auto& b = this->buffers_[slot];
+        const Quantization& q = params_[slot];
+        if (!b.pending || b.shape.empty() || !q.valid) {
+            TypedRelay<T>::put(io, writer, slot, ctx);   // Relay as received
+            return;
+        }
+        
+        std::vector<double>& wide = wide_[slot];
+        if (wide.size() != b.data.size()) wide.resize(b.data.size());
+        widenToDouble(b.data.data(), wide.data(), wide.size(), q.offset, q.scale);
+        
+        if (!outWide_) {
+            outWide_ = io.InquireVariable<double>(this->name_);   // Another stream's relay
+            if (outWide_) wideShape_ = outWide_.Shape();
+        }
+        if (!outWide_) {
+            outWide_ = io.DefineVariable<double>(this->name_, b.shape, b.blocks.front().start,
+                                                 b.blocks.front().count);
+            wideShape_ = b.shape;
+        } else if (b.shape != wideShape_) {
+            outWide_.SetShape(b.shape);
+            wideShape_ = b.shape;
+        }
+        for (const auto& block : b.blocks) {
+            outWide_.SetSelection({block.start, block.count});
+            writer.Put(outWide_, wide.data() + block.offset);
+        }
+    }
+    
+private:
+    struct Quantization {
+        double offset = 0.0;
+        double scale = 1.0;
+        bool valid = false;
+    };
+    
+    std::vector<Quantization> params_;
+    std::vector<std::vector<double>> wide_;
+    adios2::Variable<double> outWide_;
+    adios2::Dims wideShape_;
+};
+
+// Nearest-rank percentile (p in 0..100)
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+    return values[std::min(values.size(), std::max<size_t>(index, 1)) - 1];
+}
+
+// Integer scalar `name` of the current step; step counters are int32_t
+// (gs_sender) or size_t (sender). Single values live in the step's metadata,
+// so the Sync Get does not go over the wire.
+static bool readCounter(adios2::IO& io, adios2::Engine& reader, const std::string& name,
+                        const std::string& type, long long& value)
+{
+#define read_counter(T)                                                    \
+    if (type == adios2::GetType<T>()) {                                    \
+        T v = 0;                                                           \
+        reader.Get(io.InquireVariable<T>(name), v, adios2::Mode::Sync);    \
+        value = static_cast<long long>(v);                                 \
+        return true;                                                       \
+    }
+    read_counter(int32_t)
+    read_counter(uint32_t)
+    read_counter(int64_t)
+    read_counter(uint64_t)
+#undef read_counter
+    return false;
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Field a delta-encoded "<name>/delta" rebuilds, or "" for other variables
+static std::string deltaField(const std::string& name, const std::string& type)
+{
+    const std::string suffix = "/delta";
+    if (type != adios2::GetType<double>() || name.size() <= suffix.size() ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) return "";
+    return name.substr(0, name.size() - suffix.size());
+}
+
+// Relay for a newly seen variable; nullptr for unsupported types
+static std::unique_ptr<VariableRelay> makeReceiverRelay(const std::string& name, const std::string& type,
+                                                        size_t slots, bool widen)
+{
+    std::string field = deltaField(name, type);
+    if (!field.empty()) return std::unique_ptr<VariableRelay>(new DeltaRelay(field, slots));
+    if (widen && type == adios2::GetType<float>()) {
+        return std::unique_ptr<VariableRelay>(new WideningRelay<float>(name, slots));
+    }
+    if (widen && type == adios2::GetType<uint16_t>()) {
+        return std::unique_ptr<VariableRelay>(new WideningRelay<uint16_t>(name, slots));
+    }
+    return makeRelay(name, type, slots);
+}
+
+// One received SST step: the relays it carries and the buffer slot they
+// received into
+struct ReceivedStep {
+    std::vector<VariableRelay*> relays;
+    size_t slot = 0;
+    size_t index = 0;
+};
+
+// What is requested from the writers (--vars, --roi, --stride,
+// --step-interval); everything by default
+struct ReadSelection {
+    std::set<std::string> arrays;   // Arrays to relay (empty = all); scalars always are
+    Subset subset;
+    size_t stepInterval = 1;        // Read every Nth step, only step through the rest
+    
+    bool wants(const std::string& name) const { return arrays.empty() || arrays.count(name) > 0; }
+};
+
+// Comma-separated variable names
+static std::set<std::string> parseNameList(const std::string& text)
+{
+    std::set<std::string> names;
+    std::stringstream in(text);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        if (!name.empty()) names.insert(name);
+    }
+    return names;
+}
+
+// Post a deferred Get for every variable, then fetch them all with one
+// PerformGets() so the SST reader can pipeline the remote reads. Relays are
+// created (and their type resolved) the first time a variable shows up.
+// Returns the MB received by this rank. Without `scalars` only arrays are
+// relayed (secondary stripes repeat the primary stream's scalars).
+static double receiveStep(adios2::IO& ioRead, adios2::Engine& reader,
+                          const std::map<std::string, adios2::Params>& variables,
+                          std::map<std::string, std::unique_ptr<VariableRelay>>& relays,
+                          size_t slots, bool widen, Decomposition decomposition, bool scalars,
+                          const ReadSelection& selection, ReceivedStep& step, int rank, int size)
+{
+    size_t bytes = 0;
+    step.relays.clear();
+    
+    for (const auto& varPair : variables) {
+        const std::string& varName = varPair.first;
+        const auto& varInfo = varPair.second;
+        
+        // Widening consumes the fixed16 offset/scale scalars itself
+        if (widen && (endsWith(varName, "/offset") || endsWith(varName, "/scale"))) continue;
+        auto single = varInfo.find("SingleValue");
+        auto type = varInfo.find("Type");
+        bool scalar = single != varInfo.end() && single->second == "true";
+        std::string field = type == varInfo.end() ? "" : deltaField(varName, type->second);
+        if (scalar ? !scalars : !selection.wants(field.empty() ? varName : field)) continue;
+        
+        auto it = relays.find(varName);
+        if (it == relays.end()) {
+            auto typeIt = varInfo.find("Type");
+            if (typeIt == varInfo.end()) continue;
+            // A delta only applies on top of the one before it
+            if (!field.empty() && selection.stepInterval > 1) {
+                throw std::invalid_argument("--step-interval cannot be used with the delta-encoded " + field +
+                                            ", every step is needed to rebuild it");
+            }
+            it = relays.emplace(varName, makeReceiverRelay(varName, typeIt->second, slots, widen)).first;
+            if (it->second) {
+                it->second->setDecomposition(decomposition);
+                it->second->setSubset(selection.subset);
+            } else if (rank == 0) {
+                std::cerr << "Warning: skipping " << varName << " of unsupported type " << typeIt->second << std::endl;
+            }
+        }
+        if (!it->second) continue;
+        
+        bytes += it->second->get(ioRead, reader, step.slot, rank, size);
+        step.relays.push_back(it->second.get());
+    }
+    
+    reader.PerformGets();
+    for (VariableRelay* relay : step.relays) relay->received(step.slot);
+    return bytes / (1024.0 * 1024.0);
+}
+
+// One incoming SST stream, i.e. one stripe of the sender's output. Each
+// stream has its own ADIOS object on a duplicated communicator, so the
+// streams of a step can be read on separate threads.
+class InputStream {
+public:
+    // Stream 0 is IO "TransferIO", stream k > 0 "TransferIO-k", which uses
+    // the config of `first` unless the XML has its own section for it
+    InputStream(MPI_Comm comm, const std::string& configFile, int k, InputStream* first = nullptr)
+    {
+        MPI_Comm_dup(comm, &comm_);
+        adios_.reset(new adios2::ADIOS(configFile, comm_));
+        io_ = adios_->DeclareIO(k == 0 ? "TransferIO" : "TransferIO-" + std::to_string(k));
+        configureIO(io_, "SST", {}, first ? &first->io_ : nullptr);
+    }
+    
+    // Parameters after the config file, for TransportSelector
+    adios2::Params parameters() const { return io_.Parameters(); }
+    
+    // Connect to the writer, falling back to slower transports
+    void open(const std::string& contact, TransportSelector& transports) {
+        transports.open(comm_, [&](Transport transport) {
+            io_.SetParameters(transports.params(transport));
+            reader_ = io_.Open(contact, adios2::Mode::Read);
+        }, [&]() {
+            if (reader_) reader_.Close();
+            reader_ = adios2::Engine();
+        });
+    }
+    
+    ~InputStream() {
+        adios_.reset();
+        MPI_Comm_free(&comm_);
+    }
+    
+    InputStream(const InputStream&) = delete;
+    InputStream& operator=(const InputStream&) = delete;
+    
+    // What read() requests from now on
+    void select(const ReadSelection& selection) { selection_ = selection; }
+    
+    // BeginStep, every variable into relay buffer `slot` with one
+    // PerformGets, EndStep. Steps the selection's interval passes over are
+    // only stepped through, so none of their data is pulled. Sets ok() false
+    // at end of stream. Errors are kept for rethrow() since this may run on
+    // a helper thread.
+    void read(size_t slots, size_t slot, bool widen, Decomposition decomposition, bool scalars,
+              int rank, int size) {
+        ok_ = false;
+        try {
+            {
+                TraceScope trace("begin_step");
+                if (reader_.BeginStep() != adios2::StepStatus::OK) return;
+                while (seen_++ % selection_.stepInterval != 0) {
+                    reader_.EndStep();
+                    skipped_++;
+                    if (reader_.BeginStep() != adios2::StepStatus::OK) return;
+                }
+            }
+            begun_ = std::chrono::high_resolution_clock::now();
+            index_ = reader_.CurrentStep();
+            
+            auto variables = io_.AvailableVariables();
+            variableCount_ = variables.size();
+            
+            // The sender's step counter reveals skipped steps
+            auto counter = variables.find("step");
+            hasStepValue_ = counter != variables.end() &&
+                            readCounter(io_, reader_, "step", counter->second["Type"], stepValue_);
+            
+            // The sender's production time, fetched by receiveStep's PerformGets
+            auto stamp = variables.find("timestamp");
+            hasTimestamp_ = stamp != variables.end() && stamp->second["Type"] == adios2::GetType<double>();
+            if (hasTimestamp_) {
+                reader_.Get(io_.InquireVariable<double>("timestamp"), timestamp_, adios2::Mode::Deferred);
+            }
+            
+            part_.slot = slot;
+            {
+                TraceScope trace("get");
+                sizeMB_ = receiveStep(io_, reader_, variables, relays_, slots, widen, decomposition,
+                                      scalars, selection_, part_, rank, size);
+            }
+            {
+                TraceScope trace("end_step");
+                reader_.EndStep();
+            }
+            receivedAt_ = wallClock();
+            time_ = std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - begun_).count();
+            ok_ = true;
+        } catch (...) {
+            error_ = std::current_exception();
+        }
+    }
+    
+    void rethrow() {
+        if (error_) std::rethrow_exception(error_);
+    }
+    
+    void close() { reader_.Close(); }
+    
+    bool ok() const { return ok_; }
+    size_t index() const { return index_; }
+    const std::vector<VariableRelay*>& relays() const { return part_.relays; }
+    size_t variableCount() const { return variableCount_; }
+    std::chrono::high_resolution_clock::time_point begun() const { return begun_; }
+    double time() const { return time_; }       // This step, after BeginStep returned
+    double sizeMB() const { return sizeMB_; }   // This step, this rank
+    size_t skipped() const { return skipped_; }   // Steps passed over by the interval
+    bool hasStepValue() const { return hasStepValue_; }
+    long long stepValue() const { return stepValue_; }  // The sender's `step`
+    bool hasTimestamp() const { return hasTimestamp_; }
+    double timestamp() const { return timestamp_; }     // Sender clock
+    double receivedAt() const { return receivedAt_; }   // Receiver clock, after EndStep
+    
+    // Parameters over the XML (options naming them explicitly)
+    void setParameters(const adios2::Params& params) { io_.SetParameters(params); }
+    
+    // String attribute of the stream, or "" (valid after the first BeginStep)
+    std::string attribute(const std::string& name) {
+        auto attr = io_.InquireAttribute<std::string>(name);
+        return attr && !attr.Data().empty() ? attr.Data().front() : std::string();
+    }
+    
+private:
+    MPI_Comm comm_;
+    std::unique_ptr<adios2::ADIOS> adios_;
+    adios2::IO io_;
+    adios2::Engine reader_;
+    std::map<std::string, std::unique_ptr<VariableRelay>> relays_;   // One per variable
+    ReceivedStep part_;
+    
+    bool ok_ = false;
+    size_t index_ = 0;
+    size_t variableCount_ = 0;
+    std::chrono::high_resolution_clock::time_point begun_;
+    double time_ = 0.0;
+    double sizeMB_ = 0.0;
+    ReadSelection selection_;
+    size_t seen_ = 0;
+    size_t skipped_ = 0;
+    bool hasStepValue_ = false;
+    long long stepValue_ = 0;
+    bool hasTimestamp_ = false;
+    double timestamp_ = 0.0;
+    double receivedAt_ = 0.0;
+    std::exception_ptr error_;
+};
+
+// Writes received steps to the BP5 output
+class StepWriter {
+public:
+    StepWriter(adios2::IO& io, adios2::Engine& writer, int rank)
+        : io_(io), writer_(writer)
+    {
+        ctx_.rank = rank;
+    }
+    
+    void write(ReceivedStep& step) {
+        TraceScope trace("bp_write");
+        auto start = std::chrono::high_resolution_clock::now();
+        writer_.BeginStep();
+        
+        // Puts are deferred: the buffers stay untouched until EndStep
+        for (VariableRelay* relay : step.relays) {
+            relay->put(io_, writer_, step.slot, ctx_);
+        }
+        
+        writer_.EndStep();
+        writeTime_ += std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+    
+    double getWriteTime() const { return writeTime_; }
+    
+private:
+    adios2::IO& io_;
+    adios2::Engine& writer_;
+    RelayContext ctx_;
+    double writeTime_ = 0.0;
+};
+
+// Pipelined output: SST steps are received into a bounded ring of step
+// buffers and handed to a writer thread that runs the BP5 steps, so a slow
+// disk flush only holds up the SST stream once every buffer is queued.
+class PipelinedWriter {
+public:
+    PipelinedWriter(StepWriter& stepWriter, int depth)
+        : stepWriter_(stepWriter), slots_(depth)
+    {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].slot = i;   // Relay buffer slot owned by this queue entry
+            free_.push_back(i);
+        }
+        thread_ = std::thread(&PipelinedWriter::run, this);
+    }
+    
+    ~PipelinedWriter() {
+        finish();
+    }
+    
+    // Free step buffer to receive into; blocks while the queue is full
+    ReceivedStep& acquire() {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        freeCv_.wait(lock, [this]() { return !free_.empty(); });
+        current_ = free_.front();
+        free_.pop_front();
+        stallTime_ += std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        return slots_[current_];
+    }
+    
+    // Queue the buffer returned by the last acquire() for writing
+    void submit() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            filled_.push_back(current_);
+            maxQueued_ = std::max(maxQueued_, filled_.size());
+        }
+        filledCv_.notify_one();
+    }
+    
+    // Drain all queued steps and stop the writer thread
+    void finish() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        filledCv_.notify_one();
+        thread_.join();
+    }
+    
+    double getStallTime() const { return stallTime_; }
+    size_t getMaxQueued() const { return maxQueued_; }
+    
+private:
+    void run() {
+        traceThread("bp writer");
+        while (true) {
+            size_t slotIdx;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                filledCv_.wait(lock, [this]() { return !filled_.empty() || done_; });
+                if (filled_.empty()) break;  // done_ and fully drained
+                slotIdx = filled_.front();
+                filled_.pop_front();
+            }
+            
+            stepWriter_.write(slots_[slotIdx]);
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                free_.push_back(slotIdx);
+            }
+            freeCv_.notify_one();
+        }
+    }
+    
+    StepWriter& stepWriter_;             // Used by the writer thread only
+    std::vector<ReceivedStep> slots_;
+    std::deque<size_t> free_, filled_;
+    size_t current_ = 0;
+    size_t maxQueued_ = 0;
+    std::mutex mutex_;
+    std::condition_variable freeCv_, filledCv_;
+    bool done_ = false;
+    std::thread thread_;
+    
+    double stallTime_ = 0.0;   // Written by the SST thread only
+};
+
+// --autotune: read the sender's trial streams in order, each with the
+// trial's number of ranks (the rest wait), and drop the data
+static void runAutotune(const std::vector<TuneTrial>& trials, const std::string& configFile,
+                        const std::string& contactFile, int transportTimeout, int rank, int size)
+{
+    if (rank == 0) {
+        std::cout << "=== ADIOS2 Receiver Autotune ===" << std::endl;
+        std::cout << "Trials: " << trials.size() << " (results are written by the sender)" << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+    }
     
-    // Parse command line arguments
+    for (size_t t = 0; t < trials.size(); ++t) {
+        const TuneTrial& trial = trials[t];
+        int readers = trial.readers > 0 ? std::min(trial.readers, size) : size;
+        MPI_Comm comm;
+        MPI_Comm_split(MPI_COMM_WORLD, rank < readers ? 0 : MPI_UNDEFINED, rank, &comm);
+        if (comm != MPI_COMM_NULL) {
+            {   // The stream is closed and freed before its parent communicator
+                InputStream input(comm, configFile, 0);
+                TransportSelector transports(trial.transport, transportTimeout, comm, input.parameters());
+                input.open(tuneContact(contactFile, t), transports);
+                
+                size_t steps = 0;
+                double sizeMB = 0.0;
+                while (true) {
+                    input.read(1, 0, false, Decomposition::Slab, true, rank, readers);
+                    input.rethrow();
+                    if (!input.ok()) break;
+                    sizeMB += input.sizeMB();
+                    steps++;
+                }
+                input.close();
+                
+                double totalMB = 0.0;
+                MPI_Reduce(&sizeMB, &totalMB, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+                if (rank == 0) {
+                    std::cout << "Trial " << std::setw(3) << t << " | " << describeTrial(trial)
+                              << " | " << transportName(transports.used()) << " | " << readers << " readers | "
+                              << steps << " steps, " << std::fixed << std::setprecision(2) << totalMB << " MB"
+                              << std::endl;
+                }
+            }
+            MPI_Comm_free(&comm);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Parse command line arguments (before MPI init since the pipelined
+    // mode needs MPI_THREAD_MULTIPLE)
     std::string contactFile = "data-transfer"; // default name
     std::string outputFile = "received_data.bp"; // default output
     bool useContactString = false;
     std::string contactString = "";
     
-    if (argc > 1) {
-        std::string arg1 = argv[1];
+    bool widen = false;       // Convert reduced-precision fields back to double
+    int pipelineDepth = 0;    // Queued steps between SST and BP5 (0 = lockstep)
+    bool bpAsync = false;     // BP5 AsyncWrite
+    std::string bpAggregators;
+    std::string readDecomposition = "slab";   // How SST arrays are split across ranks
+    int streams = 1;          // Striped SST streams per step (sender --stripes)
+    std::string transportRequest;   // Empty: the config's DataTransport, or sockets
+    int transportTimeout = 30;   // Seconds before falling back to the next transport
+    std::string configFile;      // ADIOS2 XML runtime config
+    std::string autotuneSweep;   // Non-empty: follow the sender's autotune trials
+    int clockSyncInterval = 10;  // Steps between clock offset measurements (0 = once)
+    std::string readerName;      // Tags this reader's output when several share a stream
+    bool monitorMode = false;    // Always take the latest step, skipping stale ones
+    std::string varsOption;      // Arrays to relay (empty = all)
+    std::string roiOption;       // Region of interest, START:COUNT per dimension
+    size_t strideOption = 1;     // Decimation of every dimension
+    size_t stepInterval = 1;     // Read every Nth step
+    bool appendOutput = false;   // Resume: add to an existing output
+    int metricsInterval = 10;    // Steps per batch of reduced step metrics
+    std::string traceFile;       // Chrome trace of every rank's phases
+    size_t traceEvents = 65536;  // Events kept per thread
+    
+    // Positional arguments first, then optional --flags
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        if (arg == "--widen") {
+            widen = true;
+        } else if (arg == "--pipeline") {
+            pipelineDepth = 4;
+        } else if (parseOption(arg, "--pipeline=", value)) {
+            pipelineDepth = std::max(0, std::stoi(value));
+        } else if (arg == "--bp-async") {
+            bpAsync = true;
+        } else if (parseOption(arg, "--bp-aggregators=", value)) {
+            bpAggregators = value;
+        } else if (parseOption(arg, "--read-decomposition=", value)) {
+            readDecomposition = value;
+        } else if (parseOption(arg, "--streams=", value)) {
+            streams = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--transport=", value)) {
+            transportRequest = value;
+        } else if (parseOption(arg, "--transport-timeout=", value)) {
+            transportTimeout = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--config=", value)) {
+            configFile = value;
+        } else if (arg == "--autotune") {
+            autotuneSweep = defaultTuneSweep;
+        } else if (parseOption(arg, "--autotune=", value)) {
+            autotuneSweep = value;
+        } else if (parseOption(arg, "--vars=", value)) {
+            varsOption = value;
+        } else if (parseOption(arg, "--roi=", value)) {
+            roiOption = value;
+        } else if (parseOption(arg, "--stride=", value)) {
+            strideOption = std::max<size_t>(1, std::stoull(value));
+        } else if (parseOption(arg, "--step-interval=", value)) {
+            stepInterval = std::max<size_t>(1, std::stoull(value));
+        } else if (parseOption(arg, "--metrics-interval=", value)) {
+            metricsInterval = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--huge-pages=", value)) {
+            // Before anything allocates an AlignedVector
+            if (!parseHugePages(value, bufferConfig().hugePages)) {
+                std::cerr << "Invalid --huge-pages: " << value << " (expected off, thp or explicit)" << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--trace=", value)) {
+            traceFile = value;
+        } else if (parseOption(arg, "--trace-events=", value)) {
+            traceEvents = std::stoul(value);
+        } else if (arg == "--append") {
+            appendOutput = true;
+        } else if (arg == "--monitor") {
+            monitorMode = true;
+        } else if (parseOption(arg, "--reader-name=", value)) {
+            readerName = value;
+        } else if (parseOption(arg, "--clock-sync=", value)) {
+            clockSyncInterval = std::max(0, std::stoi(value));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    
+    int provided;
+    int required = (pipelineDepth > 0 || streams > 1) ? MPI_THREAD_MULTIPLE : MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, required, &provided);
+    
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    
+    if (pipelineDepth > 0 && provided < MPI_THREAD_MULTIPLE) {
+        if (rank == 0) {
+            std::cerr << "Warning: MPI_THREAD_MULTIPLE not available, "
+                      << "falling back to lockstep SST/BP5 steps" << std::endl;
+        }
+        pipelineDepth = 0;
+    }
+    bool parallelStreams = streams > 1 && provided >= MPI_THREAD_MULTIPLE;
+    if (streams > 1 && !parallelStreams && rank == 0) {
+        std::cerr << "Warning: MPI_THREAD_MULTIPLE not available, "
+                  << "reading the " << streams << " streams one after another" << std::endl;
+    }
+    
+    if (positional.size() > 0) {
+        std::string arg1 = positional[0];
         // Check if it's an SST connection string (starts with typical SST format)
         if (arg1.find("0x") != std::string::npos || arg1.find(":") != std::string::npos) {
             useContactString = true;
@@ -38,26 +701,77 @@ int main(int argc, char *argv[])
             contactFile = arg1;
         }
     }
-    if (argc > 2) {
-        outputFile = argv[2];
+    if (positional.size() > 1) {
+        outputFile = positional[1];
+    }
+    if (streams > 1 && monitorMode) {
+        if (rank == 0) {
+            std::cerr << "Error: --monitor cannot be combined with --streams (each stream would skip "
+                      << "to its own latest step)" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    if (streams > 1 && (!roiOption.empty() || strideOption > 1)) {
+        if (rank == 0) {
+            std::cerr << "Error: --roi/--stride cannot be combined with --streams (stripes only hold "
+                      << "parts of each writer block)" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    if (streams > 1 && useContactString) {
+        if (rank == 0) {
+            std::cerr << "Error: --streams needs the contact file name, not a connection string" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    
+    if (!autotuneSweep.empty()) {
+        try {
+            runAutotune(parseTuneSweep(autotuneSweep), configFile, contactFile, transportTimeout, rank, size);
+        } catch (std::exception &e) {
+            std::cerr << "Error on rank " << rank << ": " << e.what() << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Finalize();
+        return 0;
     }
     
+    // The BP5 writer gets its own communicator so its collectives never
+    // interleave with the SST reader's when they run on separate threads
+    MPI_Comm writeComm;
+    MPI_Comm_dup(MPI_COMM_WORLD, &writeComm);
+    
     try {
-        // Initialize ADIOS2
-        adios2::ADIOS adios(MPI_COMM_WORLD);
+        // Stripes only cover parts of each writer block, so read whole blocks
+        Decomposition decomposition = streams > 1 ? Decomposition::Blocks
+                                                  : parseDecomposition(readDecomposition);
         
-        // Declare IO for reading
-        adios2::IO ioRead = adios.DeclareIO("TransferIO");
+        ReadSelection selection;
+        selection.arrays = parseNameList(varsOption);
+        selection.subset = parseSubset(roiOption, strideOption);
+        selection.stepInterval = stepInterval;
         
-        // Set engine for reading
-        ioRead.SetEngine("SST");
+        // Initialize ADIOS2 for writing (each input stream has its own)
+        adios2::ADIOS writeAdios(configFile, writeComm);
         
-        // Set parameters for WAN
-        ioRead.SetParameters({
-            {"ControlTransport", "sockets"},
-            {"DataTransport", "sockets"},
-            {"OpenTimeoutSecs", "300"}
-        });
+        // With --append, pick up after the last complete step of the
+        // existing output and tell the sender where (rank 0 reads it)
+        unsigned long long counts[2] = {0, 0};   // Complete steps, input step to resume at
+        if (appendOutput && rank == 0 && pathExists(outputFile)) {
+            size_t complete = 0;
+            counts[1] = findResumeStep(writeAdios, outputFile, complete);
+            counts[0] = complete;
+        }
+        MPI_Bcast(counts, 2, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+        bool appending = counts[0] > 0;
+        
+        // Before connecting, so a sender with --resume finds it once we have
+        if (rank == 0) {
+            writeResumeStep(contactFile, counts[1]);
+        }
         
         // If using connection string directly, write it to a temporary file
         if (useContactString && rank == 0) {
@@ -67,23 +781,77 @@ int main(int argc, char *argv[])
         }
         MPI_Barrier(MPI_COMM_WORLD); // Wait for file to be written
         
-        // Open engine for reading (contact file name can be specified)
-        adios2::Engine reader = ioRead.Open(contactFile, adios2::Mode::Read);
+        // Open engines for reading (contact file name can be specified), in
+        // the order the sender opens its stripes
+        std::vector<std::unique_ptr<InputStream>> inputs;
+        for (int k = 0; k < streams; ++k) {
+            inputs.emplace_back(new InputStream(MPI_COMM_WORLD, configFile, k, k > 0 ? inputs[0].get() : nullptr));
+        }
+        for (auto& input : inputs) input->select(selection);
+        if (monitorMode) inputs[0]->setParameters({{"AlwaysProvideLatestTimestep", "true"}});
+        TransportSelector transports(transportRequest, transportTimeout, MPI_COMM_WORLD,
+                                     inputs[0]->parameters());
+        for (int k = 0; k < streams; ++k) {
+            inputs[k]->open(stripeContact(contactFile, k, streams), transports);
+        }
         
         // Declare IO for writing received data to BP file
-        adios2::IO ioWrite = adios.DeclareIO("WriteIO");
-        ioWrite.SetEngine("BP5");
-        adios2::Engine writer = ioWrite.Open(outputFile, adios2::Mode::Write);
+        adios2::IO ioWrite = writeAdios.DeclareIO("WriteIO");
+        configureIO(ioWrite, "BP5", {});
+        if (bpAsync) {
+            ioWrite.SetParameter("AsyncWrite", "true");
+        }
+        if (!bpAggregators.empty()) {
+            ioWrite.SetParameter("NumAggregators", bpAggregators);
+        }
+        adios2::Engine writer = ioWrite.Open(outputFile, appending ? adios2::Mode::Append : adios2::Mode::Write);
         
         if (rank == 0) {
             std::cout << "=== ADIOS2 Data Receiver (Clemson) ===" << std::endl;
+            if (!readerName.empty()) {
+                std::cout << "Reader: " << readerName << std::endl;
+            }
+            if (monitorMode) {
+                std::cout << "Monitoring: always the latest step, stale ones are skipped" << std::endl;
+            }
             if (useContactString) {
                 std::cout << "Using SST connection string from command line" << std::endl;
             } else {
-                std::cout << "Contact file: " << contactFile << ".sst" << std::endl;
+                std::cout << "Contact file: " << stripeContact(contactFile, 0, streams) << ".sst";
+                if (streams > 1) std::cout << " (" << streams << " streams)";
+                std::cout << std::endl;
             }
             std::cout << "Output file: " << outputFile << std::endl;
+            if (appending) {
+                std::cout << "Appending after " << counts[0] << " complete steps; the sender resumes at input step "
+                          << counts[1] << " (sender_from_bp --resume, or --start-step=" << counts[1] << ")"
+                          << std::endl;
+            } else if (appendOutput) {
+                std::cout << "Appending: no steps in " << outputFile << " yet, starting a new output" << std::endl;
+            }
+            if (!configFile.empty()) {
+                std::cout << "Config file: " << configFile << std::endl;
+            }
+            if (widen) {
+                std::cout << "Widening float32/fixed16 fields to double" << std::endl;
+            }
+            std::cout << "BP5 output: " << (pipelineDepth > 0 ? "pipelined (" + std::to_string(pipelineDepth) + " steps)" : "lockstep")
+                      << (bpAsync ? ", async write" : "")
+                      << (bpAggregators.empty() ? "" : ", " + bpAggregators + " aggregators") << std::endl;
+            std::cout << "SST transport: " << transports.report() << std::endl;
             std::cout << "MPI Ranks: " << size << std::endl;
+            std::cout << bufferBanner() << std::endl;
+            std::cout << "Read decomposition: "
+                      << (selection.subset.active() ? "slab (subset)" : decompositionName(decomposition)) << std::endl;
+            if (!selection.arrays.empty()) std::cout << "Arrays: " << varsOption << std::endl;
+            if (selection.subset.active()) {
+                std::cout << "Subset: region " << (roiOption.empty() ? "all" : roiOption)
+                          << ", stride " << selection.subset.stride << std::endl;
+            }
+            if (stepInterval > 1) std::cout << "Step interval: every " << stepInterval << " steps" << std::endl;
+            if (!traceFile.empty()) {
+                std::cout << "Tracing: " << traceFile << " (" << traceEvents << " events per thread)" << std::endl;
+            }
             std::cout << "Waiting for data from sender..." << std::endl;
             std::cout << std::string(60, '=') << std::endl;
         }
@@ -92,173 +860,245 @@ int main(int argc, char *argv[])
         std::vector<double> stepTimes;
         std::vector<double> stepSizes;
         std::vector<double> stepThroughputs;
+        std::vector<std::vector<double>> streamTimes, streamSizes;   // [step][stream]
+        std::vector<double> stepLatencies, stepOffsets;   // NaN for steps without a timestamp
+        std::vector<size_t> writerSteps;   // Sender step of each received step (fan-out may skip some)
+        
+        // Gaps in the sender's `step` counter (steps it output every
+        // `stepStride` apart) and the frame times on both clocks
+        std::vector<long long> stepValues;
+        std::vector<double> frameSent, frameArrived;
+        long long stepStride = 0;
+        std::string metricsPrefix = readerName.empty() ? "" : readerName + "_";
+        
+        // Sender clock offset for the end-to-end latency (rank 0 only), and
+        // this rank's offset to rank 0, so every rank's arrival time is on
+        // rank 0's clock before the max over ranks is taken
+        ClockSync clock;
+        std::string clockServer;
+        double rankOffset = rankClockOffset(MPI_COMM_WORLD);
+        double rankSkew = 0.0, absOffset = std::fabs(rankOffset);
+        MPI_Reduce(&absOffset, &rankSkew, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0 && size > 1) {
+            std::cout << "Clock: receiver ranks within " << std::scientific << std::setprecision(3) << rankSkew
+                      << " s of rank 0" << std::endl;
+        }
         
         auto overallStart = std::chrono::high_resolution_clock::now();
         size_t stepCount = 0;
+        StepMetrics metrics(MPI_COMM_WORLD, 3 + 2 * streams, metricsInterval);
+        double receiveTime = 0.0;   // This rank's time in received steps
         
-        // Track defined output variables to avoid redefining
-        std::map<std::string, adios2::Variable<double>> definedDoubleVars;
-        std::map<std::string, adios2::Variable<int32_t>> definedInt32Vars;
+        // Every stream's relays have a buffer slot per queue entry
+        size_t relaySlots = std::max(1, pipelineDepth);
+        
+        StepWriter stepWriter(ioWrite, writer, rank);
+        ReceivedStep lockstepBuffers;   // Reused every step when not pipelined
+        std::unique_ptr<Tracer> tracer = startTracing(
+            traceFile, readerName.empty() ? "receiver" : "receiver " + readerName, 100000, traceEvents);
+        std::unique_ptr<PipelinedWriter> pipeline;
+        if (pipelineDepth > 0) {
+            pipeline.reset(new PipelinedWriter(stepWriter, pipelineDepth));
+        }
         
         // Receive data for all available steps
         while (true) {
-            auto stepStatus = reader.BeginStep();
+            // Wait for a free step buffer before taking the next SST step,
+            // so backpressure only reaches the sender when the queue is full
+            ReceivedStep& received = pipeline ? pipeline->acquire() : lockstepBuffers;
             
-            if (stepStatus != adios2::StepStatus::OK) {
-                break;  // No more steps available
+            // Read this step from every stream; only stream 0 carries scalars
+            auto readInput = [&](int k) {
+                if (k > 0 && parallelStreams && activeTracer()) traceThread("stream " + std::to_string(k));
+                inputs[k]->read(relaySlots, received.slot, widen, decomposition, k == 0, rank, size);
+            };
+            if (parallelStreams) {
+                std::vector<std::thread> readers;
+                for (int k = 1; k < streams; ++k) readers.emplace_back(readInput, k);
+                readInput(0);
+                for (auto& t : readers) t.join();
+            } else {
+                for (int k = 0; k < streams; ++k) readInput(k);
             }
             
-            auto stepStart = std::chrono::high_resolution_clock::now();
-            
-            // Begin writing step
-            writer.BeginStep();
+            bool endOfStream = false;
+            for (auto& input : inputs) {
+                input->rethrow();
+                endOfStream = endOfStream || !input->ok();
+            }
+            if (endOfStream) {
+                break;  // No more steps available
+            }
             
+            // Reassemble the step from the same step of every stream
+            received.index = stepCount;
+            received.relays.clear();
+            auto stepStart = inputs[0]->begun();
+            std::vector<double> localStream(2 * streams);   // MB, then seconds
             double stepSizeMB = 0.0;
-            
-            // Get all available variables
-            auto variables = ioRead.AvailableVariables();
-            
-            if (rank == 0 && stepCount == 0) {
-                std::cout << "Found " << variables.size() << " variables to receive" << std::endl;
+            double receivedAt = 0.0;   // When the last stream's EndStep returned
+            for (int k = 0; k < streams; ++k) {
+                const InputStream& input = *inputs[k];
+                if (input.index() != inputs[0]->index()) {
+                    throw std::runtime_error("stream " + std::to_string(k) + " delivered step " +
+                                             std::to_string(input.index()) + " instead of " +
+                                             std::to_string(inputs[0]->index()));
+                }
+                received.relays.insert(received.relays.end(), input.relays().begin(), input.relays().end());
+                stepStart = std::min(stepStart, input.begun());
+                stepSizeMB += input.sizeMB();
+                localStream[k] = input.sizeMB();
+                localStream[streams + k] = input.time();
+                receivedAt = std::max(receivedAt, input.receivedAt());
             }
             
-            // Process each variable
-            for (const auto& varPair : variables) {
-                const std::string& varName = varPair.first;
-                const auto& varInfo = varPair.second;
-                
-                auto typeIt = varInfo.find("Type");
-                if (typeIt == varInfo.end()) continue;
-                const std::string& varType = typeIt->second;
+            if (rank == 0 && stepCount == 0) {
+                std::cout << "Found " << inputs[0]->variableCount() << " variables to receive" << std::endl;
                 
-                // Handle double variables
-                if (varType == "double") {
-                    auto varIn = ioRead.InquireVariable<double>(varName);
-                    if (!varIn) continue;
-                    auto shape = varIn.Shape();
-                    if (shape.empty()) continue; // Skip scalars
-                    
-                    size_t totalSize = 1;
-                    for (auto dim : shape) totalSize *= dim;
-                    
-                    if (shape.size() >= 1) {
-                        size_t dim0 = shape[0];
-                        size_t elementsPerSlice = totalSize / dim0;
-                        size_t slicesPerRank = dim0 / size;
-                        size_t remainder = dim0 % size;
-                        size_t sliceStart = rank * slicesPerRank + std::min(static_cast<size_t>(rank), remainder);
-                        size_t sliceCount = slicesPerRank + (rank < remainder ? 1 : 0);
-                        
-                        if (sliceCount > 0) {
-                            size_t localSize = sliceCount * elementsPerSlice;
-                            adios2::Dims start(shape.size(), 0);
-                            adios2::Dims count = shape;
-                            start[0] = sliceStart;
-                            count[0] = sliceCount;
-                            
-                            varIn.SetSelection({start, count});
-                            std::vector<double> data(localSize);
-                            reader.Get(varIn, data.data(), adios2::Mode::Sync);
-                            
-                            if (stepCount == 0) {
-                                definedDoubleVars[varName] = ioWrite.DefineVariable<double>(
-                                    varName, shape, start, count
-                                );
-                            }
-                            writer.Put(definedDoubleVars[varName], data.data(), adios2::Mode::Sync);
-                            stepSizeMB += (localSize * sizeof(double)) / (1024.0 * 1024.0);
-                        }
-                    }
-                }
-                // Handle int32_t variables
-                else if (varType == "int32_t") {
-                    auto varIn = ioRead.InquireVariable<int32_t>(varName);
-                    if (!varIn) continue;
-                    
-                    auto shape = varIn.Shape();
-                    if (shape.empty() || (shape.size() == 1 && shape[0] == 1)) {
-                        if (rank == 0) {
-                            int32_t value;
-                            reader.Get(varIn, &value, adios2::Mode::Sync);
-                            if (stepCount == 0) {
-                                definedInt32Vars[varName] = ioWrite.DefineVariable<int32_t>(varName);
-                            }
-                            writer.Put(definedInt32Vars[varName], value, adios2::Mode::Sync);
-                        }
-                    } else {
-                        size_t totalSize = 1;
-                        for (auto dim : shape) totalSize *= dim;
-                        
-                        // Distribute along first dimension
-                        size_t dim0 = shape[0];
-                        size_t elementsPerSlice = totalSize / dim0;
-                        size_t slicesPerRank = dim0 / size;
-                        size_t remainder = dim0 % size;
-                        size_t sliceStart = rank * slicesPerRank + std::min(static_cast<size_t>(rank), remainder);
-                        size_t sliceCount = slicesPerRank + (rank < remainder ? 1 : 0);
-                        
-                        if (sliceCount > 0) {
-                            size_t localSize = sliceCount * elementsPerSlice;
-                            
-                            adios2::Dims start(shape.size(), 0);
-                            adios2::Dims count = shape;
-                            start[0] = sliceStart;
-                            count[0] = sliceCount;
-                            
-                            varIn.SetSelection({start, count});
-                            std::vector<int32_t> data(localSize);
-                            reader.Get(varIn, data.data(), adios2::Mode::Sync);
-                            
-                            if (stepCount == 0) {
-                                definedInt32Vars[varName] = ioWrite.DefineVariable<int32_t>(
-                                    varName, shape, start, count
-                                );
-                            }
-                            writer.Put(definedInt32Vars[varName], data.data(), adios2::Mode::Sync);
-                            stepSizeMB += (localSize * sizeof(int32_t)) / (1024.0 * 1024.0);
-                        }
-                    }
+                // The sender advertises its time server with the first step
+                clockServer = inputs[0]->attribute("clock_server");
+                if (clockServer.empty()) {
+                    std::cout << "Clock: no clock_server attribute, latency is not skew-corrected" << std::endl;
+                } else if (!clock.connect(clockServer) || !clock.sync()) {
+                    std::cerr << "Warning: cannot reach clock server " << clockServer
+                              << ", latency is not skew-corrected" << std::endl;
+                } else {
+                    std::cout << "Clock: " << clockServer << " offset " << std::scientific << std::setprecision(3)
+                              << clock.offset() << " s (RTT " << clock.rtt() << " s)" << std::endl;
                 }
+            } else if (rank == 0 && clockSyncInterval > 0 && stepCount % clockSyncInterval == 0 &&
+                       clock.connected() && !clock.sync()) {
+                std::cerr << "Warning: clock server " << clockServer << " went away, keeping offset "
+                          << clock.offset() << " s" << std::endl;
             }
             
-            // Sum up total step size across ranks
-            double globalStepSizeMB = 0.0;
-            MPI_Reduce(&stepSizeMB, &globalStepSizeMB, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-            
-            reader.EndStep();
-            writer.EndStep();
+            if (pipeline) {
+                pipeline->submit();
+            } else {
+                stepWriter.write(received);
+            }
             
             auto stepEnd = std::chrono::high_resolution_clock::now();
             auto stepDuration = std::chrono::duration<double>(stepEnd - stepStart).count();
             
-            if (rank == 0) {
-                double throughputMBps = globalStepSizeMB / stepDuration;
+            // This rank's size, time and arrival, then per-stream MB and
+            // seconds, reduced in batches. The step has arrived once every
+            // rank has it, so latency and time come from the slowest rank.
+            std::vector<double> values = {stepSizeMB, stepDuration, receivedAt + rankOffset};
+            values.insert(values.end(), localStream.begin(), localStream.end());
+            const InputStream& first = *inputs[0];
+            bool hasTimestamp = first.hasTimestamp(), hasStepValue = first.hasStepValue();
+            double timestamp = hasTimestamp ? first.timestamp() : 0.0, offset = clock.offset();
+            long long value = hasStepValue ? first.stepValue() : 0;
+            size_t writerStep = first.index();
+            metrics.record(values, [&, stepCount, hasTimestamp, hasStepValue, timestamp, offset, value, writerStep]
+                                   (const StepMetrics::Reduced& global) {
+                double globalStepSizeMB = global.sum[0], time = global.max[1], globalReceivedAt = global.max[2];
+                double throughputMBps = globalStepSizeMB / time;
                 
                 std::cout << "Step " << std::setw(3) << stepCount 
-                          << " | Time: " << std::fixed << std::setprecision(3) << std::setw(8) << stepDuration << " s"
+                          << " | Time: " << std::fixed << std::setprecision(3) << std::setw(8) << time << " s"
                           << " | Size: " << std::setw(8) << std::setprecision(2) << globalStepSizeMB << " MB"
-                          << " | Throughput: " << std::setw(8) << std::setprecision(2) << throughputMBps << " MB/s"
-                          << std::endl;
+                          << " | Throughput: " << std::setw(8) << std::setprecision(2) << throughputMBps << " MB/s";
+                double latency = std::nan("");
+                if (hasTimestamp) {
+                    latency = globalReceivedAt + offset - timestamp;   // On the sender's clock
+                    std::cout << " | Latency: " << std::setprecision(2) << latency * 1000.0 << " ms";
+                }
+                if (writerStep != stepCount) {
+                    std::cout << " | Writer step: " << writerStep;   // Shared with other readers
+                }
+                if (hasStepValue) {
+                    long long diff = stepValues.empty() ? 0 : value - stepValues.back();
+                    if (diff > 0 && (stepStride == 0 || diff < stepStride)) stepStride = diff;
+                    if (diff > stepStride && stepStride > 0) {
+                        size_t skipped = static_cast<size_t>(diff / stepStride - 1);
+                        std::cout << " | Skipped: " << skipped;
+                    }
+                    stepValues.push_back(value);
+                    if (hasTimestamp) {
+                        frameSent.push_back(timestamp);
+                        frameArrived.push_back(globalReceivedAt);
+                    }
+                }
+                stepLatencies.push_back(latency);
+                stepOffsets.push_back(offset);
+                writerSteps.push_back(writerStep);
+                if (streams > 1) {
+                    // Bytes summed, time of the slowest rank
+                    std::vector<double> sizes(global.sum.begin() + 3, global.sum.begin() + 3 + streams);
+                    std::vector<double> times(global.max.begin() + 3 + streams, global.max.end());
+                    std::cout << " | Streams (MB/s):";
+                    for (int k = 0; k < streams; ++k) {
+                        std::cout << " " << std::setprecision(1) << (times[k] > 0.0 ? sizes[k] / times[k] : 0.0);
+                    }
+                    streamSizes.push_back(sizes);
+                    streamTimes.push_back(times);
+                }
+                std::cout << " | Imbalance: " << std::setprecision(2) << global.imbalance(1) << std::endl;
                 
-                stepTimes.push_back(stepDuration);
+                stepTimes.push_back(time);
                 stepSizes.push_back(globalStepSizeMB);
                 stepThroughputs.push_back(throughputMBps);
-            }
+            });
+            receiveTime += stepDuration;
             
             stepCount++;
         }
         
-        reader.Close();
+        metrics.flush();
+        for (auto& input : inputs) input->close();
+        
+        // Drain queued steps before closing the BP5 output
+        double stallTime = 0.0;
+        size_t maxQueued = 0;
+        if (pipeline) {
+            pipeline->finish();
+            stallTime = pipeline->getStallTime();
+            maxQueued = pipeline->getMaxQueued();
+            pipeline.reset();
+        }
         writer.Close();
         
         auto overallEnd = std::chrono::high_resolution_clock::now();
         auto totalDuration = std::chrono::duration<double>(overallEnd - overallStart).count();
         
+        // Slowest rank's disk time and SST stalls
+        double localTimes[2] = {stepWriter.getWriteTime(), stallTime};
+        double maxTimes[2] = {0.0, 0.0};
+        MPI_Reduce(localTimes, maxTimes, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        std::string receiveSpread = rankSpread("Step time per rank", receiveTime, " s", MPI_COMM_WORLD);
+        std::string traceSummary;
+        if (tracer) {
+            // Onto the sender's clock with the last offset rank 0 measured
+            double traceOffset = clock.offset();
+            MPI_Bcast(&traceOffset, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+            tracer->setClockOffset(traceOffset + rankOffset);
+            traceSummary = finishTracing(tracer, MPI_COMM_WORLD);
+        }
+        std::string bufferWarning = bufferSummary(MPI_COMM_WORLD);
+        
         if (rank == 0) {
             std::cout << std::string(60, '=') << std::endl;
             std::cout << "=== Reception Complete ===" << std::endl;
-            std::cout << "Total steps received: " << stepCount << std::endl;
+            std::cout << "Total steps received: " << stepCount;
+            if (stepInterval > 1) std::cout << " (" << inputs[0]->skipped() << " stepped over by --step-interval)";
+            std::cout << std::endl;
             std::cout << "Total time: " << std::fixed << std::setprecision(3) << totalDuration << " seconds" << std::endl;
+            std::cout << "SST transport: " << transports.usedName() << std::endl;
+            std::cout << "BP5 write time: " << maxTimes[0] << " s";
+            if (pipelineDepth > 0) {
+                std::cout << " | SST stalled on full queue: " << maxTimes[1] << " s"
+                          << " | Max queued: " << maxQueued << "/" << pipelineDepth;
+            }
+            std::cout << std::endl;
+            if (!traceSummary.empty()) std::cout << traceSummary << std::endl;
+            if (!bufferWarning.empty()) std::cerr << bufferWarning << std::endl;
+            
+            std::vector<double> latencies;
+            for (double latency : stepLatencies) {
+                if (!std::isnan(latency)) latencies.push_back(latency);
+            }
             
             if (!stepTimes.empty()) {
                 // Calculate statistics
@@ -284,19 +1124,79 @@ int main(int argc, char *argv[])
                 std::cout << "Average throughput: " << std::setprecision(2) << avgThroughputMBps * 8.0 << " Mbps" << std::endl;
                 std::cout << "Min/Max step throughput: " << minThroughput << " / " << maxThroughput << " MB/s" << std::endl;
                 std::cout << "Min/Max step time: " << std::setprecision(3) << minTime << " / " << maxTime << " s" << std::endl;
+                std::cout << receiveSpread << std::endl;
+                
+                // Out of the writer steps this reader could have seen (others
+                // went to other readers, or came before it joined)
+                size_t writerSpan = writerSteps.back() - writerSteps.front() + 1;
+                std::cout << "Writer steps received: " << writerSteps.size() << " of " << writerSpan
+                          << " (" << writerSteps.front() << ".." << writerSteps.back() << ", "
+                          << std::setprecision(1) << 100.0 * writerSteps.size() / writerSpan << "%)" << std::endl;
+                
+                // Skipped sender steps (gaps in `step`) and frame rates: produced on
+                // the sender's clock, delivered on this one
+                if (stepValues.size() > 1 && stepStride > 0) {
+                    size_t skippedSteps = 0;
+                    for (size_t i = 1; i < stepValues.size(); ++i) {
+                        long long diff = stepValues[i] - stepValues[i - 1];
+                        if (diff > stepStride) skippedSteps += static_cast<size_t>(diff / stepStride - 1);
+                    }
+                    std::cout << "Sender steps: " << stepValues.size() << " received, " << skippedSteps
+                              << " skipped (step stride " << stepStride << ")" << std::endl;
+                }
+                if (frameSent.size() > 1 && stepStride > 0) {
+                    double produced = (stepValues.back() - stepValues.front()) / static_cast<double>(stepStride) /
+                                      (frameSent.back() - frameSent.front());
+                    double delivered = (frameArrived.size() - 1) / (frameArrived.back() - frameArrived.front());
+                    std::cout << "Frame rate: produced " << std::setprecision(2) << produced
+                              << " /s | delivered " << delivered << " /s" << std::endl;
+                }
+                if (!latencies.empty()) {
+                    std::cout << "End-to-end latency p50/p95/p99: " << std::setprecision(2)
+                              << percentile(latencies, 50.0) * 1000.0 << " / "
+                              << percentile(latencies, 95.0) * 1000.0 << " / "
+                              << percentile(latencies, 99.0) * 1000.0 << " ms";
+                    if (clock.syncs() > 0) {
+                        std::cout << " (clock offset " << std::scientific << std::setprecision(3) << clock.offset()
+                                  << " s, RTT " << clock.rtt() << " s, " << clock.syncs() << " syncs)"
+                                  << std::fixed;
+                    } else {
+                        std::cout << " (uncorrected for clock skew)";
+                    }
+                    std::cout << std::endl;
+                }
                 
                 // Save detailed metrics to file
-                std::ofstream metricsFile("transfer_metrics.csv");
-                metricsFile << "Step,Time(s),Size(MB),Throughput(MB/s),Throughput(Mbps)\n";
+                std::ofstream metricsFile(metricsPrefix + "transfer_metrics.csv");
+                metricsFile << "Step,Time(s),Size(MB),Throughput(MB/s),Throughput(Mbps),Latency(s),Clock offset(s),"
+                            << "Writer step\n";
                 for (size_t i = 0; i < stepTimes.size(); ++i) {
                     metricsFile << i << "," 
                                << std::fixed << std::setprecision(6) << stepTimes[i] << ","
                                << std::setprecision(2) << stepSizes[i] << ","
                                << std::setprecision(2) << stepThroughputs[i] << ","
-                               << std::setprecision(2) << stepThroughputs[i] * 8.0 << "\n";
+                               << std::setprecision(2) << stepThroughputs[i] * 8.0 << ","
+                               << std::setprecision(6);
+                    if (!std::isnan(stepLatencies[i])) metricsFile << stepLatencies[i];
+                    metricsFile << "," << stepOffsets[i] << "," << writerSteps[i] << "\n";
                 }
                 metricsFile.close();
-                std::cout << "\nDetailed metrics saved to: transfer_metrics.csv" << std::endl;
+                std::cout << "\nDetailed metrics saved to: " << metricsPrefix << "transfer_metrics.csv" << std::endl;
+                
+                if (streams > 1) {
+                    std::ofstream streamFile(metricsPrefix + "stream_metrics.csv");
+                    streamFile << "Step,Stream,Time(s),Size(MB),Throughput(MB/s)\n";
+                    for (size_t i = 0; i < streamTimes.size(); ++i) {
+                        for (int k = 0; k < streams; ++k) {
+                            double t = streamTimes[i][k];
+                            streamFile << i << "," << k << ","
+                                       << std::fixed << std::setprecision(6) << t << ","
+                                       << std::setprecision(2) << streamSizes[i][k] << ","
+                                       << std::setprecision(2) << (t > 0.0 ? streamSizes[i][k] / t : 0.0) << "\n";
+                        }
+                    }
+                    std::cout << "Per-stream metrics saved to: " << metricsPrefix << "stream_metrics.csv" << std::endl;
+                }
                 std::cout << "Received data saved to: " << outputFile << std::endl;
             }
         }
@@ -306,6 +1206,7 @@ int main(int argc, char *argv[])
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
     
+    MPI_Comm_free(&writeComm);
     MPI_Finalize();
     return 0;
 }
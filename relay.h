@@ -0,0 +1,381 @@
+/*
+ * Type-generic variable relay shared by receiver and sender_from_bp
+ *
+ * A VariableRelay moves one variable from an input engine to an output
+ * engine: a deferred Get of this rank's block into a persistent buffer,
+ * then a deferred Put to an output variable defined on first use. The
+ * element type is resolved once per variable from its ADIOS2 type string
+ * (makeRelay) and the typed input/output handles are cached, so scalars and
+ * arrays of every ADIOS2 type go through the same code.
+ *
+ * Arrays are split across ranks either along their first dimension (slab,
+ * the default) or by whole writer blocks from Engine::BlocksInfo (blocks),
+ * which keeps every read inside one writer block and re-Puts the blocks as
+ * they were written. Scalars are read on every rank and written by rank 0.
+ * Each relay holds `slots` independent buffers so several steps can be in
+ * flight at once.
+ *
+ * A Subset narrows what is requested from the writers: a region of interest
+ * per dimension and a decimation stride. Dimension 0 is decimated by asking
+ * for single planes, so only every stride-th plane crosses the network; the
+ * other dimensions are thinned in place once the planes have arrived. The
+ * output variable gets the reduced shape, split into slabs across ranks.
+ */
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <adios2.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "buffers.h"
+#include "compression.h"
+
+enum class Decomposition { Slab, Blocks };
+
+inline Decomposition parseDecomposition(const std::string& text)
+{
+    if (text == "slab") return Decomposition::Slab;
+    if (text == "blocks") return Decomposition::Blocks;
+    throw std::invalid_argument("unknown read decomposition '" + text + "' (use slab or blocks)");
+}
+
+inline const char* decompositionName(Decomposition decomposition)
+{
+    return decomposition == Decomposition::Blocks ? "blocks" : "slab";
+}
+
+inline size_t blockElements(const adios2::Dims& count)
+{
+    size_t elements = 1;
+    for (auto c : count) elements *= c;
+    return elements;
+}
+
+// This rank's slab of a global array, split along the first dimension.
+// Returns false (and a zero count) if the rank gets no slices.
+inline bool slabSelection(const adios2::Dims& shape, int rank, int size,
+                          adios2::Dims& start, adios2::Dims& count)
+{
+    size_t dim0 = shape[0];
+    size_t slicesPerRank = dim0 / size;
+    size_t remainder = dim0 % size;
+    size_t sliceStart = rank * slicesPerRank + std::min(static_cast<size_t>(rank), remainder);
+    size_t sliceCount = slicesPerRank + (static_cast<size_t>(rank) < remainder ? 1 : 0);
+
+    start.assign(shape.size(), 0);
+    count = shape;
+    start[0] = sliceStart;
+    count[0] = sliceCount;
+    return sliceCount > 0;
+}
+
+// Indices of the blocks (sizes in bytes, in writer order) this rank reads.
+// Blocks are cut into `size` contiguous runs of about equal bytes: a block
+// goes to the rank whose share its midpoint falls in, so neighbouring
+// writer blocks stay together and no rank is off by more than one block.
+inline std::vector<size_t> blockAssignment(const std::vector<size_t>& blockBytes, int rank, int size)
+{
+    double total = 0.0;
+    for (size_t bytes : blockBytes) total += bytes;
+
+    std::vector<size_t> mine;
+    double before = 0.0;
+    for (size_t i = 0; i < blockBytes.size(); ++i) {
+        double mid = before + 0.5 * blockBytes[i];
+        int owner = total > 0.0 ? static_cast<int>(mid / total * size) : 0;
+        if (std::min(owner, size - 1) == rank) mine.push_back(i);
+        before += blockBytes[i];
+    }
+    return mine;
+}
+
+// Region of interest and decimation applied to every array
+struct Subset {
+    std::vector<std::pair<size_t, size_t>> region;   // (start, count) per leading dimension, count 0 = to the end
+    size_t stride = 1;
+    
+    bool active() const { return !region.empty() || stride > 1; }
+};
+
+// "START:COUNT,START:COUNT,..." (COUNT empty = to the end, "" or ":" = the
+// whole dimension); dimensions left out stay whole
+inline Subset parseSubset(const std::string& roi, size_t stride)
+{
+    Subset subset;
+    subset.stride = std::max<size_t>(1, stride);
+    std::stringstream in(roi);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t colon = item.find(':');
+        std::string start = item.substr(0, colon);
+        std::string count = colon == std::string::npos ? "" : item.substr(colon + 1);
+        try {
+            subset.region.emplace_back(start.empty() ? 0 : std::stoull(start), count.empty() ? 0 : std::stoull(count));
+        } catch (const std::exception&) {
+            throw std::invalid_argument("invalid region '" + item + "' (use START:COUNT per dimension)");
+        }
+    }
+    return subset;
+}
+
+// Per-step output options
+struct RelayContext {
+    int rank = 0;
+    CompressionPipeline* compression = nullptr;  // Operators attached at definition
+    bool probe = false;                          // Measure compression this step
+    double probeTime = 0.0;                      // Accumulated probe time
+    size_t bytes = 0;                            // Array bytes Put by this rank
+};
+
+class VariableRelay {
+public:
+    VariableRelay(const std::string& name, const std::string& type)
+        : name_(name), type_(type) {}
+    virtual ~VariableRelay() {}
+
+    const std::string& name() const { return name_; }
+    const std::string& type() const { return type_; }
+
+    void setDecomposition(Decomposition decomposition) { decomposition_ = decomposition; }
+    
+    // Arrays are read as this subset, in slabs (the decomposition is ignored)
+    void setSubset(const Subset& subset) { subset_ = subset; }
+
+    // Post a deferred Get into buffer `slot`. Returns the bytes requested by
+    // this rank (0 for scalars).
+    virtual size_t get(adios2::IO& io, adios2::Engine& reader, size_t slot, int rank, int size) = 0;
+
+    // Deferred Put of buffer `slot`; its data must stay untouched until the
+    // writer's EndStep. Called on every rank, even without data.
+    virtual void put(adios2::IO& io, adios2::Engine& writer, size_t slot, RelayContext& ctx) = 0;
+
+    // Called once PerformGets has filled buffer `slot`
+    virtual void received(size_t slot) { (void)slot; }
+    
+    virtual bool pending(size_t slot) const = 0;
+
+protected:
+    std::string name_;
+    std::string type_;
+    Decomposition decomposition_ = Decomposition::Slab;
+    Subset subset_;
+};
+
+template <class T>
+class TypedRelay : public VariableRelay {
+public:
+    TypedRelay(const std::string& name, size_t slots)
+        : VariableRelay(name, adios2::GetType<T>()), buffers_(slots) {}
+
+    size_t get(adios2::IO& io, adios2::Engine& reader, size_t slot, int rank, int size) override {
+        Buffer& b = buffers_[slot];
+        b.pending = false;
+        b.blocks.clear();
+        if (!in_) in_ = io.InquireVariable<T>(name_);
+        if (!in_) return 0;
+
+        b.shape = in_.Shape();
+        b.thin = false;
+        if (b.shape.empty()) {
+            reader.Get(in_, b.value, adios2::Mode::Deferred);
+            b.pending = true;
+            return 0;
+        }
+        if (subset_.active()) return getSubset(reader, b, rank, size);
+
+        if (decomposition_ == Decomposition::Blocks) {
+            auto infos = reader.BlocksInfo(in_, reader.CurrentStep());
+            std::vector<size_t> blockBytes;
+            blockBytes.reserve(infos.size());
+            for (const auto& info : infos) blockBytes.push_back(blockElements(info.Count) * sizeof(T));
+            for (size_t i : blockAssignment(blockBytes, rank, size)) {
+                b.blocks.push_back(Block{infos[i].Start, infos[i].Count, 0});
+            }
+        } else {
+            Block slab{adios2::Dims(), adios2::Dims(), 0};
+            if (slabSelection(b.shape, rank, size, slab.start, slab.count)) b.blocks.push_back(slab);
+        }
+        if (b.blocks.empty()) return 0;
+
+        size_t elements = 0;
+        for (Block& block : b.blocks) {
+            block.offset = elements;
+            elements += blockElements(block.count);
+        }
+        if (b.data.size() != elements) b.data.resize(elements);
+
+        for (const Block& block : b.blocks) {
+            in_.SetSelection({block.start, block.count});
+            reader.Get(in_, b.data.data() + block.offset, adios2::Mode::Deferred);
+        }
+        b.pending = true;
+        return elements * sizeof(T);
+    }
+
+    void put(adios2::IO& io, adios2::Engine& writer, size_t slot, RelayContext& ctx) override {
+        Buffer& b = buffers_[slot];
+        if (!b.pending) return;
+
+        adios2::Variable<T>& out = output(io, b, ctx);
+        if (b.shape.empty()) {
+            if (ctx.rank == 0) writer.Put(out, b.value);
+            return;
+        }
+        if (ctx.compression) {
+            if (ctx.probe) {
+                // The first block stands in for the rest
+                auto start = std::chrono::high_resolution_clock::now();
+                ctx.compression->probe(name_, b.data.data(), b.blocks.front().count);
+                ctx.probeTime += std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+            }
+            ctx.compression->record<T>(name_, b.data.size());
+        }
+        for (const Block& block : b.blocks) {
+            out.SetSelection({block.start, block.count});
+            writer.Put(out, b.data.data() + block.offset);
+        }
+        ctx.bytes += b.data.size() * sizeof(T);
+    }
+
+    void received(size_t slot) override {
+        Buffer& b = buffers_[slot];
+        if (b.pending && b.thin) thin(b);
+    }
+    
+    bool pending(size_t slot) const override { return buffers_[slot].pending; }
+
+protected:
+    // One piece of the global array, stored at data[offset]
+    struct Block {
+        adios2::Dims start, count;
+        size_t offset;
+    };
+
+    struct Buffer {
+        AlignedVector<T> data;     // This rank's blocks back to back, reused across steps
+        T value = T();             // Scalar value
+        adios2::Dims shape;        // Output shape (the subset's when one is set)
+        std::vector<Block> blocks;
+        bool pending = false;      // Received in the current step
+        adios2::Dims region;       // Subset: requested extent of each plane's dimensions
+        bool thin = false;         // Subset: dimensions 1.. still to be decimated
+    };
+    
+    // Subset read: this rank's slab of the reduced array. data holds whole
+    // region rows of each kept plane until received() thins them.
+    size_t getSubset(adios2::Engine& reader, Buffer& b, int rank, int size) {
+        size_t nd = b.shape.size(), stride = subset_.stride;
+        adios2::Dims start(nd, 0), outShape(nd);
+        b.region = b.shape;
+        for (size_t d = 0; d < nd; ++d) {
+            if (d < subset_.region.size()) {
+                start[d] = std::min(subset_.region[d].first, b.shape[d]);
+                size_t rest = b.shape[d] - start[d];
+                b.region[d] = subset_.region[d].second == 0 ? rest : std::min(subset_.region[d].second, rest);
+            }
+            outShape[d] = (b.region[d] + stride - 1) / stride;
+        }
+        b.shape = outShape;
+        
+        Block slab{adios2::Dims(), adios2::Dims(), 0};
+        if (blockElements(outShape) == 0 || !slabSelection(outShape, rank, size, slab.start, slab.count)) return 0;
+        b.blocks.push_back(slab);
+        
+        size_t planeElements = blockElements(b.region) / b.region[0];
+        size_t planes = slab.count[0];
+        b.data.resize(planes * planeElements);
+        
+        adios2::Dims count = b.region;
+        if (stride == 1) {
+            start[0] += slab.start[0];
+            count[0] = planes;
+            in_.SetSelection({start, count});
+            reader.Get(in_, b.data.data(), adios2::Mode::Deferred);
+        } else {
+            size_t first = start[0];
+            count[0] = 1;
+            for (size_t p = 0; p < planes; ++p) {
+                start[0] = first + (slab.start[0] + p) * stride;
+                in_.SetSelection({start, count});
+                reader.Get(in_, b.data.data() + p * planeElements, adios2::Mode::Deferred);
+            }
+        }
+        b.thin = stride > 1 && nd > 1;
+        b.pending = true;
+        return b.data.size() * sizeof(T);
+    }
+    
+    // Keep every stride-th element of dimensions 1.. of each plane, moving
+    // forward in place (no element lands behind its source)
+    void thin(Buffer& b) {
+        const adios2::Dims& out = b.blocks.front().count;
+        size_t nd = out.size(), stride = subset_.stride;
+        std::vector<size_t> pitch(nd, 1);   // Source elements per step in dimension d
+        for (size_t d = nd - 1; d > 0; --d) pitch[d - 1] = pitch[d] * b.region[d];
+        
+        size_t dst = 0;
+        std::vector<size_t> index(nd, 0);   // Output index within a plane (dimension 0 unused)
+        for (size_t p = 0; p < out[0]; ++p) {
+            size_t planeStart = p * pitch[0];
+            while (true) {
+                size_t src = planeStart;
+                for (size_t d = 1; d < nd; ++d) src += index[d] * stride * pitch[d];
+                b.data[dst++] = b.data[src];
+                size_t d = nd - 1;
+                while (d > 0 && ++index[d] == out[d]) index[d--] = 0;
+                if (d == 0) break;
+            }
+        }
+        b.data.resize(dst);
+        b.thin = false;
+    }
+
+    // Output variable of the same type, defined on first use and reshaped
+    // when the global shape changes (Puts select their block). A relay of
+    // another input stream may already have defined it.
+    adios2::Variable<T>& output(adios2::IO& io, const Buffer& b, RelayContext& ctx) {
+        if (!out_) {
+            out_ = io.InquireVariable<T>(name_);
+            if (out_) outShape_ = out_.Shape();
+        }
+        if (!out_) {
+            out_ = b.shape.empty() ? io.DefineVariable<T>(name_)
+                                   : io.DefineVariable<T>(name_, b.shape, b.blocks.front().start,
+                                                          b.blocks.front().count);
+            if (ctx.compression) ctx.compression->attach(out_);
+            outShape_ = b.shape;
+        } else if (b.shape != outShape_) {
+            out_.SetShape(b.shape);
+            outShape_ = b.shape;
+        }
+        return out_;
+    }
+
+    adios2::Variable<T> in_;
+    adios2::Variable<T> out_;
+    adios2::Dims outShape_;   // Shape last applied to out_ (slots are put in turn)
+    std::vector<Buffer> buffers_;
+};
+
+// Relay for any ADIOS2 type string (AvailableVariables()["Type"]), or
+// nullptr for types ADIOS2 does not define
+inline std::unique_ptr<VariableRelay> makeRelay(const std::string& name, const std::string& type, size_t slots)
+{
+#define declare_type(T)                                                    \
+    if (type == adios2::GetType<T>()) {                                    \
+        return std::unique_ptr<VariableRelay>(new TypedRelay<T>(name, slots)); \
+    }
+    ADIOS2_FOREACH_STDTYPE_1ARG(declare_type)
+#undef declare_type
+    return nullptr;
+}
+
+#endif // RELAY_H
@@ -0,0 +1,75 @@
+/*
+ * Resuming an interrupted BP replay
+ *
+ *   sender_from_bp  --start-step=N   skip the first N steps of the input file
+ *                   --resume         take N from the receiver's <contact>.resume
+ *   receiver        --append         keep the existing output and add to it
+ *
+ * sender_from_bp Puts the input step it is sending as the `source_step`
+ * scalar, and the receiver stores it with everything else. With --append the
+ * receiver opens its existing output, counts the steps BP5 finished (a step
+ * cut off by a crash is not in the index and gets overwritten), and resumes
+ * after the `source_step` of the last one, or after as many steps as it
+ * holds if the output has no `source_step`. Every receiver writes that step
+ * into <contact>.resume before connecting (0 without --append), next to the
+ * contact file. A sender started with --resume reads it once the reader has
+ * connected and skips to it; without a shared directory, pass the step the
+ * receiver prints to --start-step instead.
+ */
+
+#ifndef RESUME_H
+#define RESUME_H
+
+#include <adios2.h>
+#include <mpi.h>
+#include <sys/stat.h>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+inline std::string resumeFile(const std::string& contact)
+{
+    return contact + ".resume";
+}
+
+inline void writeResumeStep(const std::string& contact, uint64_t step)
+{
+    std::ofstream out(resumeFile(contact));
+    out << step << std::endl;
+}
+
+// False if there is no (readable) resume file
+inline bool readResumeStep(const std::string& contact, uint64_t& step)
+{
+    std::ifstream in(resumeFile(contact));
+    return static_cast<bool>(in >> step);
+}
+
+inline bool pathExists(const std::string& path)
+{
+    struct stat info;
+    return ::stat(path.c_str(), &info) == 0;
+}
+
+// Complete steps of an existing BP output and the input step to resume at,
+// read on the calling rank alone
+inline uint64_t findResumeStep(adios2::ADIOS& adios, const std::string& path, size_t& complete)
+{
+    adios2::IO io = adios.DeclareIO("ResumeIO");
+    io.SetEngine("BP5");
+    adios2::Engine reader = io.Open(path, adios2::Mode::ReadRandomAccess, MPI_COMM_SELF);
+    complete = reader.Steps();
+    uint64_t resume = complete;
+    auto source = io.InquireVariable<uint64_t>("source_step");
+    if (source && complete > 0) {
+        uint64_t last = 0;
+        source.SetStepSelection({complete - 1, 1});
+        reader.Get(source, last, adios2::Mode::Sync);
+        resume = last + 1;
+    }
+    reader.Close();
+    adios.RemoveIO("ResumeIO");
+    return resume;
+}
+
+#endif // RESUME_H
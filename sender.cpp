@@ -4,12 +4,300 @@
  */
 
 #include <adios2.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <vector>
 #include <chrono>
 #include <numeric>
 #include <iomanip>
+#include <fstream>
 #include <mpi.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "aggregation.h"
+#include "autotune.h"
+#include "clock.h"
+#include "compression.h"
+#include "config.h"
+#include "fanout.h"
+#include "precision.h"
+#include "striping.h"
+#include "transport.h"
+
+// Match a "--name=value" command line option and extract its value
+static bool parseOption(const std::string& arg, const std::string& name, std::string& value)
+{
+    if (arg.compare(0, name.size(), name) != 0) return false;
+    value = arg.substr(name.size());
+    return true;
+}
+
+// --autotune: a short transfer per trial of the sweep, each on its own SST
+// stream, then the fastest trial is written to outputFile as an XML config
+static void runAutotune(const std::vector<TuneTrial>& trials, const std::string& sweep,
+                        const std::string& configFile, const std::string& contactFile,
+                        const std::string& outputFile, size_t arraySize, size_t steps,
+                        int transportTimeout, int rank, int size)
+{
+    const double stepMB = (size * arraySize * sizeof(double)) / (1024.0 * 1024.0);
+    if (rank == 0) {
+        std::cout << "=== ADIOS2 Sender Autotune ===" << std::endl;
+        std::cout << "Trials: " << trials.size() << " x " << steps << " steps of "
+                  << std::fixed << std::setprecision(2) << stepMB << " MB" << std::endl;
+        std::cout << "Run the receiver with the same sweep:" << std::endl;
+        std::cout << "  mpirun -np <ranks> ./receiver " << contactFile << " --autotune=\"" << sweep << "\"" << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+    }
+    
+    // Filled once: trials time the transfer, not the data generation
+    std::vector<double> data(arraySize);
+    for (size_t i = 0; i < arraySize; ++i) {
+        data[i] = rank * 1000.0 + static_cast<double>(i) / arraySize;
+    }
+    std::vector<double> times(trials.size()), throughputs(trials.size());
+    std::vector<Transport> used(trials.size());
+    
+    for (size_t t = 0; t < trials.size(); ++t) {
+        const TuneTrial& trial = trials[t];
+        WanAggregator aggregator(MPI_COMM_WORLD, trial.writers);
+        adios2::ADIOS adios(configFile, aggregator.adiosComm());
+        
+        // The trial's settings override the config file
+        StripedWriter stream(adios, "TransferIO", 1, "SST", {
+            {"RendezvousReaderCount", "1"},
+            {"QueueFullPolicy", "Block"}
+        });
+        stream.primaryIO().SetParameters({
+            {"QueueLimit", std::to_string(trial.queueLimit)},
+            {"MarshalMethod", trial.marshal}
+        });
+        TransportSelector transports(trial.transport, transportTimeout, aggregator.adiosComm());
+        
+        StripedField field(stream, "data", WirePrecision::Double,
+            {static_cast<size_t>(size * arraySize)},
+            {static_cast<size_t>(rank * arraySize)},
+            {arraySize},
+            rank
+        );
+        CompressionPipeline compression(adios, rank);
+        if (trial.compression != "none") compression.addSpec(tuneCompressionSpec(trial));
+        field.attach(compression);
+        
+        if (aggregator.isWriter()) {
+            stream.open(tuneContact(contactFile, t), transports, aggregator.adiosComm());
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t step = 0; step < steps; ++step) {
+            field.encode(data.data(), MPI_COMM_WORLD);
+            if (aggregator.isWriter()) stream.beginStep();
+            field.put(stream, data.data(), aggregator);
+            if (aggregator.isWriter()) stream.endStep();
+        }
+        if (aggregator.isWriter()) stream.close();   // Waits for the queued steps
+        double elapsed = std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        MPI_Reduce(&elapsed, &times[t], 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        
+        if (rank == 0) {
+            throughputs[t] = steps * stepMB / times[t];
+            used[t] = transports.used();
+            std::cout << "Trial " << std::setw(3) << t << " | " << describeTrial(trial)
+                      << " | " << transportName(used[t])
+                      << " | " << std::setprecision(3) << times[t] << " s"
+                      << " | " << std::setprecision(2) << throughputs[t] << " MB/s" << std::endl;
+        }
+    }
+    
+    if (rank == 0) {
+        size_t best = 0;
+        std::ofstream results("autotune_results.csv");
+        results << "Trial,QueueLimit,Marshal,Transport,Writers,Readers,Compression,Time(s),Throughput(MB/s)\n";
+        for (size_t t = 0; t < trials.size(); ++t) {
+            const TuneTrial& trial = trials[t];
+            results << t << "," << trial.queueLimit << "," << trial.marshal << "," << transportName(used[t]) << ","
+                    << trial.writers << "," << trial.readers << ",\"" << trial.compression << "\","
+                    << std::setprecision(6) << times[t] << "," << std::setprecision(2) << throughputs[t] << "\n";
+            if (throughputs[t] > throughputs[best]) best = t;
+        }
+        writeTunedConfig(outputFile, "TransferIO", "data", trials[best], used[best], throughputs[best], stepMB);
+        
+        std::cout << std::string(60, '=') << std::endl;
+        std::cout << "Best: trial " << best << " | " << describeTrial(trials[best])
+                  << " | " << std::setprecision(2) << throughputs[best] << " MB/s" << std::endl;
+        std::cout << "Tuned config saved to: " << outputFile << " (use with --config)" << std::endl;
+        std::cout << "All trials saved to: autotune_results.csv" << std::endl;
+    }
+}
+
+// Payload sizes for --benchmark: 4 KB to 1 GB per step
+const char* const defaultBenchmarkSizes = "4KB,64KB,1MB,16MB,256MB,1GB";
+
+// Bytes from "4096", "64KB", "16MB", "1GB" (binary units)
+static size_t parseBytes(const std::string& text)
+{
+    size_t unit = text.find_first_not_of("0123456789.");
+    double value = std::stod(text.substr(0, unit));
+    std::string suffix = (unit == std::string::npos) ? "" : text.substr(unit);
+    double scale = 1.0;
+    if (suffix == "K" || suffix == "KB") scale = 1024.0;
+    else if (suffix == "M" || suffix == "MB") scale = 1024.0 * 1024.0;
+    else if (suffix == "G" || suffix == "GB") scale = 1024.0 * 1024.0 * 1024.0;
+    else if (!suffix.empty() && suffix != "B") {
+        throw std::invalid_argument("invalid payload size '" + text + "' (use e.g. 64KB, 16MB, 1GB)");
+    }
+    return static_cast<size_t>(value * scale);
+}
+
+static std::vector<size_t> parseByteList(const std::string& text)
+{
+    std::vector<size_t> sizes;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) sizes.push_back(std::max(parseBytes(item), sizeof(double)));
+    }
+    return sizes;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+    return values[std::min(values.size(), std::max<size_t>(index, 1)) - 1];
+}
+
+// --benchmark: a payload-size sweep over one SST stream. Each size runs
+// `warmup` untimed and `steps` timed steps from a buffer filled once, with
+// BeginStep, Put (synchronous, so the copy into SST's buffer is counted
+// there) and EndStep timed separately, and writes one CSV row per size:
+// per-step latency of small payloads up to link bandwidth for large ones.
+// All ranks write, without aggregation, stripes, precision or compression.
+static void runBenchmark(const std::vector<size_t>& sizes, size_t steps, size_t warmup,
+                         const std::string& configFile, const std::string& contactFile,
+                         const std::string& transportRequest, int transportTimeout,
+                         const std::string& csvFile, int clockPort, const std::string& clockHost,
+                         int rank, int size)
+{
+    adios2::ADIOS adios(configFile, MPI_COMM_WORLD);
+    StripedWriter stream(adios, "TransferIO", 1, "SST", {
+        {"RendezvousReaderCount", "1"},
+        {"QueueLimit", "5"},
+        {"QueueFullPolicy", "Block"}
+    });
+    TransportSelector transports(transportRequest, transportTimeout, MPI_COMM_WORLD,
+                                 stream.primaryIO().Parameters());
+    
+    // This rank's elements of a step of `bytes`, split evenly over the ranks
+    auto share = [&](size_t bytes, size_t& total, size_t& start, size_t& count) {
+        total = bytes / sizeof(double);
+        stripeRows(total, rank, size, start, count);
+    };
+    size_t maxCount = 0;
+    for (size_t bytes : sizes) {
+        size_t total, start, count;
+        share(bytes, total, start, count);
+        maxCount = std::max(maxCount, count);
+    }
+    
+    // Filled once, outside every timed region
+    std::vector<double> data(maxCount);
+    for (size_t i = 0; i < maxCount; ++i) {
+        data[i] = rank * 1000.0 + static_cast<double>(i) / maxCount;
+    }
+    
+    size_t total, start, count;
+    share(sizes.front(), total, start, count);
+    adios2::Variable<double> varData = stream.primaryIO().DefineVariable<double>("data", {total}, {start}, {count});
+    adios2::Variable<size_t> varStep = stream.primaryIO().DefineVariable<size_t>("step");
+    adios2::Variable<double> varTimestamp = stream.primaryIO().DefineVariable<double>("timestamp");
+    std::unique_ptr<ClockServer> clock = advertiseClock(stream.primaryIO(), clockPort, clockHost, rank);
+    
+    stream.open(contactFile, transports, MPI_COMM_WORLD);
+    
+    std::ofstream csv;
+    if (rank == 0) {
+        std::cout << "=== ADIOS2 Sender Benchmark ===" << std::endl;
+        std::cout << "Contact file: " << contactFile << ".sst" << std::endl;
+        std::cout << "SST transport: " << transports.report() << std::endl;
+        std::cout << "MPI Ranks: " << size << std::endl;
+        std::cout << "Payloads: " << sizes.size() << " sizes x (" << warmup << " warm-up + "
+                  << steps << " timed) steps" << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+        csv.open(csvFile);
+        csv << "Payload(bytes),Steps,BeginStep(s),Put(s),EndStep(s),Latency p50(s),Latency p95(s),"
+            << "Latency p99(s),Bandwidth(MB/s)\n";
+    }
+    
+    size_t globalStep = 0;
+    for (size_t bytes : sizes) {
+        share(bytes, total, start, count);
+        varData.SetShape({total});
+        varData.SetSelection({{start}, {count}});
+        
+        // Per timed step, the slowest rank's phase times (rank 0 only)
+        std::vector<double> beginTimes, putTimes, endTimes, stepTimes;
+        for (size_t s = 0; s < warmup + steps; ++s, ++globalStep) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            stream.beginStep();
+            auto t1 = std::chrono::high_resolution_clock::now();
+            if (count > 0) stream.primary().Put(varData, data.data(), adios2::Mode::Sync);
+            if (rank == 0) {
+                double timestamp = wallClock();
+                stream.primary().Put(varStep, globalStep);
+                stream.primary().Put(varTimestamp, timestamp);
+            }
+            auto t2 = std::chrono::high_resolution_clock::now();
+            stream.endStep();
+            auto t3 = std::chrono::high_resolution_clock::now();
+            
+            double local[4] = {
+                std::chrono::duration<double>(t1 - t0).count(),
+                std::chrono::duration<double>(t2 - t1).count(),
+                std::chrono::duration<double>(t3 - t2).count(),
+                std::chrono::duration<double>(t3 - t0).count()
+            };
+            double slowest[4];
+            MPI_Reduce(local, slowest, 4, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+            if (rank == 0 && s >= warmup) {
+                beginTimes.push_back(slowest[0]);
+                putTimes.push_back(slowest[1]);
+                endTimes.push_back(slowest[2]);
+                stepTimes.push_back(slowest[3]);
+            }
+        }
+        
+        if (rank == 0) {
+            double payloadMB = total * sizeof(double) / (1024.0 * 1024.0);
+            double p50 = percentile(stepTimes, 50.0);
+            double bandwidth = payloadMB / p50;
+            std::cout << "Payload " << std::setw(12) << total * sizeof(double) << " B"
+                      << " | Begin: " << std::scientific << std::setprecision(2) << percentile(beginTimes, 50.0) << " s"
+                      << " | Put: " << percentile(putTimes, 50.0) << " s"
+                      << " | End: " << percentile(endTimes, 50.0) << " s"
+                      << " | p50: " << p50 << " s"
+                      << " | p95: " << percentile(stepTimes, 95.0) << " s"
+                      << " | " << std::fixed << std::setprecision(2) << bandwidth << " MB/s" << std::endl;
+            csv << total * sizeof(double) << "," << steps << std::scientific << std::setprecision(6)
+                << "," << percentile(beginTimes, 50.0) << "," << percentile(putTimes, 50.0)
+                << "," << percentile(endTimes, 50.0) << "," << p50
+                << "," << percentile(stepTimes, 95.0) << "," << percentile(stepTimes, 99.0)
+                << std::fixed << std::setprecision(2) << "," << bandwidth << "\n";
+        }
+    }
+    stream.close();
+    
+    if (rank == 0) {
+        std::cout << std::string(60, '=') << std::endl;
+        std::cout << "Phase times are medians over the timed steps" << std::endl;
+        std::cout << "Latency/bandwidth curve saved to: " << csvFile << std::endl;
+    }
+}
 
 int main(int argc, char *argv[])
 {
@@ -19,123 +307,298 @@ int main(int argc, char *argv[])
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     
-    // Parse command line arguments
+    // Parse command line arguments: [contact_name] [--options]
     std::string contactFile = "data-transfer"; // default name
-    if (argc > 1) {
-        contactFile = argv[1];
+    std::vector<std::string> compressSpecs;
+    int compressProbeInterval = 10;
+    std::string adaptSpec, adaptTarget;
+    std::string adaptLog = "adaptive_compression.csv";
+    std::string precisionName = "double";
+    int aggregatorCount = 0;   // WAN-facing ranks (0 = every rank)
+    int stripes = 1;           // Parallel SST streams per step
+    std::string transportRequest;   // Empty: the config's DataTransport, or sockets
+    int transportTimeout = 30;  // Seconds before falling back to the next transport
+    std::string configFile;     // ADIOS2 XML runtime config
+    std::string readersOption;     // --readers (empty: the config's, or 1)
+    std::string distributeOption;  // --distribute (empty: the config's, or all)
+    std::string autotuneSweep;  // Non-empty: run the autotuner instead
+    int autotuneSteps = 5;
+    std::string autotuneOut = "adios2_config_tuned.xml";
+    size_t arraySize = 10000000;  // Elements per rank (80 MB of doubles per step)
+    size_t numSteps = 10;         // Number of timesteps to send
+    std::string benchmarkSizes;   // Non-empty: run the payload sweep instead
+    size_t benchmarkSteps = 20;   // Timed steps per payload size
+    size_t benchmarkWarmup = 3;   // Untimed steps before them
+    std::string benchmarkCsv = "benchmark_results.csv";
+    int clockPort = 0;            // Time server for receiver latency (0 = any port)
+    std::string clockHost;        // Name advertised for it (empty = hostname)
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--compress=", value)) {
+            compressSpecs.push_back(value);
+        } else if (parseOption(arg, "--compress-probe=", value)) {
+            compressProbeInterval = std::stoi(value);
+        } else if (parseOption(arg, "--precision=", value)) {
+            precisionName = value;
+        } else if (parseOption(arg, "--adapt=", value)) {
+            adaptSpec = value;
+        } else if (parseOption(arg, "--adapt-target=", value)) {
+            adaptTarget = value;
+        } else if (parseOption(arg, "--adapt-log=", value)) {
+            adaptLog = value;
+        } else if (parseOption(arg, "--aggregators=", value)) {
+            aggregatorCount = std::stoi(value);
+        } else if (parseOption(arg, "--stripes=", value)) {
+            stripes = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--transport=", value)) {
+            transportRequest = value;
+        } else if (parseOption(arg, "--transport-timeout=", value)) {
+            transportTimeout = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--readers=", value)) {
+            readersOption = value;
+        } else if (parseOption(arg, "--distribute=", value)) {
+            distributeOption = value;
+        } else if (parseOption(arg, "--config=", value)) {
+            configFile = value;
+        } else if (arg == "--autotune") {
+            autotuneSweep = defaultTuneSweep;
+        } else if (parseOption(arg, "--autotune=", value)) {
+            autotuneSweep = value;
+        } else if (parseOption(arg, "--autotune-steps=", value)) {
+            autotuneSteps = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--autotune-out=", value)) {
+            autotuneOut = value;
+        } else if (parseOption(arg, "--elements=", value)) {
+            arraySize = std::max<size_t>(1, std::stoull(value));
+        } else if (parseOption(arg, "--steps=", value)) {
+            numSteps = std::stoull(value);
+        } else if (arg == "--benchmark") {
+            benchmarkSizes = defaultBenchmarkSizes;
+        } else if (parseOption(arg, "--benchmark=", value)) {
+            benchmarkSizes = value;
+        } else if (parseOption(arg, "--bench-steps=", value)) {
+            benchmarkSteps = std::max<size_t>(1, std::stoull(value));
+        } else if (parseOption(arg, "--warmup=", value)) {
+            benchmarkWarmup = std::stoull(value);
+        } else if (parseOption(arg, "--bench-csv=", value)) {
+            benchmarkCsv = value;
+        } else if (parseOption(arg, "--clock-port=", value)) {
+            clockPort = std::stoi(value);
+        } else if (parseOption(arg, "--clock-host=", value)) {
+            clockHost = value;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() > 0) {
+        contactFile = positional[0];
+    }
+    
+    if (!autotuneSweep.empty()) {
+        try {
+            runAutotune(parseTuneSweep(autotuneSweep), autotuneSweep, configFile, contactFile,
+                        autotuneOut, arraySize, autotuneSteps, transportTimeout, rank, size);
+        } catch (std::exception &e) {
+            std::cerr << "Error on rank " << rank << ": " << e.what() << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Finalize();
+        return 0;
     }
     
-    // Configuration parameters
-    const size_t arraySize = 10000000;  // 10M elements (~40 MB per step)
-    const size_t numSteps = 10;          // Number of timesteps to send
+    if (!benchmarkSizes.empty()) {
+        try {
+            runBenchmark(parseByteList(benchmarkSizes), benchmarkSteps, benchmarkWarmup, configFile,
+                         contactFile, transportRequest, transportTimeout, benchmarkCsv, clockPort, clockHost,
+                         rank, size);
+        } catch (std::exception &e) {
+            std::cerr << "Error on rank " << rank << ": " << e.what() << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Finalize();
+        return 0;
+    }
     
     try {
-        // Initialize ADIOS2
-        adios2::ADIOS adios(MPI_COMM_WORLD);
+        // Only aggregator ranks open the SST stream
+        WanAggregator aggregator(MPI_COMM_WORLD, aggregatorCount);
         
-        // Declare IO with WAN configuration
-        adios2::IO io = adios.DeclareIO("TransferIO");
+        // Initialize ADIOS2
+        adios2::ADIOS adios(configFile, aggregator.adiosComm());
         
-        // Set engine parameters for WAN transfer
+        // Declare one IO per stripe with WAN configuration
         // Use SST (Sustainable Staging Transport) for wide-area network transfers
-        io.SetEngine("SST");
-        
         // Optional: Set parameters for better WAN performance
-        io.SetParameters({
+        StripedWriter stream(adios, "TransferIO", stripes, "SST", {
             {"RendezvousReaderCount", "1"},
             {"QueueLimit", "5"},
-            {"QueueFullPolicy", "Block"},
-            {"ControlTransport", "sockets"},  // Use TCP sockets for WAN
-            {"DataTransport", "sockets"},
-            {"OpenTimeoutSecs", "300"}        // 5 minute timeout for WAN
+            {"QueueFullPolicy", "Block"}
         });
+        stream.setParameters(fanOutParams(readersOption, distributeOption));
+        checkFanOut(stream.primaryIO().Parameters(), stripes);
+        
+        // Probe the data transports the writer ranks have in common
+        TransportSelector transports(transportRequest, transportTimeout, aggregator.adiosComm(),
+                                     stream.primaryIO().Parameters());
         
-        // Define the data variable
-        adios2::Variable<double> varData = io.DefineVariable<double>(
-            "data",
+        // Define the data variable in its wire precision
+        WirePrecision precision = parseWirePrecision(precisionName);
+        StripedField fieldData(stream, "data", precision,
             {static_cast<size_t>(size * arraySize)},  // global dimensions
             {static_cast<size_t>(rank * arraySize)},  // offset
-            {arraySize}                                 // local dimensions
+            {arraySize},                                // local dimensions
+            rank
         );
         
+        // Attach per-variable compression operators
+        CompressionPipeline compression(adios, rank);
+        for (const auto& spec : compressSpecs) compression.addSpec(spec);
+        compression.setProbeInterval(compressProbeInterval);
+        fieldData.attach(compression);
+        CompressionController controller(compression, rank);
+        controller.configure(adaptSpec, adaptTarget, adaptLog);
+        
         // Define metadata variables
-        adios2::Variable<size_t> varStep = io.DefineVariable<size_t>("step");
-        adios2::Variable<double> varTimestamp = io.DefineVariable<double>("timestamp");
+        adios2::Variable<size_t> varStep = stream.primaryIO().DefineVariable<size_t>("step");
+        adios2::Variable<double> varTimestamp = stream.primaryIO().DefineVariable<double>("timestamp");
+        
+        // Time server the receiver corrects its latency with
+        std::unique_ptr<ClockServer> clock = advertiseClock(stream.primaryIO(), clockPort, clockHost, rank);
         
-        // Open engine for writing (contact file name can be specified)
-        adios2::Engine writer = io.Open(contactFile, adios2::Mode::Write);
+        // Open engines for writing (contact file name can be specified)
+        if (aggregator.isWriter()) {
+            stream.open(contactFile, transports, aggregator.adiosComm());
+        }
         
         if (rank == 0) {
             std::cout << "=== ADIOS2 Data Sender (Utah) ===" << std::endl;
-            std::cout << "Contact file: " << contactFile << ".sst" << std::endl;
+            std::cout << "Contact file: " << stripeContact(contactFile, 0, stripes) << ".sst";
+            if (stripes > 1) {
+                std::cout << " (" << stripes << " stripes, receiver needs --streams=" << stripes << ")";
+            }
+            std::cout << std::endl;
+            if (!configFile.empty()) {
+                std::cout << "Config file: " << configFile << std::endl;
+            }
+            std::cout << "SST transport: " << transports.report() << std::endl;
+            std::cout << "Readers: " << describeFanOut(stream.primaryIO().Parameters()) << std::endl;
+            if (clock) std::cout << "Clock server: " << clock->endpoint(clockHost) << std::endl;
             std::cout << "MPI Ranks: " << size << std::endl;
             std::cout << "Array size per rank: " << arraySize << " elements" << std::endl;
-            std::cout << "Total data per step: " << (size * arraySize * sizeof(double)) / (1024.0 * 1024.0) << " MB" << std::endl;
+            std::cout << "Wire precision: " << wirePrecisionName(precision) << std::endl;
+            if (aggregator.enabled()) {
+                std::cout << "WAN writers: " << aggregator.aggregators() << " aggregators (up to "
+                          << aggregator.maxGroupSize() << " ranks each)" << std::endl;
+            } else {
+                std::cout << "WAN writers: all ranks" << std::endl;
+            }
+            std::cout << "Total data per step: " << (size * fieldData.wireBytes()) / (1024.0 * 1024.0) << " MB" << std::endl;
             std::cout << "Number of steps: " << numSteps << std::endl;
+            compression.printConfig(std::cout);
+            controller.printConfig(std::cout);
             std::cout << "Starting data transmission..." << std::endl;
             std::cout << std::string(60, '=') << std::endl;
         }
         
         std::vector<double> data(arraySize);
         auto overallStart = std::chrono::high_resolution_clock::now();
+        double transferTime = 0.0;   // Sum of the step times, without data generation
         
         // Send data for each timestep
         for (size_t step = 0; step < numSteps; ++step) {
-            auto stepStart = std::chrono::high_resolution_clock::now();
-            
-            // Generate data (simulate scientific computation)
+            // Generate data (simulate scientific computation), outside the
+            // timed region so throughput only covers the transfer
             for (size_t i = 0; i < arraySize; ++i) {
                 data[i] = rank * 1000.0 + step + static_cast<double>(i) / arraySize;
             }
             
+            auto stepStart = std::chrono::high_resolution_clock::now();
+            
+            // Convert to the wire precision (no-op for double)
+            fieldData.encode(data.data(), MPI_COMM_WORLD);
+            
+            // Measure compression on sampled steps (excluded from the step time)
+            double probeTime = 0.0;
+            if (compression.shouldProbe(step)) {
+                auto probeStart = std::chrono::high_resolution_clock::now();
+                fieldData.probe(compression, data.data());
+                probeTime = std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() - probeStart).count();
+            }
+            
             // Begin step
-            writer.BeginStep();
+            if (aggregator.isWriter()) stream.beginStep();
             
             // Get timestamp
-            auto now = std::chrono::system_clock::now();
-            auto timestamp = std::chrono::duration<double>(now.time_since_epoch()).count();
+            double timestamp = wallClock();
             
             // Write data
-            writer.Put(varData, data.data());
+            fieldData.put(stream, data.data(), aggregator);
+            fieldData.record(compression);
             if (rank == 0) {
-                writer.Put(varStep, step);
-                writer.Put(varTimestamp, timestamp);
+                stream.primary().Put(varStep, step);
+                stream.primary().Put(varTimestamp, timestamp);
             }
             
             // End step (this triggers the actual transfer)
-            writer.EndStep();
+            if (aggregator.isWriter()) stream.endStep();
             
             auto stepEnd = std::chrono::high_resolution_clock::now();
-            auto stepDuration = std::chrono::duration<double>(stepEnd - stepStart).count();
+            auto stepDuration = std::chrono::duration<double>(stepEnd - stepStart).count() - probeTime;
+            transferTime += stepDuration;
+            
+            CompressionPipeline::StepStats localStats = compression.takeStepStats();
+            CompressionPipeline::StepStats globalStats;
+            if (compression.enabled()) {
+                localStats.stepTime = stepDuration;
+                globalStats = CompressionPipeline::reduce(localStats, MPI_COMM_WORLD);
+            }
             
             if (rank == 0) {
-                double stepSizeMB = (size * arraySize * sizeof(double)) / (1024.0 * 1024.0);
+                double stepSizeMB = (size * fieldData.wireBytes()) / (1024.0 * 1024.0);
                 double throughputMBps = stepSizeMB / stepDuration;
                 
                 std::cout << "Step " << std::setw(3) << step 
                           << " | Time: " << std::fixed << std::setprecision(3) << std::setw(8) << stepDuration << " s"
                           << " | Size: " << std::setw(8) << std::setprecision(2) << stepSizeMB << " MB"
-                          << " | Throughput: " << std::setw(8) << std::setprecision(2) << throughputMBps << " MB/s"
-                          << std::endl;
+                          << " | Throughput: " << std::setw(8) << std::setprecision(2) << throughputMBps << " MB/s";
+                if (compression.enabled()) {
+                    compression.accumulate(globalStats);
+                    std::cout << CompressionPipeline::formatStep(globalStats, stepDuration);
+                }
+                std::cout << std::endl;
             }
+            controller.update(step, globalStats);
         }
         
         // Close writer
-        writer.Close();
+        if (aggregator.isWriter()) stream.close();
+        
+        double gatherTime = aggregator.getGatherTime();
+        double maxGatherTime = 0.0;
+        MPI_Reduce(&gatherTime, &maxGatherTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
         
         auto overallEnd = std::chrono::high_resolution_clock::now();
         auto totalDuration = std::chrono::duration<double>(overallEnd - overallStart).count();
         
         if (rank == 0) {
             std::cout << std::string(60, '=') << std::endl;
-            double totalSizeMB = (numSteps * size * arraySize * sizeof(double)) / (1024.0 * 1024.0);
-            double avgThroughputMBps = totalSizeMB / totalDuration;
+            double totalSizeMB = (numSteps * size * fieldData.wireBytes()) / (1024.0 * 1024.0);
+            double avgThroughputMBps = totalSizeMB / transferTime;
             
             std::cout << "=== Transfer Complete ===" << std::endl;
-            std::cout << "Total time: " << std::fixed << std::setprecision(3) << totalDuration << " seconds" << std::endl;
+            std::cout << "Total time: " << std::fixed << std::setprecision(3) << totalDuration << " seconds"
+                      << " (transfer " << transferTime << " s)" << std::endl;
             std::cout << "Total data: " << std::setprecision(2) << totalSizeMB << " MB" << std::endl;
             std::cout << "Average throughput: " << std::setprecision(2) << avgThroughputMBps << " MB/s" << std::endl;
             std::cout << "Average throughput: " << std::setprecision(2) << avgThroughputMBps * 8.0 << " Mbps" << std::endl;
+            std::cout << "SST transport: " << transports.usedName() << std::endl;
+            if (aggregator.enabled()) {
+                std::cout << "Aggregation gather time: " << std::setprecision(3) << maxGatherTime << " s" << std::endl;
+            }
+            compression.printSummary(std::cout);
         }
         
     } catch (std::exception &e) {
@@ -7,232 +7,649 @@
 #include <iostream>
 #include <vector>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <fstream>
 #include <thread>
 #include <mpi.h>
 #include <string>
 
+#include "buffers.h"
+#include "compression.h"
+#include "config.h"
+#include "fanout.h"
+#include "metrics.h"
+#include "precision.h"
+#include "relay.h"
+#include "resume.h"
+#include "trace.h"
+#include "transport.h"
+
+// Match a "--name=value" command line option and extract its value
+static bool parseOption(const std::string& arg, const std::string& name, std::string& value)
+{
+    if (arg.compare(0, name.size(), name) != 0) return false;
+    value = arg.substr(name.size());
+    return true;
+}
+
+// Double arrays in a reduced wire precision (--precision); everything
+// else goes through the plain typed relay
+class WireRelay : public TypedRelay<double> {
+public:
+    WireRelay(const std::string& name, WirePrecision precision, size_t slots)
+        : TypedRelay<double>(name, slots), precision_(precision) {}
+    
+    void put(adios2::IO& io, adios2::Engine& writer, size_t slot, RelayContext& ctx) override {
+        Buffer& b = buffers_[slot];
+        if (b.shape.empty()) {
+            TypedRelay<double>::put(io, writer, slot, ctx);   // Scalars stay double
+            return;
+        }
+        
+        std::vector<adios2::Box<adios2::Dims>> blocks;
+        for (const Block& block : b.blocks) blocks.push_back({block.start, block.count});
+        if (!field_) {
+            adios2::Dims none(b.shape.size(), 0);   // Ranks without data define an empty block
+            const adios2::Box<adios2::Dims>& first = blocks.empty() ? adios2::Box<adios2::Dims>(none, none)
+                                                                    : blocks.front();
+            field_.reset(new WireField(io, name_, precision_, b.shape, first.first, first.second, ctx.rank));
+            if (ctx.compression) field_->attach(*ctx.compression);
+            fieldShape_ = b.shape;
+        } else if (b.shape != fieldShape_) {
+            throw std::runtime_error("shape of " + name_ + " changed, not supported with --precision");
+        }
+        if (blocks != fieldBlocks_) {
+            field_->setBlocks(blocks);
+            fieldBlocks_ = blocks;
+        }
+        
+        // Collective for fixed16, so ranks without a slab take part too
+        field_->encode(b.data.data(), MPI_COMM_WORLD);
+        if (!b.pending) return;
+        
+        if (ctx.compression) {
+            if (ctx.probe) {
+                auto start = std::chrono::high_resolution_clock::now();
+                field_->probe(*ctx.compression, b.data.data());
+                ctx.probeTime += std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+            }
+            field_->record(*ctx.compression);
+        }
+        field_->put(writer, b.data.data());
+        ctx.bytes += field_->wireBytes();
+    }
+    
+private:
+    WirePrecision precision_;
+    std::unique_ptr<WireField> field_;
+    adios2::Dims fieldShape_;
+    std::vector<adios2::Box<adios2::Dims>> fieldBlocks_;   // Last given to field_
+};
+
+static std::unique_ptr<VariableRelay> makeSenderRelay(const std::string& name, const std::string& type,
+                                                      WirePrecision precision, size_t slots)
+{
+    if (precision != WirePrecision::Double && type == adios2::GetType<double>()) {
+        return std::unique_ptr<VariableRelay>(new WireRelay(name, precision, slots));
+    }
+    return makeRelay(name, type, slots);
+}
+
+// One input step: the relays it carries and the buffer slot they read into
+struct InputStep {
+    std::vector<VariableRelay*> relays;
+    size_t slot = 0;
+    size_t bytes = 0;   // Read by this rank
+    size_t index = 0;   // Step of the input file
+};
+
+// Reads whole BP steps into relay buffer slots: deferred Gets of this rank's
+// slab of every variable, one PerformGets, then EndStep, so the input step
+// is released as soon as its data is in memory
+class StepReader {
+public:
+    StepReader(adios2::IO& io, adios2::Engine& reader, WirePrecision precision,
+               Decomposition decomposition, size_t slots, int rank, int size)
+        : io_(io), reader_(reader), precision_(precision), decomposition_(decomposition),
+          slots_(slots), rank_(rank), size_(size) {}
+    
+    // Read the next step into step.slot; false at end of stream
+    bool read(InputStep& step) {
+        TraceScope trace("bp_read");
+        auto start = std::chrono::high_resolution_clock::now();
+        if (reader_.BeginStep() != adios2::StepStatus::OK) return false;
+        
+        step.relays.clear();
+        step.bytes = 0;
+        step.index = index_++;
+        for (const auto& varPair : io_.AvailableVariables()) {
+            const std::string& varName = varPair.first;
+            if (varName == "source_step") continue;   // Replaced by this sender's own
+            auto it = relays_.find(varName);
+            if (it == relays_.end()) {
+                auto typeIt = varPair.second.find("Type");
+                if (typeIt == varPair.second.end()) continue;
+                it = relays_.emplace(varName, makeSenderRelay(varName, typeIt->second, precision_, slots_)).first;
+                if (it->second) {
+                    it->second->setDecomposition(decomposition_);
+                } else if (rank_ == 0) {
+                    std::cerr << "Warning: skipping " << varName << " of unsupported type "
+                              << typeIt->second << std::endl;
+                }
+            }
+            if (!it->second) continue;
+            step.bytes += it->second->get(io_, reader_, step.slot, rank_, size_);
+            step.relays.push_back(it->second.get());
+        }
+        reader_.PerformGets();
+        reader_.EndStep();
+        
+        readTime_ += std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        return true;
+    }
+    
+    // Step over the next `steps` input steps without reading their data;
+    // returns how many there were
+    size_t skip(size_t steps) {
+        size_t skipped = 0;
+        while (skipped < steps && reader_.BeginStep() == adios2::StepStatus::OK) {
+            reader_.EndStep();
+            skipped++;
+        }
+        index_ += skipped;
+        return skipped;
+    }
+    
+    double getReadTime() const { return readTime_; }
+    
+private:
+    adios2::IO& io_;
+    adios2::Engine& reader_;
+    WirePrecision precision_;
+    Decomposition decomposition_;
+    size_t slots_;
+    int rank_, size_;
+    
+    // One relay per input variable, created (and its type resolved) the
+    // first time it shows up
+    std::map<std::string, std::unique_ptr<VariableRelay>> relays_;
+    size_t index_ = 0;
+    double readTime_ = 0.0;
+};
+
+// Reads up to `ahead` steps in advance on a background thread while the
+// main thread sends. A step holds one relay buffer slot from the moment it
+// is read until its SST EndStep; slots in use are capped by the memory
+// limit once the step size is known. The lowest free slot is always taken,
+// so slots beyond the cap are never allocated.
+class PrefetchReader {
+public:
+    PrefetchReader(StepReader& stepReader, int ahead, size_t memoryLimit)
+        : stepReader_(stepReader), slots_(ahead + 1), busy_(ahead + 1, false),
+          memoryLimit_(memoryLimit), maxSlots_(ahead + 1)
+    {
+        for (size_t i = 0; i < slots_.size(); ++i) slots_[i].slot = i;
+        thread_ = std::thread(&PrefetchReader::run, this);
+    }
+    
+    ~PrefetchReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        freeCv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+    
+    // Next step in file order, nullptr at end of stream
+    InputStep* next() {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        filledCv_.wait(lock, [this]() { return !filled_.empty() || eof_; });
+        waitTime_ += std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        if (filled_.empty()) return nullptr;
+        size_t slotIdx = filled_.front();
+        filled_.pop_front();
+        return &slots_[slotIdx];
+    }
+    
+    // Give back a step returned by next() once it has been sent
+    void release(InputStep* step) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_[step->slot] = false;
+            inUse_--;
+        }
+        freeCv_.notify_one();
+    }
+    
+    double getWaitTime() const { return waitTime_; }   // Main thread blocked on disk
+    size_t getMaxQueued() const { return maxQueued_; }
+    size_t getSlotLimit() const { return maxSlots_; }
+    
+private:
+    void run() {
+        traceThread("prefetch");
+        while (true) {
+            size_t slotIdx = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                freeCv_.wait(lock, [this]() { return inUse_ < maxSlots_ || stop_; });
+                if (stop_) break;
+                while (busy_[slotIdx]) slotIdx++;
+                busy_[slotIdx] = true;
+                inUse_++;
+            }
+            
+            InputStep& step = slots_[slotIdx];
+            bool more = stepReader_.read(step);
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (more) {
+                    filled_.push_back(slotIdx);
+                    maxQueued_ = std::max(maxQueued_, filled_.size());
+                    if (step.bytes > 0) {
+                        size_t fit = std::max<size_t>(1, memoryLimit_ / step.bytes);
+                        maxSlots_ = std::min(maxSlots_, fit);
+                    }
+                } else {
+                    eof_ = true;
+                }
+            }
+            filledCv_.notify_one();
+            if (!more) break;
+        }
+    }
+    
+    StepReader& stepReader_;   // Used by the prefetch thread only
+    std::vector<InputStep> slots_;
+    std::vector<bool> busy_;
+    std::deque<size_t> filled_;
+    size_t inUse_ = 0;
+    size_t memoryLimit_;
+    size_t maxSlots_;
+    size_t maxQueued_ = 0;
+    std::mutex mutex_;
+    std::condition_variable freeCv_, filledCv_;
+    bool eof_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+    
+    double waitTime_ = 0.0;   // Written by the main thread only
+};
+
 int main(int argc, char *argv[])
 {
-    MPI_Init(&argc, &argv);
+    // Parse command line arguments: <input_bp_file> [output_contact_name] [--options]
+    // (before MPI init since prefetching needs MPI_THREAD_MULTIPLE)
+    int prefetchDepth = 0;          // Steps read ahead of the one being sent (0 = lockstep)
+    double prefetchMemMB = 1024.0;  // Per-rank cap on buffered input steps
+    std::vector<std::string> compressSpecs;
+    int compressProbeInterval = 10;
+    std::string adaptSpec, adaptTarget;
+    std::string adaptLog = "adaptive_compression.csv";
+    std::string precisionName = "double";
+    std::string readDecomposition = "slab";
+    std::string transportRequest;   // Empty: the config's DataTransport, or sockets
+    int transportTimeout = 30;      // Seconds before falling back to the next transport
+    std::string configFile;         // ADIOS2 XML runtime config
+    std::string readersOption;      // --readers (empty: the config's, or 1)
+    std::string distributeOption;   // --distribute (empty: the config's, or all)
+    int metricsInterval = 10;       // Steps per batch of reduced step metrics
+    size_t startStep = 0;           // Input steps to skip (resuming a transfer)
+    bool resume = false;            // Take startStep from the receiver's resume file
+    std::string traceFile;          // Chrome trace of every rank's phases
+    size_t traceEvents = 65536;     // Events kept per thread
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--compress=", value)) {
+            compressSpecs.push_back(value);
+        } else if (parseOption(arg, "--compress-probe=", value)) {
+            compressProbeInterval = std::stoi(value);
+        } else if (parseOption(arg, "--precision=", value)) {
+            precisionName = value;
+        } else if (parseOption(arg, "--adapt=", value)) {
+            adaptSpec = value;
+        } else if (parseOption(arg, "--adapt-target=", value)) {
+            adaptTarget = value;
+        } else if (parseOption(arg, "--adapt-log=", value)) {
+            adaptLog = value;
+        } else if (arg == "--prefetch") {
+            prefetchDepth = 2;
+        } else if (parseOption(arg, "--prefetch=", value)) {
+            prefetchDepth = std::max(0, std::stoi(value));
+        } else if (parseOption(arg, "--prefetch-mem=", value)) {
+            prefetchMemMB = std::stod(value);
+        } else if (parseOption(arg, "--read-decomposition=", value)) {
+            readDecomposition = value;
+        } else if (parseOption(arg, "--transport=", value)) {
+            transportRequest = value;
+        } else if (parseOption(arg, "--transport-timeout=", value)) {
+            transportTimeout = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--readers=", value)) {
+            readersOption = value;
+        } else if (parseOption(arg, "--distribute=", value)) {
+            distributeOption = value;
+        } else if (parseOption(arg, "--config=", value)) {
+            configFile = value;
+        } else if (parseOption(arg, "--metrics-interval=", value)) {
+            metricsInterval = std::max(1, std::stoi(value));
+        } else if (parseOption(arg, "--huge-pages=", value)) {
+            // Before anything allocates an AlignedVector
+            if (!parseHugePages(value, bufferConfig().hugePages)) {
+                std::cerr << "Invalid --huge-pages: " << value << " (expected off, thp or explicit)" << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--trace=", value)) {
+            traceFile = value;
+        } else if (parseOption(arg, "--trace-events=", value)) {
+            traceEvents = std::stoul(value);
+        } else if (parseOption(arg, "--start-step=", value)) {
+            startStep = std::stoull(value);
+        } else if (arg == "--resume") {
+            resume = true;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    
+    int provided;
+    int required = prefetchDepth > 0 ? MPI_THREAD_MULTIPLE : MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, required, &provided);
     
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     
-    // Parse command line arguments
-    if (argc < 2) {
+    if (prefetchDepth > 0 && provided < MPI_THREAD_MULTIPLE) {
         if (rank == 0) {
-            std::cerr << "Usage: " << argv[0] << " <input_bp_file> [output_contact_name]" << std::endl;
+            std::cerr << "Warning: MPI_THREAD_MULTIPLE not available, "
+                      << "falling back to lockstep BP reads" << std::endl;
+        }
+        prefetchDepth = 0;
+    }
+    
+    if (positional.empty()) {
+        if (rank == 0) {
+            std::cerr << "Usage: " << argv[0] << " <input_bp_file> [output_contact_name] [--compress=VAR:OP[:k=v,...]] [--precision=double|float32|fixed16] [--prefetch[=K]] [--prefetch-mem=MB] [--read-decomposition=slab|blocks] [--start-step=N|--resume]" << std::endl;
             std::cerr << "Example: " << argv[0] << " /path/to/gs-2gb.bp data-transfer" << std::endl;
         }
         MPI_Finalize();
         return 1;
     }
     
-    std::string inputFile = argv[1];
+    std::string inputFile = positional[0];
     std::string contactFile = "data-transfer";
-    if (argc > 2) {
-        contactFile = argv[2];
+    if (positional.size() > 1) {
+        contactFile = positional[1];
     }
     
+    // The BP5 reader gets its own communicator so its collectives never
+    // interleave with the SST writer's when prefetching on another thread
+    MPI_Comm readComm;
+    MPI_Comm_dup(MPI_COMM_WORLD, &readComm);
+    
     try {
-        adios2::ADIOS adios(MPI_COMM_WORLD);
+        adios2::ADIOS adios(configFile, MPI_COMM_WORLD);
+        adios2::ADIOS readAdios(configFile, readComm);
         
         // === READ SIDE: Open input BP file ===
-        adios2::IO ioRead = adios.DeclareIO("ReadIO");
-        ioRead.SetEngine("BP5");
+        adios2::IO ioRead = readAdios.DeclareIO("ReadIO");
+        configureIO(ioRead, "BP5", {});
         adios2::Engine reader = ioRead.Open(inputFile, adios2::Mode::Read);
         
         // === WRITE SIDE: Configure SST for WAN transfer ===
         adios2::IO ioWrite = adios.DeclareIO("TransferIO");
-        ioWrite.SetEngine("SST");
-        ioWrite.SetParameters({
+        configureIO(ioWrite, "SST", {
             {"RendezvousReaderCount", "1"},
             {"QueueLimit", "5"},
             {"QueueFullPolicy", "Block"},
-            {"ControlTransport", "sockets"},
-            {"DataTransport", "sockets"},
-            {"OpenTimeoutSecs", "300"},
             {"MarshalMethod", "BP5"}
         });
+        ioWrite.SetParameters(fanOutParams(readersOption, distributeOption));
+        adios2::Variable<uint64_t> varSource;
+        if (rank == 0) varSource = ioWrite.DefineVariable<uint64_t>("source_step");
+        TransportSelector transports(transportRequest, transportTimeout, MPI_COMM_WORLD,
+                                     ioWrite.Parameters());
+        
+        WirePrecision precision = parseWirePrecision(precisionName);
+        Decomposition decomposition = parseDecomposition(readDecomposition);
+        
+        CompressionPipeline compression(adios, rank);
+        for (const auto& spec : compressSpecs) compression.addSpec(spec);
+        compression.setProbeInterval(compressProbeInterval);
+        CompressionController controller(compression, rank);
+        controller.configure(adaptSpec, adaptTarget, adaptLog);
         
         if (rank == 0) {
             std::cout << "=== ADIOS2 BP File Relay Sender ===" << std::endl;
             std::cout << "Input BP file: " << inputFile << std::endl;
+            if (!configFile.empty()) {
+                std::cout << "Config file: " << configFile << std::endl;
+            }
             std::cout << "MPI Ranks: " << size << std::endl;
+            std::cout << "Wire precision: " << wirePrecisionName(precision) << std::endl;
+            std::cout << "Read decomposition: " << decompositionName(decomposition) << std::endl;
+            std::cout << "BP read-ahead: ";
+            if (prefetchDepth > 0) {
+                std::cout << prefetchDepth << " steps, up to " << prefetchMemMB << " MB per rank" << std::endl;
+            } else {
+                std::cout << "off" << std::endl;
+            }
+            std::cout << "Step metrics: reduced every " << metricsInterval << " steps" << std::endl;
+            std::cout << bufferBanner() << std::endl;
+            if (!traceFile.empty()) {
+                std::cout << "Tracing: " << traceFile << " (" << traceEvents << " events per thread)" << std::endl;
+            }
+            compression.printConfig(std::cout);
+            controller.printConfig(std::cout);
             std::cout << "Creating SST connection file..." << std::endl;
             std::cout << std::string(60, '=') << std::endl;
         }
         
-        // Start a thread to monitor and display SST connection string
-        std::thread sstMonitor;
+        // Rank 0 prints the connection string of each open attempt
+        std::unique_ptr<ContactAnnouncer> announcer;
+        if (rank == 0) announcer.reset(new ContactAnnouncer(contactFile, "mpirun -np <num_ranks> ./receiver"));
+        
+        adios2::Engine writer;
+        transports.open(MPI_COMM_WORLD, [&](Transport transport) {
+            ioWrite.SetParameters(transports.params(transport));
+            if (announcer) announcer->start(transport);
+            try {
+                writer = ioWrite.Open(contactFile, adios2::Mode::Write);
+            } catch (...) {
+                if (announcer) announcer->finish(false);
+                throw;
+            }
+            if (announcer) announcer->finish(true);
+        }, [&]() {
+            if (writer) writer.Close();
+            writer = adios2::Engine();
+        });
+        announcer.reset();
         if (rank == 0) {
-            sstMonitor = std::thread([contactFile]() {
-                // Wait for SST file to be created
-                std::string sstFileName = contactFile + ".sst";
-                for (int i = 0; i < 30; i++) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                    std::ifstream sstFile(sstFileName);
-                    if (sstFile.is_open()) {
-                        std::string line;
-                        std::getline(sstFile, line); // Skip first line
-                        std::getline(sstFile, line); // Get connection string
-                        sstFile.close();
-                        
-                        if (!line.empty()) {
-                            std::cout << "\n*** SST CONNECTION STRING ***" << std::endl;
-                            std::cout << line << std::endl;
-                            std::cout << "\nRun this on receiver machine (choose your MPI ranks):" << std::endl;
-                            std::cout << "  mpirun -np <num_ranks> ./receiver \"" << line << "\"" << std::endl;
-                            std::cout << std::string(60, '=') << std::endl;
-                            std::cout << "\nWaiting for receiver to connect..." << std::endl;
-                            std::cout << std::string(60, '=') << std::endl;
-                            break;
-                        }
-                    }
-                }
-            });
+            std::cout << "SST transport: " << transports.report() << std::endl;
+            std::cout << "Readers: " << describeFanOut(ioWrite.Parameters()) << std::endl;
         }
         
-        adios2::Engine writer = ioWrite.Open(contactFile, adios2::Mode::Write);
-        
-        if (rank == 0 && sstMonitor.joinable()) {
-            sstMonitor.join();
+        // The receiver wrote its resume file before it connected
+        if (resume) {
+            uint64_t step = 0;
+            int found = rank == 0 && readResumeStep(contactFile, step) ? 1 : 0;
+            MPI_Bcast(&found, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            MPI_Bcast(&step, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+            if (found) {
+                startStep = step;
+            } else if (rank == 0) {
+                std::cerr << "Warning: no " << resumeFile(contactFile) << ", starting at step " << startStep
+                          << std::endl;
+            }
         }
         
         auto overallStart = std::chrono::high_resolution_clock::now();
         size_t stepCount = 0;
         double totalDataMB = 0.0;
         
-        // Define output variables once (before any steps)
-        adios2::Variable<double> varU_out;
-        adios2::Variable<double> varV_out;
-        adios2::Variable<int32_t> varStep_out;
-        
-        size_t totalZ = 0, dimY = 0, dimX = 0;
-        size_t zStart = 0, zCount = 0;
-        
-        // Get dimensions from first step
-        if (reader.BeginStep() == adios2::StepStatus::OK) {
-            auto varU_in = ioRead.InquireVariable<double>("U");
-            if (varU_in) {
-                auto shape = varU_in.Shape();
-                if (shape.size() == 3) {
-                    totalZ = shape[0];
-                    dimY = shape[1];
-                    dimX = shape[2];
-                    
-                    size_t zPerRank = totalZ / size;
-                    size_t remainder = totalZ % size;
-                    zStart = rank * zPerRank + std::min(static_cast<size_t>(rank), remainder);
-                    zCount = zPerRank + (rank < remainder ? 1 : 0);
-                    
-                    // Define variables once
-                    varU_out = ioWrite.DefineVariable<double>(
-                        "U",
-                        {totalZ, dimY, dimX},
-                        {zStart, 0, 0},
-                        {zCount, dimY, dimX}
-                    );
-                    varV_out = ioWrite.DefineVariable<double>(
-                        "V",
-                        {totalZ, dimY, dimX},
-                        {zStart, 0, 0},
-                        {zCount, dimY, dimX}
-                    );
-                }
-            }
+        // Steps are read into relay buffer slots: one reused slot in
+        // lockstep, or one per step in flight when prefetching
+        size_t relaySlots = prefetchDepth + 1;
+        StepReader stepReader(ioRead, reader, precision, decomposition, relaySlots, rank, size);
+        if (startStep > 0) {
+            size_t skipped = stepReader.skip(startStep);
             if (rank == 0) {
-                varStep_out = ioWrite.DefineVariable<int32_t>("step");
+                std::cout << "Resuming at input step " << startStep;
+                if (skipped < startStep) std::cout << " (the file only has " << skipped << ")";
+                std::cout << std::endl;
             }
-            reader.EndStep();
         }
+        std::unique_ptr<Tracer> tracer = startTracing(traceFile, "sender_from_bp", 0, traceEvents);
+        InputStep lockstepStep;
+        std::unique_ptr<PrefetchReader> prefetch;
+        if (prefetchDepth > 0) {
+            prefetch.reset(new PrefetchReader(stepReader, prefetchDepth,
+                                              static_cast<size_t>(prefetchMemMB * 1024.0 * 1024.0)));
+        }
+        
+        StepMetrics metrics(MPI_COMM_WORLD, 5, metricsInterval);
+        double sendTime = 0.0;   // This rank's time from step start to EndStep
+        
+        RelayContext ctx;
+        ctx.rank = rank;
+        ctx.compression = &compression;
         
         // Process each step from the input file
-        while (reader.BeginStep() == adios2::StepStatus::OK) {
+        while (true) {
             auto stepStart = std::chrono::high_resolution_clock::now();
             
-            if (rank == 0) {
-                std::cout << "Processing step " << stepCount << "..." << std::endl;
+            InputStep* input = nullptr;
+            if (prefetch) {
+                input = prefetch->next();
+            } else if (stepReader.read(lockstepStep)) {
+                input = &lockstepStep;
             }
+            if (!input) break;
             
-            writer.BeginStep();
-            
-            double stepDataMB = 0.0;
-            
-            // Read and transmit variable U
-            auto varU_in = ioRead.InquireVariable<double>("U");
-            if (varU_in && zCount > 0) {
-                std::vector<double> dataU(zCount * dimY * dimX);
-                varU_in.SetSelection({{zStart, 0, 0}, {zCount, dimY, dimX}});
-                reader.Get(varU_in, dataU.data());
-                reader.PerformGets();
-                
-                writer.Put(varU_out, dataU.data());
-                stepDataMB += (zCount * dimY * dimX * sizeof(double)) / (1024.0 * 1024.0);
+            if (rank == 0) {
+                std::cout << "Processing step " << input->index << "..." << std::endl;
             }
             
-            // Read and transmit variable V
-            auto varV_in = ioRead.InquireVariable<double>("V");
-            if (varV_in && zCount > 0) {
-                std::vector<double> dataV(zCount * dimY * dimX);
-                varV_in.SetSelection({{zStart, 0, 0}, {zCount, dimY, dimX}});
-                reader.Get(varV_in, dataV.data());
-                reader.PerformGets();
-                
-                writer.Put(varV_out, dataV.data());
-                stepDataMB += (zCount * dimY * dimX * sizeof(double)) / (1024.0 * 1024.0);
+            // Transmit everything (every rank visits every relay, since
+            // fixed16 encoding reduces over all ranks)
+            {
+                TraceScope trace("begin_step");
+                writer.BeginStep();
             }
-            
-            // Read and transmit variable step
-            auto varStep_in = ioRead.InquireVariable<int32_t>("step");
-            if (varStep_in && rank == 0) {
-                int32_t stepValue;
-                reader.Get(varStep_in, &stepValue);
-                reader.PerformGets();
-                
-                writer.Put(varStep_out, stepValue);
+            ctx.probe = compression.shouldProbe(stepCount);
+            ctx.probeTime = 0.0;
+            ctx.bytes = 0;
+            {
+                TraceScope trace("put");
+                for (VariableRelay* relay : input->relays) {
+                    relay->put(ioWrite, writer, input->slot, ctx);
+                }
+                if (rank == 0) {
+                    uint64_t source = input->index;
+                    writer.Put(varSource, source, adios2::Mode::Sync);
+                }
             }
+            double probeTime = ctx.probeTime;
             
-            double globalStepDataMB = 0.0;
-            MPI_Reduce(&stepDataMB, &globalStepDataMB, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-            
-            reader.EndStep();
-            writer.EndStep();
+            {
+                TraceScope trace("end_step");
+                writer.EndStep();
+            }
+            if (prefetch) prefetch->release(input);
             
             auto stepEnd = std::chrono::high_resolution_clock::now();
-            auto stepDuration = std::chrono::duration<double>(stepEnd - stepStart).count();
+            // Probing is measurement overhead, not part of the transfer
+            auto stepDuration = std::chrono::duration<double>(stepEnd - stepStart).count() - probeTime;
+            sendTime += stepDuration;
             
-            if (rank == 0) {
+            CompressionPipeline::StepStats localStats = compression.takeStepStats();
+            // The adaptive controller needs every step's totals at once
+            if (controller.enabled()) {
+                localStats.stepTime = stepDuration;
+                controller.update(stepCount, CompressionPipeline::reduce(localStats, MPI_COMM_WORLD));
+            }
+            
+            // Reduced in batches; rank 0 prints the step once they arrive
+            metrics.record({ctx.bytes / (1024.0 * 1024.0), stepDuration, localStats.rawBytes,
+                            localStats.compressedBytes, localStats.compressTime},
+                           [&, stepCount](const StepMetrics::Reduced& global) {
+                double globalStepDataMB = global.sum[0], time = global.max[1];
                 totalDataMB += globalStepDataMB;
-                double throughputMBps = globalStepDataMB / stepDuration;
+                double throughputMBps = globalStepDataMB / time;
                 
                 std::cout << "Step " << std::setw(3) << stepCount 
-                          << " | Time: " << std::fixed << std::setprecision(3) << std::setw(8) << stepDuration << " s"
+                          << " | Time: " << std::fixed << std::setprecision(3) << std::setw(8) << time << " s"
                           << " | Size: " << std::setw(8) << std::setprecision(2) << globalStepDataMB << " MB"
-                          << " | Throughput: " << std::setw(8) << std::setprecision(2) << throughputMBps << " MB/s"
-                          << std::endl;
-            }
+                          << " | Throughput: " << std::setw(8) << std::setprecision(2) << throughputMBps << " MB/s";
+                if (compression.enabled()) {
+                    CompressionPipeline::StepStats globalStats;
+                    globalStats.rawBytes = global.sum[2];
+                    globalStats.compressedBytes = global.sum[3];
+                    globalStats.compressTime = global.max[4];
+                    compression.accumulate(globalStats);
+                    std::cout << CompressionPipeline::formatStep(globalStats, time);
+                }
+                std::cout << " | Imbalance: " << global.imbalance(1) << std::endl;
+            });
             
             stepCount++;
         }
         
+        metrics.flush();
+        
+        double readWait = prefetch ? prefetch->getWaitTime() : stepReader.getReadTime();
+        size_t maxQueued = prefetch ? prefetch->getMaxQueued() : 0;
+        size_t slotLimit = prefetch ? prefetch->getSlotLimit() : 1;
+        prefetch.reset();
+        
         reader.Close();
         writer.Close();
         
+        // Time the sender spent waiting for input, slowest rank
+        double globalReadWait = 0.0;
+        MPI_Reduce(&readWait, &globalReadWait, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        std::string sendSpread = rankSpread("Send time per rank", sendTime, " s", MPI_COMM_WORLD);
+        std::string traceSummary = finishTracing(tracer, MPI_COMM_WORLD);
+        std::string bufferWarning = bufferSummary(MPI_COMM_WORLD);
+        
         auto overallEnd = std::chrono::high_resolution_clock::now();
         auto totalDuration = std::chrono::duration<double>(overallEnd - overallStart).count();
         
         if (rank == 0) {
             std::cout << std::string(60, '=') << std::endl;
             std::cout << "=== Transfer Complete ===" << std::endl;
-            std::cout << "Steps transmitted: " << stepCount << std::endl;
+            std::cout << "Steps transmitted: " << stepCount;
+            if (startStep > 0) std::cout << " (from input step " << startStep << ")";
+            std::cout << std::endl;
             std::cout << "Total time: " << std::fixed << std::setprecision(3) << totalDuration << " seconds" << std::endl;
             std::cout << "Total data: " << std::setprecision(2) << totalDataMB << " MB" << std::endl;
             std::cout << "Average throughput: " << std::setprecision(2) << (totalDataMB / totalDuration) << " MB/s" << std::endl;
             std::cout << "Average throughput: " << std::setprecision(2) << (totalDataMB / totalDuration * 8.0) << " Mbps" << std::endl;
+            std::cout << sendSpread << std::endl;
+            std::cout << "SST transport: " << transports.usedName() << std::endl;
+            std::cout << "Waiting on BP reads: " << std::setprecision(3) << globalReadWait << " s";
+            if (prefetchDepth > 0) {
+                std::cout << " | Max read ahead: " << maxQueued << "/" << prefetchDepth
+                          << " | Slots after memory cap: " << slotLimit;
+            }
+            std::cout << std::endl;
+            if (!traceSummary.empty()) std::cout << traceSummary << std::endl;
+            if (!bufferWarning.empty()) std::cerr << bufferWarning << std::endl;
+            compression.printSummary(std::cout);
         }
         
     } catch (std::exception &e) {
@@ -240,6 +657,7 @@ int main(int argc, char *argv[])
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
     
+    MPI_Comm_free(&readComm);
     MPI_Finalize();
     return 0;
 }
@@ -0,0 +1,153 @@
+/*
+ * Node-local burst buffer for outputs the WAN cannot take yet
+ *
+ *   --spill=DIR           spill outputs to DIR while SST is behind
+ *   --spill-segment=N     outputs per spill file (default 16)
+ *
+ * With async output the simulation copies each output into a free staging
+ * buffer and moves on. When every buffer is still waiting on SST (its queue
+ * full under QueueFullPolicy=Block), the output goes to a BP5 file in DIR
+ * instead, ideally node-local NVMe or tmpfs, and the simulation carries on.
+ * Each rank writes its own files, "<contact>.spill<i>.r<rank>.bp" with its
+ * dense block of U and V and the step, output and timestamp scalars, so the
+ * spill involves no collectives. A file is closed after N outputs, or as
+ * soon as an output fits into memory again, and is queued for the I/O
+ * thread behind everything submitted before it. The I/O thread reads the
+ * outputs back and sends them like in-memory ones, in production order,
+ * then deletes the file.
+ */
+
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <adios2.h>
+#include <mpi.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Delete a BP5 output (a directory) once it has been drained
+inline void removeTree(const std::string& path)
+{
+    nftw(path.c_str(), [](const char* entry, const struct stat*, int, struct FTW*) { return std::remove(entry); },
+         16, FTW_DEPTH | FTW_PHYS);
+}
+
+class BurstBuffer {
+public:
+    BurstBuffer(const std::string& dir, const std::string& contact, size_t localSize, int segmentOutputs, int rank)
+        : writeAdios_(MPI_COMM_SELF), readAdios_(MPI_COMM_SELF),
+          prefix_(dir + "/" + contact + ".spill"), rank_(rank), localSize_(localSize),
+          segmentOutputs_(std::max(1, segmentOutputs))
+    {
+        ::mkdir(dir.c_str(), 0755);   // Fine if it exists; Open() reports real problems
+        spillIO_ = writeAdios_.DeclareIO("SpillIO");
+        spillIO_.SetEngine("BP5");
+        drainIO_ = readAdios_.DeclareIO("DrainIO");
+        drainIO_.SetEngine("BP5");
+        varU_ = spillIO_.DefineVariable<double>("U", {localSize}, {0}, {localSize});
+        varV_ = spillIO_.DefineVariable<double>("V", {localSize}, {0}, {localSize});
+        varStep_ = spillIO_.DefineVariable<int32_t>("step");
+        varOutput_ = spillIO_.DefineVariable<int32_t>("output");
+        varTimestamp_ = spillIO_.DefineVariable<double>("timestamp");
+    }
+
+    BurstBuffer(const BurstBuffer&) = delete;
+    BurstBuffer& operator=(const BurstBuffer&) = delete;
+
+    // Simulation thread: append one output (localSize dense elements each).
+    // Returns the segment it closed, or -1 while the segment stays open.
+    int write(const double* U, const double* V, int simStep, int outputIndex, double timestamp) {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!writer_) {
+            writer_ = spillIO_.Open(path(segments_), adios2::Mode::Write);
+            inSegment_ = 0;
+        }
+        int32_t stepVal = simStep, outputVal = outputIndex;
+        writer_.BeginStep();
+        writer_.Put(varU_, U, adios2::Mode::Sync);
+        writer_.Put(varV_, V, adios2::Mode::Sync);
+        writer_.Put(varStep_, stepVal, adios2::Mode::Sync);
+        writer_.Put(varOutput_, outputVal, adios2::Mode::Sync);
+        writer_.Put(varTimestamp_, timestamp, adios2::Mode::Sync);
+        writer_.EndStep();
+        spilled_++;
+        inSegment_++;
+        size_t onDisk = (spilled_ - drained_.load()) * 2 * localSize_ * sizeof(double);
+        peakBytes_ = std::max(peakBytes_, onDisk);
+
+        int closed = inSegment_ >= segmentOutputs_ ? close() : -1;
+        spillTime_ += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        return closed;
+    }
+
+    // Simulation thread: close the open segment; returns it, or -1 if none
+    int close() {
+        if (!writer_) return -1;
+        writer_.Close();
+        writer_ = adios2::Engine();
+        return segments_++;
+    }
+
+    // I/O thread: read each output of a closed segment back into U/V
+    // (localSize elements each), call send(simStep, outputIndex, timestamp)
+    // for it, then delete the file
+    template <class Send>
+    void drain(int segment, double* U, double* V, Send send) {
+        drainIO_.RemoveAllVariables();
+        adios2::Engine reader = drainIO_.Open(path(segment), adios2::Mode::Read);
+        while (reader.BeginStep() == adios2::StepStatus::OK) {
+            auto varU = drainIO_.InquireVariable<double>("U");
+            auto varV = drainIO_.InquireVariable<double>("V");
+            auto varStep = drainIO_.InquireVariable<int32_t>("step");
+            auto varOutput = drainIO_.InquireVariable<int32_t>("output");
+            auto varTimestamp = drainIO_.InquireVariable<double>("timestamp");
+            int32_t simStep = 0, outputIndex = 0;
+            double timestamp = 0.0;
+            reader.Get(varU, U);
+            reader.Get(varV, V);
+            reader.Get(varStep, simStep);
+            reader.Get(varOutput, outputIndex);
+            reader.Get(varTimestamp, timestamp);
+            reader.EndStep();
+            drained_++;
+            send(simStep, outputIndex, timestamp);
+        }
+        reader.Close();
+        removeTree(path(segment));
+    }
+
+    std::string path(int segment) const {
+        return prefix_ + std::to_string(segment) + ".r" + std::to_string(rank_) + ".bp";
+    }
+
+    size_t getSpilled() const { return spilled_; }       // Outputs written to disk
+    int getSegments() const { return segments_; }         // Files closed
+    size_t getPeakBytes() const { return peakBytes_; }   // Most this rank held on disk at once
+    double getSpillTime() const { return spillTime_; }   // Simulation time spent writing
+
+private:
+    adios2::ADIOS writeAdios_;   // Simulation thread only
+    adios2::ADIOS readAdios_;    // I/O thread only
+    adios2::IO spillIO_, drainIO_;
+    adios2::Engine writer_;
+    adios2::Variable<double> varU_, varV_, varTimestamp_;
+    adios2::Variable<int32_t> varStep_, varOutput_;
+    std::string prefix_;
+    int rank_;
+    size_t localSize_;
+    int segmentOutputs_;
+    int segments_ = 0;
+    int inSegment_ = 0;
+    size_t spilled_ = 0;
+    std::atomic<size_t> drained_{0};   // Advanced by the I/O thread
+    size_t peakBytes_ = 0;
+    double spillTime_ = 0.0;
+};
+
+#endif // SPILL_H
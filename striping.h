@@ -0,0 +1,222 @@
+/*
+ * Striping of each output step over K parallel SST streams
+ *
+ *   --stripes=K   (senders)   one SST IO and engine per stripe
+ *   --streams=K   (receiver)  read the K streams concurrently
+ *
+ * A single SST stream moves a writer/reader pair's data over one socket,
+ * which cannot fill a long fat WAN pipe. With K stripes every rank cuts
+ * its block of each field into K runs of rows along the first dimension
+ * and Puts run k on stream k, so each pair talks over K connections in
+ * parallel. Stream k announces itself as "<contact>-<k>" (plain
+ * "<contact>" when K is 1). Metadata scalars travel on stream 0 only;
+ * fixed16 uses one value range for all stripes, so every stream's
+ * offset/scale pair is the same. Every stream gets every step, so the
+ * receiver puts step n back together from step n of each stream.
+ */
+
+#ifndef STRIPING_H
+#define STRIPING_H
+
+#include <adios2.h>
+#include <mpi.h>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aggregation.h"
+#include "compression.h"
+#include "config.h"
+#include "precision.h"
+#include "trace.h"
+#include "transport.h"
+
+inline std::string stripeContact(const std::string& contact, int stripe, int stripes)
+{
+    return stripes > 1 ? contact + "-" + std::to_string(stripe) : contact;
+}
+
+// Rows [begin, begin + n) of a block's first dimension carried by `stripe`
+inline void stripeRows(size_t rows, int stripe, int stripes, size_t& begin, size_t& n)
+{
+    size_t base = rows / stripes;
+    size_t remainder = rows % stripes;
+    size_t s = static_cast<size_t>(stripe);
+    begin = s * base + std::min(s, remainder);
+    n = base + (s < remainder ? 1 : 0);
+}
+
+// K writer IOs on one ADIOS object, all configured alike
+class StripedWriter {
+public:
+    // Stripe 0 is IO `ioName`, stripe k > 0 is "ioName-k" and uses stripe
+    // 0's section of the config file unless it has its own; `params` are
+    // the defaults below the XML
+    StripedWriter(adios2::ADIOS& adios, const std::string& ioName, int stripes,
+                  const std::string& engineType, const adios2::Params& params)
+    {
+        for (int k = 0; k < std::max(1, stripes); ++k) {
+            ios_.push_back(adios.DeclareIO(k == 0 ? ioName : ioName + "-" + std::to_string(k)));
+            configureIO(ios_.back(), engineType, params, k == 0 ? nullptr : &ios_[0]);
+        }
+        engines_.resize(ios_.size());
+    }
+
+    int stripes() const { return static_cast<int>(ios_.size()); }
+    adios2::IO& io(int stripe) { return ios_[stripe]; }
+    adios2::Engine& engine(int stripe) { return engines_[stripe]; }
+
+    // Stream 0 carries scalars and the metadata variables
+    // Parameters over the XML on every stripe (options naming them explicitly)
+    void setParameters(const adios2::Params& params) {
+        for (auto& io : ios_) io.SetParameters(params);
+    }
+
+    adios2::IO& primaryIO() { return ios_[0]; }
+    adios2::Engine& primary() { return engines_[0]; }
+
+    // SST writers open one after another as the receiver connects to each,
+    // all on the first transport that every writer rank (comm) could open.
+    // announcer, if given, prints each attempt's connection string.
+    Transport open(const std::string& contact, TransportSelector& transports, MPI_Comm comm,
+                   ContactAnnouncer* announcer = nullptr) {
+        return transports.open(comm, [&](Transport transport) {
+            if (announcer) announcer->start(transport);
+            try {
+                for (int k = 0; k < stripes(); ++k) {
+                    ios_[k].SetParameters(transports.params(transport));
+                    engines_[k] = ios_[k].Open(stripeContact(contact, k, stripes()), adios2::Mode::Write);
+                }
+            } catch (...) {
+                if (announcer) announcer->finish(false);
+                throw;
+            }
+            if (announcer) announcer->finish(true);
+        }, [&]() {
+            for (auto& engine : engines_) {
+                if (engine) engine.Close();
+                engine = adios2::Engine();
+            }
+        });
+    }
+
+    void beginStep() {
+        TraceScope trace("begin_step");
+        for (auto& engine : engines_) engine.BeginStep();
+    }
+    void endStep() {
+        TraceScope trace("end_step");
+        for (auto& engine : engines_) engine.EndStep();
+    }
+    void close() { for (auto& engine : engines_) engine.Close(); }
+
+private:
+    std::vector<adios2::IO> ios_;
+    std::vector<adios2::Engine> engines_;
+};
+
+// A double field split into one WireField per stripe. With one stripe it
+// is exactly a WireField.
+class StripedField {
+public:
+    StripedField(StripedWriter& stream, const std::string& name, WirePrecision precision,
+                 const adios2::Dims& shape, const adios2::Dims& start, const adios2::Dims& count,
+                 int rank)
+        : precision_(precision)
+    {
+        rowElements_ = 1;
+        for (size_t d = 1; d < count.size(); ++d) rowElements_ *= count[d];
+        for (int k = 0; k < stream.stripes(); ++k) {
+            size_t begin, rows;
+            stripeRows(count[0], k, stream.stripes(), begin, rows);
+            adios2::Dims stripeStart = start, stripeCount = count;
+            stripeStart[0] += begin;
+            stripeCount[0] = rows;
+            rowBegin_.push_back(begin);
+            stripes_.emplace_back(new WireField(stream.io(k), name, precision, shape,
+                                                stripeStart, stripeCount, rank));
+        }
+    }
+
+    WirePrecision precision() const { return precision_; }
+
+    size_t wireBytes() const {
+        size_t bytes = 0;
+        for (const auto& field : stripes_) bytes += field->wireBytes();
+        return bytes;
+    }
+
+    void attach(CompressionPipeline& compression) {
+        for (auto& field : stripes_) field->attach(compression);
+    }
+
+    // Double precision: Put straight from the padded array src points to
+    void setMemorySelection(const adios2::Box<adios2::Dims>& memorySelection) {
+        memorySelection_ = memorySelection;
+        for (size_t k = 0; k < stripes_.size(); ++k) {
+            stripes_[k]->doubleVariable().SetMemorySelection(stripeSelection(memorySelection, k));
+        }
+    }
+
+    // WireField::encode() per stripe; fixed16 reduces one range for all of
+    // them, so it is still a single collective
+    void encode(const double* src, MPI_Comm comm,
+                const adios2::Box<adios2::Dims>& memorySelection = adios2::Box<adios2::Dims>()) {
+        double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+        if (precision_ == WirePrecision::Fixed16) {
+            for (size_t k = 0; k < stripes_.size(); ++k) {
+                stripes_[k]->localRange(stripeData(src, memorySelection, k),
+                                        stripeSelection(memorySelection, k), lo, hi);
+            }
+            WireField::reduceRange(comm, lo, hi);
+        }
+        for (size_t k = 0; k < stripes_.size(); ++k) {
+            stripes_[k]->encodeWithRange(stripeData(src, memorySelection, k), lo, hi,
+                                         stripeSelection(memorySelection, k));
+        }
+    }
+
+    // Deferred Put of every stripe on its stream, through the aggregator.
+    // Collective over the aggregation group, so ranks that do not write
+    // call it too.
+    void put(StripedWriter& stream, const double* src, WanAggregator& aggregator) {
+        for (size_t k = 0; k < stripes_.size(); ++k) {
+            stripes_[k]->put(stream.engine(static_cast<int>(k)),
+                             stripeData(src, memorySelection_, k), aggregator);
+        }
+    }
+
+    // The first stripe stands in for the block
+    void probe(CompressionPipeline& compression, const double* src,
+               const adios2::Box<adios2::Dims>& memorySelection = adios2::Box<adios2::Dims>()) {
+        stripes_[0]->probe(compression, src, stripeSelection(memorySelection, 0));
+    }
+
+    void record(CompressionPipeline& compression) {
+        for (auto& field : stripes_) field->record(compression);
+    }
+
+private:
+    // Dense sources start each stripe at its first row; padded ones keep the
+    // base pointer and move the memory selection instead
+    const double* stripeData(const double* src, const adios2::Box<adios2::Dims>& memorySelection,
+                             size_t k) const {
+        return memorySelection.first.empty() ? src + rowBegin_[k] * rowElements_ : src;
+    }
+
+    adios2::Box<adios2::Dims> stripeSelection(const adios2::Box<adios2::Dims>& memorySelection, size_t k) const {
+        adios2::Box<adios2::Dims> selection = memorySelection;
+        if (!selection.first.empty()) selection.first[0] += rowBegin_[k];
+        return selection;
+    }
+
+    WirePrecision precision_;
+    size_t rowElements_;
+    std::vector<size_t> rowBegin_;
+    std::vector<std::unique_ptr<WireField>> stripes_;
+    adios2::Box<adios2::Dims> memorySelection_;   // Set on the double variables
+};
+
+#endif // STRIPING_H
@@ -0,0 +1,269 @@
+/*
+ * Per-phase tracing as a Chrome trace
+ *
+ *   --trace=FILE         write the phases of every rank to FILE (JSON)
+ *   --trace-events=N     events kept per thread (default 65536)
+ *
+ * TraceScope times one phase ("compute", "halo", "put", "end_step", ...) of
+ * the thread it runs on. Each thread records into its own ring buffer,
+ * allocated when it records its first event. A full ring overwrites its
+ * oldest events, so a long run keeps its last N phases per thread. Without
+ * --trace there is no tracer and a scope costs one pointer test.
+ *
+ * At exit rank 0 receives every rank's events in turn, appending each to a
+ * single file in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+ * Each rank is a process and each of its threads a track. Times are
+ * wall-clock microseconds on the sender's clock: the receiver shifts its
+ * own events by the offset clock.h measured. A sender and a receiver trace
+ * therefore line up once their traceEvents are joined, e.g.
+ *
+ *   jq -s '{traceEvents: map(.traceEvents) | add}' gs.json recv.json > both.json
+ *
+ * Receiver processes are numbered from 100000 so they never collide with
+ * sender ranks.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "clock.h"
+
+class Tracer {
+public:
+    Tracer(const std::string& path, const std::string& program, int pidBase, size_t eventsPerThread)
+        : path_(path), program_(program), pidBase_(pidBase),
+          capacity_(std::max<size_t>(1, eventsPerThread)) {}
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // One finished phase of the calling thread
+    void record(const char* name, double begin, double end) {
+        Ring& ring = threadRing();
+        Event& e = ring.events[ring.next];
+        e.name = name;
+        e.begin = begin;
+        e.end = end;
+        ring.next = (ring.next + 1) % ring.events.size();
+        ring.recorded++;
+    }
+
+    // Put the calling thread on track `name`, before it records anything.
+    // Unnamed threads get "main" (the first) or "thread k". Threads that run
+    // one after the other, like a helper started per step, share a track by
+    // using the same name; two threads on one track at once are not allowed.
+    void nameThread(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& ring : rings_) {
+            if (ring->name == name) {
+                currentRing() = ring.get();
+                return;
+            }
+        }
+        currentRing() = addRing(name);
+    }
+
+    // Added to every time at write(): the receiver's offset to the sender clock
+    void setClockOffset(double offset) { offset_ = offset; }
+
+    // Write every rank's events to the file on rank 0. Collective; the
+    // other threads must have stopped recording. Rank 0 only ever holds one
+    // rank's events, so the trace may grow past what fits in memory (or an
+    // int count). Returns a summary line on rank 0, empty elsewhere.
+    std::string write(MPI_Comm comm) {
+        int rank, size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        unsigned long long counts[2] = {kept(), recorded() - kept()}, totals[2] = {0, 0};
+        MPI_Reduce(counts, totals, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm);
+        std::string local = rankEvents(rank);
+        const int tag = 7301;
+        if (rank != 0) {
+            sendEvents(local, comm, tag);
+            return "";
+        }
+
+        std::ofstream out(path_);
+        out << "{\"traceEvents\":[\n";
+        out << local;   // Never empty: it names the process
+        for (int r = 1; r < size; ++r) {
+            receiveEvents(local, r, comm, tag);
+            out << ",\n" << local;
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        std::ostringstream summary;
+        summary << "Trace: " << totals[0] << " events in " << path_;
+        if (totals[1] > 0) summary << " (" << totals[1] << " older ones overwritten, see --trace-events)";
+        return summary.str();
+    }
+
+    // Events recorded and kept so far, over this rank's threads
+    size_t recorded() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t n = 0;
+        for (const auto& ring : rings_) n += ring->recorded;
+        return n;
+    }
+    size_t kept() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t n = 0;
+        for (const auto& ring : rings_) n += std::min(ring->recorded, ring->events.size());
+        return n;
+    }
+
+    const std::string& path() const { return path_; }
+
+private:
+    struct Event {
+        const char* name;   // String literal
+        double begin, end;  // wallClock()
+    };
+
+    struct Ring {
+        std::vector<Event> events;
+        size_t next = 0;
+        size_t recorded = 0;
+        std::string name;
+    };
+
+    // One tracer per process, so the thread's ring needs no tracer key
+    static Ring*& currentRing() {
+        static thread_local Ring* ring = nullptr;
+        return ring;
+    }
+
+    Ring& threadRing() {
+        Ring*& ring = currentRing();
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ring = addRing(rings_.empty() ? "main" : "thread " + std::to_string(rings_.size()));
+        }
+        return *ring;
+    }
+
+    // mutex_ held
+    Ring* addRing(const std::string& name) {
+        rings_.emplace_back(new Ring());
+        Ring* ring = rings_.back().get();
+        ring->events.resize(capacity_);
+        ring->name = name;
+        return ring;
+    }
+
+    // Events travel in pieces of up to 1 GiB, after their 64-bit length
+    static size_t chunkBytes() { return size_t(1) << 30; }
+
+    static void sendEvents(const std::string& events, MPI_Comm comm, int tag) {
+        unsigned long long length = events.size();
+        MPI_Send(&length, 1, MPI_UNSIGNED_LONG_LONG, 0, tag, comm);
+        for (size_t done = 0; done < events.size(); done += chunkBytes()) {
+            int n = static_cast<int>(std::min(chunkBytes(), events.size() - done));
+            MPI_Send(events.data() + done, n, MPI_CHAR, 0, tag, comm);
+        }
+    }
+
+    static void receiveEvents(std::string& events, int source, MPI_Comm comm, int tag) {
+        unsigned long long length = 0;
+        MPI_Recv(&length, 1, MPI_UNSIGNED_LONG_LONG, source, tag, comm, MPI_STATUS_IGNORE);
+        events.resize(length);
+        for (size_t done = 0; done < events.size(); done += chunkBytes()) {
+            int n = static_cast<int>(std::min(chunkBytes(), events.size() - done));
+            MPI_Recv(&events[done], n, MPI_CHAR, source, tag, comm, MPI_STATUS_IGNORE);
+        }
+    }
+
+    // This rank's events as comma-separated JSON objects, oldest first
+    std::string rankEvents(int rank) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream out;
+        out.precision(3);
+        out << std::fixed;
+        int pid = pidBase_ + rank;
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"args\":{\"name\":\"" << program_
+            << " rank " << rank << "\"}}";
+        for (size_t t = 0; t < rings_.size(); ++t) {
+            const Ring& ring = *rings_[t];
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << t
+                << ",\"args\":{\"name\":\"" << ring.name << "\"}}";
+            size_t kept = std::min(ring.recorded, ring.events.size());
+            size_t oldest = ring.recorded > ring.events.size() ? ring.next : 0;
+            for (size_t i = 0; i < kept; ++i) {
+                const Event& e = ring.events[(oldest + i) % ring.events.size()];
+                out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << t
+                    << ",\"ts\":" << (e.begin + offset_) * 1e6 << ",\"dur\":" << (e.end - e.begin) * 1e6 << "}";
+            }
+        }
+        return out.str();
+    }
+
+    std::string path_;
+    std::string program_;
+    int pidBase_;
+    size_t capacity_;
+    double offset_ = 0.0;
+    mutable std::mutex mutex_;   // Guards rings_ (not the events)
+    std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+// The process's tracer, nullptr when tracing is off
+inline Tracer*& activeTracer()
+{
+    static Tracer* tracer = nullptr;
+    return tracer;
+}
+
+// Times the enclosing block as one phase
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name_(name), begin_(activeTracer() ? wallClock() : 0.0) {}
+    ~TraceScope() {
+        if (Tracer* tracer = activeTracer()) tracer->record(name_, begin_, wallClock());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    double begin_;
+};
+
+// Tracer for --trace=FILE, installed as activeTracer(); null without it
+inline std::unique_ptr<Tracer> startTracing(const std::string& path, const std::string& program, int pidBase,
+                                            size_t eventsPerThread)
+{
+    std::unique_ptr<Tracer> tracer;
+    if (path.empty()) return tracer;
+    tracer.reset(new Tracer(path, program, pidBase, eventsPerThread));
+    activeTracer() = tracer.get();
+    return tracer;
+}
+
+// Write the trace, uninstall and destroy the tracer (collective). Returns
+// the summary line on rank 0.
+inline std::string finishTracing(std::unique_ptr<Tracer>& tracer, MPI_Comm comm)
+{
+    if (!tracer) return "";
+    activeTracer() = nullptr;
+    std::string summary = tracer->write(comm);
+    tracer.reset();
+    return summary;
+}
+
+// Name the calling thread's track, if tracing
+inline void traceThread(const std::string& name)
+{
+    if (Tracer* tracer = activeTracer()) tracer->nameThread(name);
+}
+
+#endif // TRACE_H
@@ -0,0 +1,332 @@
+/*
+ * Selectable SST data transports with probing and fallback
+ *
+ *   --transport=auto|rdma|ucx|wan|sockets   (default sockets, or the XML's)
+ *   --transport-timeout=S   contact-file timeout of a reader attempt that can
+ *                           fall back
+ *
+ *   sockets  WAN data plane over EVPath TCP sockets (works everywhere)
+ *   wan      WAN data plane over EVPath ENet (reliable UDP, long-RTT links)
+ *   ucx      UCX data plane
+ *   rdma     libfabric data plane (InfiniBand, RoCE, ...)
+ *
+ * A request becomes an ordered list of candidates: auto is rdma, ucx,
+ * sockets; any other choice is tried first and sockets is always the last
+ * resort. At startup every rank probes its candidates (is the library
+ * loadable, is there an RDMA device) and only transports present on every
+ * rank are kept. The stream is then opened with each candidate in turn
+ * until all ranks have opened it, and the transport that connected is
+ * reported. All stripes of a stream use the same transport.
+ *
+ * The fallback only covers attempts that fail: a data plane that cannot be
+ * initialised, or a reader that finds no contact file in time (SST's
+ * OpenTimeoutSecs bounds nothing else). A writer waiting for its readers
+ * on a plane that cannot reach them, like RDMA between two sites that
+ * each have InfiniBand, waits forever. That is why the default is sockets,
+ * which crosses a WAN, and auto is opt-in for runs within one site. Without
+ * --transport, a DataTransport set in the runtime config file becomes the
+ * request (still with sockets behind it). One this list does not know,
+ * e.g. SST's MPI data plane, is used exactly as configured, without
+ * probing or fallback.
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <adios2.h>
+#include <mpi.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class Transport {
+    Sockets, Wan, Ucx, Rdma,
+    Configured   // The config file's DataTransport, left to SST as given
+};
+
+inline const char* transportName(Transport transport)
+{
+    switch (transport) {
+        case Transport::Wan: return "wan";
+        case Transport::Ucx: return "ucx";
+        case Transport::Rdma: return "rdma";
+        case Transport::Configured: return "configured";
+        default: return "sockets";
+    }
+}
+
+// Candidates for --transport, fastest first, sockets last
+inline std::vector<Transport> transportCandidates(const std::string& text)
+{
+    if (text == "auto") return {Transport::Rdma, Transport::Ucx, Transport::Sockets};
+    if (text == "sockets") return {Transport::Sockets};
+    if (text == "wan") return {Transport::Wan, Transport::Sockets};
+    if (text == "ucx") return {Transport::Ucx, Transport::Sockets};
+    if (text == "rdma") return {Transport::Rdma, Transport::Sockets};
+    throw std::invalid_argument("unknown transport '" + text + "' (use auto, rdma, ucx, wan or sockets)");
+}
+
+// SST parameters selecting a transport; the control plane stays on TCP
+// except for ENet, which runs both planes over UDP. Configured sets none,
+// keeping the config file's.
+inline adios2::Params transportParams(Transport transport)
+{
+    switch (transport) {
+        case Transport::Configured:
+            return {};
+        case Transport::Wan:
+            return {{"ControlTransport", "enet"}, {"DataTransport", "WAN"}, {"WANDataTransport", "enet"}};
+        case Transport::Ucx:
+            return {{"ControlTransport", "sockets"}, {"DataTransport", "UCX"}};
+        case Transport::Rdma:
+            return {{"ControlTransport", "sockets"}, {"DataTransport", "RDMA"}};
+        default:
+            return {{"ControlTransport", "sockets"}, {"DataTransport", "WAN"}, {"WANDataTransport", "sockets"}};
+    }
+}
+
+// Transport named by SST parameters (DataTransport, WANDataTransport);
+// Configured for any other data plane
+inline Transport transportFromParams(const adios2::Params& params)
+{
+    auto lower = [&](const char* key) {
+        auto it = params.find(key);
+        std::string value = it == params.end() ? "" : it->second;
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        return value;
+    };
+    std::string data = lower("DataTransport");
+    if (data == "rdma" || data == "fabric" || data == "ib") return Transport::Rdma;
+    if (data == "ucx") return Transport::Ucx;
+    if (data == "wan" || data == "evpath") {
+        return lower("WANDataTransport") == "enet" ? Transport::Wan : Transport::Sockets;
+    }
+    return Transport::Configured;
+}
+
+inline bool libraryLoadable(const std::vector<const char*>& names)
+{
+    for (const char* name : names) {
+        void* handle = dlopen(name, RTLD_LAZY | RTLD_LOCAL);
+        if (handle) {
+            dlclose(handle);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool directoryHasEntries(const char* path)
+{
+    DIR* dir = opendir(path);
+    if (!dir) return false;
+    bool found = false;
+    while (struct dirent* entry = readdir(dir)) {
+        if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0) {
+            found = true;
+            break;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+// Whether this host looks able to run the transport. A hint only: ADIOS2
+// may still have been built without the data plane, which open() catches.
+inline bool transportPresent(Transport transport)
+{
+    switch (transport) {
+        case Transport::Ucx:
+            return libraryLoadable({"libucp.so.0", "libucp.so"});
+        case Transport::Rdma:
+            return libraryLoadable({"libfabric.so.1", "libfabric.so"}) &&
+                   (directoryHasEntries("/sys/class/infiniband") || std::getenv("FI_PROVIDER"));
+        default:
+            return true;
+    }
+}
+
+class TransportSelector {
+public:
+    // Collective over comm: keeps the candidates every rank has. An empty
+    // request means the config's DataTransport (config holds the IO's
+    // parameters from the XML), or sockets.
+    TransportSelector(const std::string& request, int timeoutSecs, MPI_Comm comm,
+                      const adios2::Params& config = adios2::Params())
+        : request_(request), timeoutSecs_(timeoutSecs)
+    {
+        MPI_Comm_rank(comm, &rank_);
+        std::string requested = request;
+        auto timeout = config.find("OpenTimeoutSecs");
+        if (timeout != config.end()) finalTimeout_ = timeout->second;
+        if (requested.empty() && config.count("DataTransport")) {
+            Transport configured = transportFromParams(config);
+            if (configured == Transport::Configured) {
+                // Nothing to probe or fall back to
+                configuredName_ = config.at("DataTransport");
+                request_ = configuredName_ + " from config";
+                candidates_.push_back(configured);
+                used_ = configured;
+                return;
+            }
+            requested = transportName(configured);
+            request_ = requested + " from config";
+        } else if (requested.empty()) {
+            requested = request_ = "sockets";
+        }
+
+        for (Transport transport : transportCandidates(requested)) {
+            int present = transportPresent(transport) ? 1 : 0;
+            MPI_Allreduce(MPI_IN_PLACE, &present, 1, MPI_INT, MPI_MIN, comm);
+            if (present || transport == Transport::Sockets) {
+                candidates_.push_back(transport);
+            } else {
+                notes_.push_back(std::string(transportName(transport)) + " not available");
+            }
+        }
+        if (candidates_.back() != Transport::Sockets) candidates_.push_back(Transport::Sockets);
+        used_ = candidates_.front();
+    }
+
+    // Parameters for an attempt: when a fallback remains it gets the short
+    // timeout, the last one the usual five minutes (or the XML's timeout).
+    // Only readers use it, while they look for the contact file.
+    adios2::Params params(Transport transport) const {
+        adios2::Params p = transportParams(transport);
+        p["OpenTimeoutSecs"] = transport == candidates_.back() ? finalTimeout_ : std::to_string(timeoutSecs_);
+        return p;
+    }
+
+    // Calls tryOpen(transport) for each candidate until it succeeds on every
+    // rank of comm; after a failure discard() closes whatever this rank did
+    // open. Throws if no candidate connected.
+    template <class Open, class Discard>
+    Transport open(MPI_Comm comm, Open tryOpen, Discard discard) {
+        for (Transport transport : candidates_) {
+            int ok = 1;
+            try {
+                tryOpen(transport);
+            } catch (const std::exception& e) {
+                std::cerr << "Warning on rank " << rank_ << ": " << transportName(transport)
+                          << " transport failed: " << e.what() << std::endl;
+                ok = 0;
+            }
+            MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+            if (ok) {
+                used_ = transport;
+                return transport;
+            }
+            discard();
+            notes_.push_back(std::string(transportName(transport)) + " failed to connect");
+        }
+        throw std::runtime_error("no SST transport could connect (requested " + request_ + ")");
+    }
+
+    Transport used() const { return used_; }
+
+    // Name of the transport in use; a configured one by its DataTransport
+    std::string usedName() const {
+        return used_ == Transport::Configured ? configuredName_ : std::string(transportName(used_));
+    }
+
+    // e.g. "sockets (requested auto; rdma not available, ucx failed to connect)"
+    std::string report() const {
+        std::string text = usedName();
+        text += " (requested " + request_;
+        for (size_t i = 0; i < notes_.size(); ++i) text += (i == 0 ? "; " : ", ") + notes_[i];
+        return text + ")";
+    }
+
+private:
+    std::string request_;
+    int timeoutSecs_;
+    std::string finalTimeout_ = "300";
+    int rank_ = 0;
+    std::vector<Transport> candidates_;
+    std::vector<std::string> notes_;
+    Transport used_;
+    std::string configuredName_;   // DataTransport of Transport::Configured
+};
+
+// Prints the SST connection string of each open attempt on the writer's
+// rank 0. A fallback reopens the stream and rewrites <contact>.sst, so the
+// file is watched per attempt: start() before the Open, finish() once it
+// returned or threw. Whatever the file holds when an attempt starts is
+// stale and skipped. When the Open returned before the watch saw the new
+// string (no readers to wait for), finish() prints it.
+class ContactAnnouncer {
+public:
+    // `command`: the receiver command line the string is appended to
+    ContactAnnouncer(const std::string& contactFile, const std::string& command)
+        : path_(contactFile + ".sst"), command_(command) {}
+
+    ~ContactAnnouncer() { finish(false); }
+
+    ContactAnnouncer(const ContactAnnouncer&) = delete;
+    ContactAnnouncer& operator=(const ContactAnnouncer&) = delete;
+
+    void start(Transport transport) {
+        finish(false);
+        transport_ = transport;
+        stale_ = readContact();
+        printed_ = false;
+        stop_ = false;
+        thread_ = std::thread([this]() {
+            while (!stop_ && !poll()) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        });
+    }
+
+    // opened: the attempt succeeded, so its string is the one to use
+    void finish(bool opened) {
+        if (!thread_.joinable()) return;
+        stop_ = true;
+        thread_.join();
+        if (opened && !printed_) poll();
+    }
+
+private:
+    std::string readContact() const {
+        std::ifstream file(path_);
+        std::string line;
+        std::getline(file, line);   // Skip the header line
+        std::getline(file, line);   // Connection string
+        return line;
+    }
+
+    // Prints this attempt's string once it is there; true once printed
+    bool poll() {
+        std::string line = readContact();
+        if (line.empty() || line == stale_) return false;
+        if (!last_.empty()) std::cout << "\n(The previous connection string is stale.)" << std::endl;
+        std::cout << "\n*** SST CONNECTION STRING (" << transportName(transport_) << ") ***" << std::endl;
+        std::cout << line << std::endl;
+        std::cout << "\nRun this on receiver machine (choose your MPI ranks):" << std::endl;
+        std::cout << "  " << command_ << " \"" << line << "\"" << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+        std::cout << "\nWaiting for receiver to connect..." << std::endl;
+        last_ = line;
+        printed_ = true;
+        return true;
+    }
+
+    std::string path_, command_;
+    Transport transport_ = Transport::Sockets;
+    std::string stale_;              // In the file before this attempt
+    std::string last_;               // Last string printed
+    bool printed_ = false;           // For the current attempt
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+#endif // TRANSPORT_H